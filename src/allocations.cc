@@ -0,0 +1,48 @@
+#include "allocations.h"
+#include <cstdlib>
+#include <new>
+
+#ifdef ENABLE_ALLOCATION_COUNTER
+
+namespace {
+thread_local u64 count_ = 0;
+}
+
+// the array, nothrow and sized forms default to calling these
+void* operator new(size_t size) {
+  count_++;
+  if (void* memory = std::malloc(size ? size : 1)) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+  count_++;
+  size_t align = static_cast<size_t>(alignment);
+  // aligned_alloc wants a multiple of the alignment
+  if (void* memory = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) & ~(align - 1))) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept {
+  std::free(memory);
+}
+
+u64 Allocations::Count() {
+  return count_;
+}
+
+#else
+
+u64 Allocations::Count() {
+  return 0;
+}
+
+#endif
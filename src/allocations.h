@@ -0,0 +1,21 @@
+#pragma once
+
+#include "util.h"
+
+// Heap allocation counting, built with -DCOUNT_ALLOCATIONS=1.
+//
+// Replaces the global operator new and delete with ones that count per thread.
+// laneboy-bench then checks that emulating a frame doesn't allocate once the machine
+// is warm: instructions are decoded into CPU::instruction_buffer_, bus accesses go
+// through devices made at power on and the PPU draws into the existing texture.
+
+#ifdef COUNT_ALLOCATIONS
+#define ENABLE_ALLOCATION_COUNTER
+#endif
+
+namespace Allocations {
+
+// allocations made by the calling thread so far, always 0 without the counter
+u64 Count();
+
+}
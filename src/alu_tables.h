@@ -0,0 +1,68 @@
+#pragma once
+
+#include "util.h"
+#include <array>
+
+// rotate/shift operations in the order of the rows of the $CB page
+enum class ShiftOp : u8 { RLC, RRC, RL, RR, SLA, SRA, SWAP, SRL };
+
+constexpr u8 kFlagZero = 0x80;
+constexpr u8 kFlagSubtract = 0x40;
+constexpr u8 kFlagHalfCarry = 0x20;
+constexpr u8 kFlagCarry = 0x10;
+
+// table entries keep the result in the high byte and the F register in the low byte
+constexpr u16 PackResult(u8 value, u8 flags) {
+  return (value << 8) | flags | (value == 0 ? kFlagZero : 0);
+}
+
+constexpr u16 ComputeShift(ShiftOp op, u8 value, bool carry) {
+  switch (op) {
+    case ShiftOp::RLC: return PackResult((value << 1) | (value >> 7), value & 0x80 ? kFlagCarry : 0);
+    case ShiftOp::RRC: return PackResult((value >> 1) | (value << 7), value & 0x01 ? kFlagCarry : 0);
+    case ShiftOp::RL: return PackResult((value << 1) | carry, value & 0x80 ? kFlagCarry : 0);
+    case ShiftOp::RR: return PackResult((value >> 1) | (carry << 7), value & 0x01 ? kFlagCarry : 0);
+    case ShiftOp::SLA: return PackResult(value << 1, value & 0x80 ? kFlagCarry : 0);
+    case ShiftOp::SRA: return PackResult((value >> 1) | (value & 0x80), value & 0x01 ? kFlagCarry : 0);
+    case ShiftOp::SWAP: return PackResult((value << 4) | (value >> 4), 0);
+    case ShiftOp::SRL: return PackResult(value >> 1, value & 0x01 ? kFlagCarry : 0);
+  }
+  return 0;
+}
+
+// indexed by (C << 8) | value, only RL and RR look at the carry half
+template<ShiftOp op>
+constexpr std::array<u16, 512> MakeShiftTable() {
+  std::array<u16, 512> table{};
+  for (u32 i = 0; i < table.size(); i++) {
+    table[i] = ComputeShift(op, i & 0xFF, i >> 8);
+  }
+  return table;
+}
+
+template<ShiftOp op>
+inline constexpr std::array<u16, 512> kShiftTable = MakeShiftTable<op>();
+
+constexpr u16 ComputeDAA(u8 a, bool subtract, bool half_carry, bool carry) {
+  u8 adjust = 0;
+  if (half_carry || (!subtract && (a & 0xF) > 0x9)) {
+    adjust |= 0x06;
+  }
+  if (carry || (!subtract && a > 0x99)) {
+    adjust |= 0x60;
+    carry = true;
+  }
+  u8 result = subtract ? a - adjust : a + adjust;
+  return PackResult(result, (subtract ? kFlagSubtract : 0) | (carry ? kFlagCarry : 0));
+}
+
+// indexed by (N << 10) | (H << 9) | (C << 8) | A
+constexpr std::array<u16, 2048> MakeDAATable() {
+  std::array<u16, 2048> table{};
+  for (u32 i = 0; i < table.size(); i++) {
+    table[i] = ComputeDAA(i & 0xFF, i & 0x400, i & 0x200, i & 0x100);
+  }
+  return table;
+}
+
+inline constexpr std::array<u16, 2048> kDAATable = MakeDAATable();
@@ -0,0 +1,26 @@
+#include "arena.h"
+
+Arena::Arena(size_t capacity)
+    : data_(static_cast<std::byte*>(::operator new(capacity, std::align_val_t(kAlignment)))), capacity_(capacity) {}
+
+Arena::~Arena() {
+  ::operator delete(data_, std::align_val_t(kAlignment));
+}
+
+void* Arena::Allocate(size_t size, size_t alignment) {
+  alignment = std::max(alignment, alignof(std::max_align_t));
+  size_t offset = (used_ + alignment - 1) & ~(alignment - 1);
+  if (offset + size > capacity_) {
+    std::cerr << "arena of " << capacity_ << " bytes is out of space for " << size << " more" << std::endl;
+    abort();
+  }
+  used_ = offset + size;
+  return data_ + offset;
+}
+
+void Arena::Rewind(size_t mark) {
+  if (mark > used_) {
+    abort(); // can only go back
+  }
+  used_ = mark;
+}
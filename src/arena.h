@@ -0,0 +1,70 @@
+#pragma once
+
+#include "util.h"
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <span>
+
+// One contiguous block a machine's state is carved out of, see MemoryBus::arena.
+//
+// Allocation bumps an offset, so objects made in the same order land at the same
+// offsets every time and the state sits next to each other instead of all over the
+// heap. Nothing is freed on its own, the block goes away with the arena, ArenaPtr
+// only runs the destructor, and Rewind hands back whatever was made last. The capacity is fixed, running out of it aborts.
+class Arena {
+ public:
+  // of the block, allocations are packed at their own alignment
+  static constexpr size_t kAlignment = 64;
+
+  explicit Arena(size_t capacity);
+  ~Arena();
+  Arena(const Arena&) = delete;
+
+  struct Deleter {
+    template<typename T>
+    void operator()(T* object) const {
+      object->~T();
+    }
+  };
+  template<typename T>
+  using Ptr = std::unique_ptr<T, Deleter>;
+
+  template<typename T, typename... Args>
+  Ptr<T> New(Args&&... args) {
+    return Ptr<T>(new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...));
+  }
+
+  // count value initialized elements that live as long as the arena, they are never destroyed
+  template<typename T>
+  std::span<T> NewArray(size_t count) {
+    static_assert(std::is_trivially_destructible_v<T>);
+    T* array = static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+    for (size_t i = 0; i < count; i++) {
+      new (array + i) T();
+    }
+    return {array, count};
+  }
+
+  void* Allocate(size_t size, size_t alignment);
+
+  // frees everything allocated since used() returned mark, it all has to be destroyed already
+  void Rewind(size_t mark);
+
+  bool Contains(const void* pointer) const {
+    auto byte = static_cast<const std::byte*>(pointer);
+    return byte >= data_ && byte < data_ + used_;
+  }
+
+  const std::byte* data() const { return data_; }
+  size_t used() const { return used_; }
+  size_t capacity() const { return capacity_; }
+
+ private:
+  std::byte* data_;
+  size_t capacity_;
+  size_t used_ = 0;
+};
+
+template<typename T>
+using ArenaPtr = Arena::Ptr<T>;
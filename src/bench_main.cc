@@ -0,0 +1,1014 @@
+#include "headless.h"
+#include "allocations.h"
+#include "compress.h"
+#include "idioms.h"
+#include "opcodes.h"
+#include "synthetic_rom.h"
+#include "trace_file.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <random>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+// laneboy-bench [--filter text] [--samples n] [--min-time ms] [--cpu n] [--json output.json] [--list]
+//
+// Microbenchmarks of the hot paths: bus accesses per region, instruction dispatch per
+// opcode class, the PPU's tile fetch, scanline and frame, the output texture,
+// resetting a machine and snapshots.
+//
+// It first checks that every opcode handler takes the cycles and length kOpcodes has
+// for it, in every execution mode the build has, that compressed blocks and trace
+// files round trip and that corrupt ones are refused, that machines forked from a
+// snapshot don't see each other's writes, that the copy and fill idioms leave the
+// machine as running their loops would, and fails if one doesn't.
+//
+// Built with COUNT_ALLOCATIONS it also checks that emulated frames don't allocate
+// after warming up, in every execution mode the build has, and fails if one does.
+//
+// Every benchmark is calibrated so one sample runs for at least --min-time, warmed up
+// once and then sampled --samples times. The median is the number to compare, the MAD
+// (median absolute deviation) says how noisy the samples were. --cpu pins the process
+// to one core, which keeps the scheduler from moving it between samples.
+
+namespace {
+
+struct Options {
+  std::string filter;
+  u32 samples = 21;
+  double min_time_ms = 20;
+  s32 cpu = -1;
+  std::string json_path;
+  bool list = false;
+};
+
+struct Result {
+  std::string name;
+  u64 ops; // per sample
+  double median;
+  double mad;
+  double mean;
+  double stddev;
+  double min;
+  double max;
+};
+
+// keeps the compiler from dropping the work of a benchmark
+volatile u32 sink;
+
+class Runner {
+ public:
+  // body runs ops operations, setup runs before every sample without being timed
+  using Body = std::function<void(u64 ops)>;
+  using Setup = std::function<void()>;
+
+  explicit Runner(const Options& options) : options_(options) {}
+
+  // fixed_ops keeps the body at that many operations, for benchmarks where setup has to
+  // run between them, the calibration then repeats the setup and the body instead
+  void Run(const std::string& name, const Body& body, u64 fixed_ops = 0, const Setup& setup = {}) {
+    if (!options_.filter.empty() && name.find(options_.filter) == std::string::npos) {
+      return;
+    }
+    if (options_.list) {
+      std::cout << name << std::endl;
+      return;
+    }
+    // a sample is runs times setup and body, only the bodies are timed
+    u64 ops = fixed_ops ? fixed_ops : 1;
+    u64 runs = 1;
+    u64& grown = fixed_ops ? runs : ops;
+    // grow until a sample is long enough for the clock, the last one doubles as a warmup
+    while (true) {
+      double ms = Time(body, ops, runs, setup) / 1e6;
+      if (ms >= options_.min_time_ms) {
+        break;
+      }
+      u64 scale = ms <= 0 ? 10 : (u64)std::ceil(options_.min_time_ms / ms * 1.2);
+      grown *= std::clamp<u64>(scale, 2, 10);
+    }
+
+    std::vector<double> samples;
+    samples.reserve(options_.samples);
+    for (u32 i = 0; i < options_.samples; i++) {
+      samples.push_back(Time(body, ops, runs, setup) / (ops * runs));
+    }
+    ops *= runs;
+    Result result = Summarize(name, ops, samples);
+    std::cout << fmt::format("{:<32} {:>10.2f} ns/op  +-{:>5.1f}%  (min {:.2f}, max {:.2f}, {} ops x {})",
+                             result.name, result.median, result.median > 0 ? result.mad / result.median * 100 : 0,
+                             result.min, result.max, result.ops, samples.size())
+              << std::endl;
+    results_.push_back(std::move(result));
+  }
+
+  const std::vector<Result>& results() const { return results_; }
+
+ private:
+  // in nanoseconds
+  static double Time(const Body& body, u64 ops, u64 runs, const Setup& setup) {
+    double total = 0;
+    for (u64 run = 0; run < runs; run++) {
+      if (setup) {
+        setup();
+      }
+      auto begin = std::chrono::steady_clock::now();
+      body(ops);
+      auto end = std::chrono::steady_clock::now();
+      total += std::chrono::duration<double, std::nano>(end - begin).count();
+    }
+    return total;
+  }
+
+  static double Median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+  }
+
+  static Result Summarize(const std::string& name, u64 ops, const std::vector<double>& samples) {
+    Result result{name, ops};
+    result.median = Median(samples);
+    std::vector<double> deviations;
+    for (double sample : samples) {
+      deviations.push_back(std::abs(sample - result.median));
+    }
+    result.mad = Median(deviations);
+    double sum = 0;
+    for (double sample : samples) {
+      sum += sample;
+    }
+    result.mean = sum / samples.size();
+    double variance = 0;
+    for (double sample : samples) {
+      variance += (sample - result.mean) * (sample - result.mean);
+    }
+    result.stddev = samples.size() > 1 ? std::sqrt(variance / (samples.size() - 1)) : 0;
+    auto [min, max] = std::minmax_element(samples.begin(), samples.end());
+    result.min = *min;
+    result.max = *max;
+    return result;
+  }
+
+  const Options& options_;
+  std::vector<Result> results_;
+};
+
+// the synthetic ROM's machine, with tiles using every color and a map using all of
+// them so the PPU has something to draw
+std::unique_ptr<Headless> SyntheticMachine(ExecutionMode mode = ExecutionMode::Interpreter) {
+  auto machine = std::make_unique<Headless>(std::make_unique<Cartridge>(SyntheticRom()), mode);
+  for (u16 i = 0; i < 0x1000; i++) {
+    machine->bus_.Write(VRAM_START_ADDRESS + i, (u8)(i * 0x9D + (i >> 4)));
+  }
+  for (u16 i = 0; i < 0x400; i++) {
+    machine->bus_.Write(0x9800 + i, (u8) i);
+  }
+  return machine;
+}
+
+// with the PPU at the first dot of line 0
+void SyncToFrameStart(Headless& machine) {
+  while (machine.cpu_->ly_ != 0 || machine.cpu_->lcds_.bits.ppu_mode == kPPUModeVBlank) {
+    machine.ppu_->Step();
+  }
+}
+
+// Blocks too short to hold a match, literal and match lengths that need extra length
+// bytes, matches that overlap their own output and data without any repeats have to
+// come back unchanged, and cutting a block short or asking for more output must fail.
+bool CheckCompress() {
+  std::mt19937 rng(1);
+  auto random = [&](size_t size) {
+    std::vector<u8> data(size);
+    for (u8& byte : data) {
+      byte = (u8) rng();
+    }
+    return data;
+  };
+  std::vector<std::pair<std::string, std::vector<u8>>> inputs;
+  for (size_t size = 0; size <= 12; size++) {
+    inputs.emplace_back(fmt::format("zeroes/{}", size), std::vector<u8>(size, 0));
+    inputs.emplace_back(fmt::format("random/{}", size), random(size));
+  }
+  inputs.emplace_back("zeroes/13", std::vector<u8>(13, 0));
+  inputs.emplace_back("zeroes/100000", std::vector<u8>(100000, 0));
+  inputs.emplace_back("random/300", random(300));
+  inputs.emplace_back("random/100000", random(100000));
+  {
+    // a long match a kilobyte back, then one that overlaps itself
+    std::vector<u8> data = random(1000);
+    for (u32 i = 0; i < 40; i++) {
+      data.insert(data.end(), data.begin(), data.begin() + 1000);
+    }
+    data.insert(data.end(), 5000, 0xAB);
+    std::vector<u8> tail = random(20);
+    data.insert(data.end(), tail.begin(), tail.end());
+    inputs.emplace_back("repeated/46020", std::move(data));
+  }
+  bool ok = true;
+  for (const auto& [name, input] : inputs) {
+    std::vector<u8> compressed(Compress::CompressBound(input.size()));
+    size_t size = Compress::CompressBlock(input, compressed.data());
+    compressed.resize(size);
+    std::vector<u8> output(input.size());
+    bool round_trip = size <= Compress::CompressBound(input.size()) && Compress::DecompressBlock(compressed, output) &&
+                      output == input;
+    std::vector<u8> larger(input.size() + 1);
+    bool rejects = !Compress::DecompressBlock(compressed, larger) &&
+                   (size == 1 || !Compress::DecompressBlock({compressed.data(), size - 1}, output));
+    if (!round_trip || !rejects) {
+      std::cerr << fmt::format("compress/{}: {}", name, round_trip ? "accepted a corrupt block" : "round trip failed")
+                << std::endl;
+      ok = false;
+    }
+  }
+  if (ok) {
+    std::cout << fmt::format("compress: {} blocks round trip", inputs.size()) << std::endl;
+  }
+  return ok;
+}
+
+// Records written to a trace file come back block by block, a block that claims more
+// records than it could hold is refused instead of allocated.
+bool CheckTraceFile() {
+  std::string path = (std::filesystem::temp_directory_path() / "laneboy-bench.trace").string();
+  std::vector<TraceRecord> written(kTraceMaxBlockRecords + 100);
+  for (size_t i = 0; i < written.size(); i++) {
+    written[i].cycles = i * 4;
+    written[i].pc = 0x150 + (i % 7);
+    written[i].a = (u8) (i / 3);
+  }
+  TraceWriter writer;
+  if (!writer.Open(path)) {
+    std::cerr << "trace: unable to write " << path << std::endl;
+    return false;
+  }
+  writer.WriteBlock({written.data(), kTraceMaxBlockRecords});
+  writer.WriteBlock({written.data() + kTraceMaxBlockRecords, 100});
+  writer.Close();
+  {
+    // a third block with a corrupt count
+    std::ofstream file(path, std::ios::binary | std::ios::app);
+    u32 header[2] = {0x40000000, 16};
+    file.write((const char*) header, sizeof(header));
+    file.write(std::string(16, 0).data(), 16);
+  }
+  TraceReader reader;
+  std::vector<TraceRecord> read;
+  std::vector<TraceRecord> records;
+  bool ok = reader.Open(path);
+  while (ok && reader.ReadBlock(records)) {
+    read.insert(read.end(), records.begin(), records.end());
+  }
+  std::filesystem::remove(path);
+  ok = ok && read.size() == written.size() &&
+       std::memcmp(read.data(), written.data(), written.size() * sizeof(TraceRecord)) == 0;
+  if (!ok) {
+    std::cerr << fmt::format("trace: read {} of {} records back", read.size(), written.size()) << std::endl;
+    return false;
+  }
+  std::cout << "trace: records round trip, a corrupt block count is refused" << std::endl;
+  return true;
+}
+
+// what a snapshot check compares, the picture and WRAM as the CPU sees it
+struct MachineState {
+  u64 output_hash;
+  std::vector<u8> wram;
+
+  bool operator==(const MachineState&) const = default;
+};
+
+MachineState StateOf(Headless& machine) {
+  MachineState state{machine.HashOutput(), {}};
+  for (u32 address = WRAM_0_START_ADDRESS; address <= WRAM_1_7_END_ADDRESS; address++) {
+    state.wram.push_back(machine.bus_.Peek(address));
+  }
+  return state;
+}
+
+void RunFrames(Headless& machine, u32 frames, u8 buttons) {
+  for (u32 i = 0; i < frames; i++) {
+    machine.cpu_->SetButtons(buttons);
+    machine.RunFrame();
+  }
+}
+
+// Machines forked from one snapshot and fed different buttons, a frame at a time each
+// in turn, have to end up where a machine that ran the same frames from power on does,
+// while the parent they share their RAM banks with stays where it was. Loading a Copy
+// mode snapshot has to give the same as loading a Share mode one. The joypad ROM of
+// the default corpus picks what it writes to WRAM by the buttons.
+bool CheckSnapshots() {
+  static constexpr u32 kFrames = 20;
+  static constexpr u8 kInputs[] = {0, kJoypadRight | kJoypadA, kJoypadDown | kJoypadB, kJoypadLeft | kJoypadA | kJoypadB};
+  const CorpusRom& rom = DefaultCorpus()[1];
+  auto machine = [&rom]() { return std::make_unique<Headless>(std::make_unique<Cartridge>(rom.build())); };
+  bool ok = true;
+  auto expect = [&ok](bool holds, const std::string& what) {
+    if (!holds) {
+      std::cerr << "snapshot: " << what << std::endl;
+      ok = false;
+    }
+  };
+
+  std::vector<MachineState> expected;
+  for (u8 buttons : kInputs) {
+    std::unique_ptr<Headless> reference = machine();
+    RunFrames(*reference, kFrames, 0);
+    RunFrames(*reference, kFrames, buttons);
+    expected.push_back(StateOf(*reference));
+  }
+
+  std::unique_ptr<Headless> parent = machine();
+  RunFrames(*parent, kFrames, 0);
+  MachineState saved = StateOf(*parent);
+  Snapshot snapshot = parent->Save();
+  std::vector<std::unique_ptr<Headless>> children;
+  for (size_t i = 0; i < std::size(kInputs); i++) {
+    children.push_back(snapshot.Fork());
+  }
+  for (u32 frame = 0; frame < kFrames; frame++) {
+    for (size_t i = 0; i < children.size(); i++) {
+      RunFrames(*children[i], 1, kInputs[i]);
+    }
+  }
+  expect(StateOf(*parent) == saved, "the children's frames changed the parent");
+  for (size_t i = 0; i < children.size(); i++) {
+    MachineState state = StateOf(*children[i]);
+    expect(state == expected[i], fmt::format("fork {} didn't run like a machine from power on", i));
+    for (size_t j = 0; j < i; j++) {
+      expect(!(expected[j] == expected[i]), fmt::format("inputs {} and {} ran the same", j, i));
+    }
+  }
+  // the parent writes to the banks its children were forked with
+  RunFrames(*parent, kFrames, kInputs[1]);
+  expect(StateOf(*parent) == expected[1], "the parent didn't run on like a machine from power on");
+  expect(StateOf(*children[0]) == expected[0], "the parent's frames changed a fork");
+
+  for (BankMode mode : {BankMode::Share, BankMode::Copy}) {
+    parent = machine();
+    RunFrames(*parent, kFrames, 0);
+    Snapshot saved_snapshot = parent->Save(mode);
+    RunFrames(*parent, kFrames, kInputs[3]);
+    parent->Load(saved_snapshot);
+    RunFrames(*parent, kFrames, kInputs[2]);
+    const char* name = mode == BankMode::Share ? "share" : "copy";
+    expect(StateOf(*parent) == expected[2], fmt::format("{} mode save and load didn't round trip", name));
+  }
+  if (ok) {
+    std::cout << fmt::format("snapshot: {} forks isolated, copy and share mode loads agree", children.size())
+              << std::endl;
+  }
+  return ok;
+}
+
+// A machine that gets another cartridge and is reset, the way Emulator::LoadCartridge
+// reloads, has to run like one built for that cartridge, and swapping back and forth
+// must not use up the arena.
+bool CheckReload() {
+  static constexpr u32 kFrames = 20;
+  auto cartridge = [](size_t index) { return std::make_unique<Cartridge>(DefaultCorpus()[index].build()); };
+  std::vector<MachineState> expected;
+  for (size_t index : {0, 1}) {
+    auto reference = std::make_unique<Headless>(cartridge(index));
+    RunFrames(*reference, kFrames, kJoypadRight | kJoypadA);
+    expected.push_back(StateOf(*reference));
+  }
+
+  bool ok = true;
+  auto machine = std::make_unique<Headless>(cartridge(0));
+  RunFrames(*machine, kFrames, 0);
+  size_t used = 0;
+  for (size_t index : {1, 0, 1}) {
+    machine->cpu_->LoadCartridge(cartridge(index));
+    machine->Reset();
+    RunFrames(*machine, kFrames, kJoypadRight | kJoypadA);
+    if (!(StateOf(*machine) == expected[index])) {
+      std::cerr << fmt::format("reload: {} didn't run like on a machine built for it", DefaultCorpus()[index].name)
+                << std::endl;
+      ok = false;
+    }
+    if (used != 0 && machine->bus_.arena().used() > used) {
+      std::cerr << "reload: the last cartridge's space in the arena wasn't reused" << std::endl;
+      ok = false;
+    }
+    used = std::max(used, machine->bus_.arena().used());
+  }
+  if (ok) {
+    std::cout << "reload: cartridges swap in place" << std::endl;
+  }
+  return ok;
+}
+
+// Every valid opcode runs once from WRAM in each execution mode, with the flags clear
+// and set so conditional branches go both ways, and has to take the T-cycles and the
+// length kOpcodes has for it. The threaded interpreter runs on into the next handler
+// after straight-line instructions, a HALT behind the instruction stops it there.
+// A HALT that hits the halt bug has to double the next opcode read in every mode too.
+bool CheckOpcodes() {
+  static constexpr u16 kCode = WRAM_0_START_ADDRESS;
+  // n16 operands, HL, BC, DE and the return address on the stack all point somewhere else
+  static constexpr u16 kTarget = 0xD000;
+  static constexpr u8 kHalt = 0x76;
+  bool ok = true;
+  for (ExecutionMode mode : {ExecutionMode::Interpreter, ExecutionMode::Threaded}) {
+    if (!IsExecutionModeAvailable(mode)) {
+      continue;
+    }
+    std::unique_ptr<Headless> machine = SyntheticMachine(mode);
+    CPU& cpu = *machine->cpu_;
+    u32 checked = 0;
+    for (u16 index = 0; index < kOpcodes.size(); index++) {
+      const OpcodeInfo& info = kOpcodes[index];
+      if (!info.valid() || index == 0xCB) {
+        continue;
+      }
+      std::array<u8, 3> code = {(u8) index, 0x10, kTarget >> 8};
+      if (index > 0xFF) {
+        code = {0xCB, (u8) index, 0};
+      } else if (info.length == 3) {
+        code[1] = kTarget & 0xFF;
+      }
+      std::string_view mnemonic = info.format;
+      bool jump = mnemonic.starts_with("J") || mnemonic.starts_with("CALL") || mnemonic.starts_with("RET") ||
+                  mnemonic.starts_with("RST");
+      for (u8 flags : {0x00, 0xF0}) {
+        machine->Reset();
+        machine->bus_.Write(0xFFFF, (u8) 0); // IE, HALT must not hit the halt bug
+        machine->bus_.Write(0xFF0F, (u8) 0);
+        for (u8 i = 0; i < info.length; i++) {
+          machine->bus_.Write(kCode + i, code[i]);
+        }
+        machine->bus_.Write(kCode + info.length, kHalt);
+        machine->bus_.WriteWord(0xDFF0, kTarget + 0x300);
+        cpu.registers_.Set<ArithmeticTarget::BC>(kTarget + 0x200);
+        cpu.registers_.Set<ArithmeticTarget::DE>(kTarget + 0x200);
+        cpu.registers_.Set<ArithmeticTarget::HL>(kTarget + 0x100);
+        cpu.registers_.set_sp(0xDFF0);
+        cpu.registers_.flags.FromByte(flags);
+        cpu.registers_.pc = kCode;
+#ifdef HAVE_THREADED_INTERPRETER
+        if (mode == ExecutionMode::Threaded) {
+          cpu.StepThreaded(1);
+        } else {
+          cpu.Step();
+        }
+#else
+        cpu.Step();
+#endif
+        u32 cycles = cpu.cycles_consumed_;
+        u16 pc = cpu.registers_.pc;
+        if (mode == ExecutionMode::Threaded && cpu.halted_ && code[0] != kHalt && code[0] != 0x10) {
+          // ran into the HALT
+          cycles -= Opcode(kHalt).cycles;
+          pc -= 1;
+        }
+        bool taken = pc != kCode + info.length;
+        u32 expected = taken ? info.cycles_taken : info.cycles;
+        if ((taken && !jump) || cycles != expected) {
+          std::cerr << fmt::format("opcodes/{}: {} ({:03X}) with flags {:02X} took {} cycles to {:04X}, "
+                                   "kOpcodes says {} cycles and {} bytes",
+                                   ExecutionModeToString(mode), info.format, index, flags, cycles, pc, expected,
+                                   info.length)
+                    << std::endl;
+          ok = false;
+        }
+      }
+      checked++;
+    }
+
+    // HALT with an interrupt pending and IME off doesn't halt, the INC B after it is
+    // read twice, so B counts three by the time the JR loops on itself
+    machine->Reset();
+    machine->bus_.Write(0xFFFF, (u8) kInterruptTypeVBlank);
+    machine->bus_.Write(0xFF0F, (u8) kInterruptTypeVBlank);
+    std::array<u8, 5> halt_bug = {kHalt, 0x04, 0x04, 0x18, 0xFE}; // HALT, INC B, INC B, JR -2
+    for (u8 i = 0; i < halt_bug.size(); i++) {
+      machine->bus_.Write(kCode + i, halt_bug[i]);
+    }
+    cpu.registers_.Set<ArithmeticTarget::B>(0);
+    cpu.registers_.pc = kCode;
+    for (u32 i = 0; i < 8; i++) {
+      machine->Step();
+    }
+    u8 b = cpu.registers_.Get<ArithmeticTarget::B>();
+    if (b != 3 || cpu.registers_.pc != kCode + 3) {
+      std::cerr << fmt::format("opcodes/{}: the halt bug left B at {} and the PC at {:04X}, expected 3 and {:04X}",
+                               ExecutionModeToString(mode), b, cpu.registers_.pc, kCode + 3)
+                << std::endl;
+      ok = false;
+    }
+    std::cout << fmt::format("opcodes/{}: {} opcodes checked against kOpcodes", ExecutionModeToString(mode), checked)
+              << std::endl;
+  }
+  return ok;
+}
+
+#ifndef STEP_EVERY_INSTRUCTION
+// Every loop of kLoopPatterns runs to its end twice, from WRAM where CPU::Step hands it
+// to RunIdiom and from HRAM, whose page no idiom runs in, one instruction at a time.
+// Registers, flags, cycles, instruction counts and all of memory have to agree, for
+// counters of 1, 0 (256 or 65536 iterations) and others, for overlapping copies and
+// for copies and fills running through OAM into the I/O registers.
+bool CheckIdioms() {
+  static constexpr u16 kFast = WRAM_0_START_ADDRESS;
+  static constexpr u16 kStepped = HRAM_START_ADDRESS;
+  struct Case {
+    u16 counter;
+    u16 hl;
+    u16 de;
+  };
+  // HL and DE are the source and the destination in either order
+  static constexpr Case kCopies[] = {
+      {0x0123, 0xC200, 0xC800}, {0x0001, 0xC200, 0xC800}, {0x0200, 0xC300, 0xC310},
+      {0x0200, 0xC310, 0xC300}, {0x0110, 0xFE00, 0xC400}, {0x0110, 0xC400, 0xFE00},
+      {0x0000, 0x0000, 0x0000}, // 65536 bytes, each onto itself so the loops stay in place
+  };
+  // the last ones run through OAM and the I/O registers, short of the loop in HRAM
+  static constexpr Case kFills[] = {
+      {0x10, 0xC200, 0}, {0x01, 0xC200, 0}, {0x00, 0xC180, 0}, {0x90, 0xFE80, 0},
+  };
+  static constexpr Case kDecrementFills[] = {
+      {0x10, 0xC200, 0}, {0x01, 0xC200, 0}, {0x00, 0xC180, 0}, {0x90, 0xFF0F, 0},
+  };
+  struct Outcome {
+    std::array<u8, 10> registers;
+    u8 flags;
+    u16 pc;
+    u64 cycles;
+    u32 instructions;
+    std::vector<u8> memory;
+
+    bool operator==(const Outcome&) const = default;
+  };
+  auto run = [](const LoopPattern& pattern, const Case& test, u16 head) {
+    std::unique_ptr<Headless> machine = SyntheticMachine();
+    CPU& cpu = *machine->cpu_;
+    for (u16 address = 0xC100; address < 0xDF00; address++) {
+      machine->bus_.Write(address, (u8)(address * 0x9D + (address >> 8)));
+    }
+    for (u8 i = 0; i < pattern.length; i++) {
+      machine->bus_.Write(kFast + i, pattern.bytes[i]);
+      machine->bus_.Write(kStepped + i, pattern.bytes[i]);
+    }
+    cpu.registers_.Set<ArithmeticTarget::A>(0x5A);
+    cpu.registers_.Set<ArithmeticTarget::BC>(0x3333);
+    if (pattern.idiom == LoopIdiom::CopyHLToDE || pattern.idiom == LoopIdiom::CopyDEToHL) {
+      cpu.registers_.Set<ArithmeticTarget::BC>(test.counter);
+    } else if (pattern.idiom == LoopIdiom::FillIncrementB || pattern.idiom == LoopIdiom::FillDecrementB) {
+      cpu.registers_.Set<ArithmeticTarget::B>(test.counter);
+    } else {
+      cpu.registers_.Set<ArithmeticTarget::C>(test.counter);
+    }
+    cpu.registers_.Set<ArithmeticTarget::HL>(test.hl);
+    cpu.registers_.Set<ArithmeticTarget::DE>(test.de);
+    cpu.registers_.set_sp(0xDFF0);
+    cpu.registers_.flags.FromByte(0);
+    cpu.registers_.pc = head;
+    Outcome outcome{};
+    u32 ic = cpu.ic_;
+    // a little over the most a loop can take, 65536 iterations of 7 instructions
+    for (u32 steps = 0; cpu.registers_.pc != head + pattern.length && steps < 500000; steps++) {
+      cpu.Step();
+      outcome.cycles += cpu.cycles_consumed_;
+    }
+    outcome.registers = cpu.registers_.file;
+    outcome.flags = cpu.registers_.flags.ToByte();
+    outcome.pc = cpu.registers_.pc - head;
+    outcome.instructions = cpu.ic_ - ic;
+    for (u32 address = 0; address < 0x10000; address++) {
+      outcome.memory.push_back(machine->bus_.Peek(address));
+    }
+    return outcome;
+  };
+
+  bool ok = true;
+  u32 checked = 0;
+  for (const LoopPattern& pattern : kLoopPatterns) {
+    std::span<const Case> cases = kFills;
+    if (pattern.idiom == LoopIdiom::CopyHLToDE || pattern.idiom == LoopIdiom::CopyDEToHL) {
+      cases = kCopies;
+    } else if (pattern.idiom == LoopIdiom::FillDecrementB || pattern.idiom == LoopIdiom::FillDecrementC) {
+      cases = kDecrementFills;
+    }
+    for (const Case& test : cases) {
+      Outcome fast = run(pattern, test, kFast);
+      Outcome stepped = run(pattern, test, kStepped);
+      checked++;
+      if (fast == stepped) {
+        continue;
+      }
+      std::string what = fast.registers != stepped.registers ? "registers"
+          : fast.flags != stepped.flags ? "flags"
+          : fast.pc != stepped.pc ? "end"
+          : fast.cycles != stepped.cycles ? fmt::format("cycles {} != {}", fast.cycles, stepped.cycles)
+          : fast.instructions != stepped.instructions ? "instruction count"
+          : "memory";
+      std::cerr << fmt::format("idioms: {:02X} {:02X} with counter {:04X}, HL {:04X}, DE {:04X} differs from "
+                               "stepping in its {}",
+                               pattern.bytes[0], pattern.bytes[1], test.counter, test.hl, test.de, what)
+                << std::endl;
+      ok = false;
+    }
+  }
+  if (ok) {
+    std::cout << fmt::format("idioms: {} loops run like stepping them", checked) << std::endl;
+  }
+  return ok;
+}
+#endif
+
+#ifdef ENABLE_ALLOCATION_COUNTER
+// Frames after the warmup and resetting the machine must not allocate, a frame that
+// does is reported and fails the check. Recompiled mode is left out, the synthetic ROM
+// has no module.
+bool CheckAllocations() {
+  static constexpr u32 kWarmupFrames = 10;
+  static constexpr u32 kCheckedFrames = 120;
+  bool ok = true;
+  for (ExecutionMode mode : {ExecutionMode::Interpreter, ExecutionMode::Threaded}) {
+    if (!IsExecutionModeAvailable(mode)) {
+      continue;
+    }
+    std::unique_ptr<Headless> machine = SyntheticMachine(mode);
+    for (u32 frame = 0; frame < kWarmupFrames; frame++) {
+      machine->RunFrame();
+    }
+    u32 frame = 0;
+    for (; frame < kCheckedFrames; frame++) {
+      u64 before = Allocations::Count();
+      machine->RunFrame();
+      u64 allocations = Allocations::Count() - before;
+      if (allocations != 0) {
+        std::cerr << fmt::format("allocations/{}: frame {} allocated {} times", ExecutionModeToString(mode),
+                                 kWarmupFrames + frame, allocations)
+                  << std::endl;
+        ok = false;
+        break;
+      }
+    }
+    if (frame == kCheckedFrames) {
+      std::cout << fmt::format("allocations/{}: none in {} frames", ExecutionModeToString(mode), kCheckedFrames)
+                << std::endl;
+    }
+    u64 before = Allocations::Count();
+    machine->Reset();
+    if (u64 allocations = Allocations::Count() - before; allocations != 0) {
+      std::cerr << fmt::format("allocations/{}: reset allocated {} times", ExecutionModeToString(mode), allocations)
+                << std::endl;
+      ok = false;
+    }
+  }
+  return ok;
+}
+#endif
+
+void BenchBus(Runner& runner, Headless& machine) {
+  MemoryBus& bus = machine.bus_;
+  // a spread of addresses in the region, the mask keeps them inside it
+  auto reader = [&bus](u16 base, u16 mask) {
+    return [&bus, base, mask](u64 ops) {
+      u32 sum = 0;
+      for (u64 i = 0; i < ops; i++) {
+        sum += bus.Read(base + ((i * 7) & mask));
+      }
+      sink = sum;
+    };
+  };
+  auto writer = [&bus](u16 base, u16 mask) {
+    return [&bus, base, mask](u64 ops) {
+      for (u64 i = 0; i < ops; i++) {
+        bus.Write(base + ((i * 7) & mask), (u8) i);
+      }
+    };
+  };
+  // plain registers, nothing that starts a DMA or switches banks
+  static constexpr u16 kIORegisters[] = {0xFF42, 0xFF43, 0xFF47, 0xFF48, 0xFF49, 0xFF4A, 0xFF4B, 0xFF06};
+  runner.Run("bus/read/rom", reader(0x0000, 0x7FFF));
+  runner.Run("bus/read/wram", reader(WRAM_0_START_ADDRESS, 0x1FFF));
+  runner.Run("bus/read/hram", reader(HRAM_START_ADDRESS, 0x3F));
+  runner.Run("bus/read/io", [&bus](u64 ops) {
+    u32 sum = 0;
+    for (u64 i = 0; i < ops; i++) {
+      sum += bus.Read(kIORegisters[i & 7]);
+    }
+    sink = sum;
+  });
+  runner.Run("bus/write/wram", writer(WRAM_0_START_ADDRESS, 0x1FFF));
+  runner.Run("bus/write/hram", writer(HRAM_START_ADDRESS, 0x3F));
+  runner.Run("bus/write/io", [&bus](u64 ops) {
+    for (u64 i = 0; i < ops; i++) {
+      bus.Write(kIORegisters[i & 7], (u8) i);
+    }
+  });
+}
+
+// one instruction pattern, appended as many times as fits the loop
+struct OpcodeClass {
+  const char* name;
+  std::function<void(Assembler&)> pattern;
+};
+
+std::function<void(Assembler&)> Repeat(std::initializer_list<u8> bytes) {
+  std::vector<u8> copy(bytes);
+  return [copy](Assembler& assembler) {
+    for (u8 byte : copy) {
+      assembler.Emit({byte});
+    }
+  };
+}
+
+void BenchDispatch(Runner& runner, Headless& machine) {
+  // the loop runs from WRAM, [HL] and the CALL target are past its end
+  static constexpr u16 kStart = WRAM_0_START_ADDRESS;
+  static constexpr u16 kData = 0xC800;
+  static constexpr u16 kSubroutine = 0xC900;
+  static constexpr u16 kLoopSize = 0x400;
+
+  const OpcodeClass classes[] = {
+      {"nop", Repeat({0x00})},
+      {"ld r, r", Repeat({0x41, 0x4A, 0x53, 0x5C, 0x78, 0x47})},
+      {"ld r, n8", Repeat({0x06, 0x12, 0x0E, 0x34, 0x3E, 0x56})},
+      {"ld r, [hl]", Repeat({0x46, 0x4E, 0x7E})},
+      {"ld [hl], r", Repeat({0x70, 0x71, 0x77})},
+      {"ld a, [a16]", [](Assembler& a) { a.Emit16(0xFA, kData); a.Emit16(0xEA, kData + 1); }},
+      {"ldh", Repeat({0xE0, 0x80, 0xF0, 0x80})},
+      {"alu a, r", Repeat({0x80, 0x88, 0x90, 0x98, 0xA0, 0xA8, 0xB0, 0xB8})},
+      {"alu a, n8", Repeat({0xC6, 0x01, 0xD6, 0x01, 0xE6, 0xFF, 0xFE, 0x00})},
+      {"inc/dec r", Repeat({0x04, 0x05, 0x0C, 0x0D, 0x3C, 0x3D})},
+      {"16-bit alu", Repeat({0x03, 0x0B, 0x13, 0x1B, 0x09})},
+      {"jr", Repeat({0x18, 0x00})},
+      {"jp", [](Assembler& a) { a.Emit16(0xC3, a.here() + 3); }},
+      {"call/ret", [](Assembler& a) { a.Emit16(0xCD, kSubroutine); }},
+      {"push/pop", Repeat({0xC5, 0xD1})},
+      {"cb shift", Repeat({0xCB, 0x00, 0xCB, 0x11, 0xCB, 0x22, 0xCB, 0x3B})},
+      {"cb bit", Repeat({0xCB, 0x40, 0xCB, 0x7F, 0xCB, 0x46})},
+      {"cb set/res", Repeat({0xCB, 0xC0, 0xCB, 0x87, 0xCB, 0xC6})},
+  };
+
+  CPU& cpu = *machine.cpu_;
+  for (const OpcodeClass& opcode_class : classes) {
+    std::vector<u8> code;
+    Assembler assembler(code, kStart);
+    assembler.Emit16(0x21, kData); // LD HL, kData
+    assembler.Emit16(0x31, 0xFFFE); // LD SP, $FFFE
+    u16 loop = assembler.here();
+    while (code.size() < kLoopSize) {
+      opcode_class.pattern(assembler);
+    }
+    assembler.Emit16(0xC3, loop); // JP loop
+    for (u16 i = 0; i < code.size(); i++) {
+      machine.bus_.Write(kStart + i, code[i]);
+    }
+    machine.bus_.Write(kSubroutine, (u8) 0xC9); // RET
+
+    cpu.registers_.pc = kStart;
+    cpu.halted_ = false;
+    cpu.SetInterruptMasterEnable(false, true);
+    // timers and interrupts aren't run, a sample is only fetch, decode and execute
+    runner.Run(fmt::format("dispatch/{}", opcode_class.name), [&cpu](u64 ops) {
+      for (u64 i = 0; i < ops; i++) {
+        cpu.Step();
+      }
+    });
+  }
+}
+
+void BenchPPU(Runner& runner, Headless& machine) {
+  PPU& ppu = *machine.ppu_;
+  runner.Run("ppu/fetch_tile", [&ppu](u64 ops) {
+    u32 sum = 0;
+    for (u64 i = 0; i < ops; i++) {
+      std::array<Pixel, 8> tile = ppu.FetchTile(i & 0xFF, i & 7, i & 0x100);
+      sum += tile[0].color + tile[7].color;
+    }
+    sink = sum;
+  });
+  // a sample is the 144 visible lines of a frame, VBlank is stepped through by the setup
+  runner.Run("ppu/scanline", [&machine](u64 ops) {
+    for (u64 i = 0; i < ops; i++) {
+      u8 line = machine.cpu_->ly_;
+      while (machine.cpu_->ly_ == line) {
+        machine.ppu_->Step();
+      }
+    }
+  }, 144, [&machine]() { SyncToFrameStart(machine); });
+}
+
+void BenchFrame(Runner& runner, Headless& machine, const std::string& name = "frame/synthetic") {
+  runner.Run(name, [&machine](u64 ops) {
+    for (u64 i = 0; i < ops; i++) {
+      machine.RunFrame();
+    }
+  });
+}
+
+void BenchReset(Runner& runner, Headless& machine) {
+  // a power cycle in place, what a batch run pays per episode
+  runner.Run("machine/reset", [&machine](u64 ops) {
+    for (u64 i = 0; i < ops; i++) {
+      machine.Reset();
+    }
+  });
+}
+
+void BenchSnapshot(Runner& runner, Headless& machine) {
+  // after a frame, the banks it wrote are frozen again
+  runner.Run("snapshot/save", [&machine](u64 ops) {
+    for (u64 i = 0; i < ops; i++) {
+      Snapshot snapshot = machine.Save();
+      sink = snapshot.size();
+    }
+  }, 1, [&machine]() { machine.RunFrame(); });
+  Snapshot snapshot = machine.Save();
+  // what a pool of machines pays per fork, machine has its own banks again after a frame
+  runner.Run("snapshot/load", [&machine, &snapshot](u64 ops) {
+    for (u64 i = 0; i < ops; i++) {
+      machine.Load(snapshot);
+    }
+  }, 1, [&machine]() { machine.RunFrame(); });
+  runner.Run("snapshot/fork", [&snapshot](u64 ops) {
+    for (u64 i = 0; i < ops; i++) {
+      std::unique_ptr<Headless> child = snapshot.Fork();
+      sink = child->cpu_->registers_.pc;
+    }
+  });
+  // the full cycle without sharing, every bank is copied out and back in
+  runner.Run("snapshot/copy_save_load", [&machine](u64 ops) {
+    for (u64 i = 0; i < ops; i++) {
+      machine.Load(machine.Save(BankMode::Copy));
+    }
+  }, 1, [&machine]() { machine.RunFrame(); });
+}
+
+void BenchTexture(Runner& runner) {
+  std::unique_ptr<Texture> texture = CreateMemoryTexture(160, 144);
+  TextureWrapper wrapper(*texture);
+  runner.Run("texture/set_pixel", [&wrapper](u64 ops) {
+    u32 x = 0;
+    u32 y = 0;
+    for (u64 i = 0; i < ops; i++) {
+      wrapper.SetPixel(x, y, {(u8) i, 0x80, 0x40, 255});
+      if (++x == 160) {
+        x = 0;
+        y = y == 143 ? 0 : y + 1;
+      }
+    }
+  });
+  runner.Run("texture/fill", [&wrapper](u64 ops) {
+    for (u64 i = 0; i < ops; i++) {
+      wrapper.Fill({(u8) i, 0x80, 0x40, 255});
+    }
+  });
+}
+
+std::string JsonEscape(const std::string& text) {
+  std::string out;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+    }
+    out += c;
+  }
+  return out;
+}
+
+bool WriteJson(const std::string& path, const Options& options, const std::vector<Result>& results) {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    return false;
+  }
+  // what the numbers depend on besides the host
+  std::vector<std::string> config;
+#ifdef LAZY_FLAGS
+  config.push_back("lazy_flags");
+#endif
+#ifdef USE_THREADED_INTERPRETER
+  config.push_back("threaded_interpreter");
+#endif
+#ifdef STEP_EVERY_INSTRUCTION
+  config.push_back("step_every_instruction");
+#endif
+#ifdef ENABLE_INSTRUMENTATION
+  config.push_back("instrument");
+#endif
+#ifdef ENABLE_ALLOCATION_COUNTER
+  config.push_back("count_allocations");
+#endif
+  std::string out = "{\n  \"config\": [";
+  for (size_t i = 0; i < config.size(); i++) {
+    out += fmt::format("{}\"{}\"", i ? ", " : "", config[i]);
+  }
+  out += fmt::format("],\n  \"samples\": {},\n  \"min_time_ms\": {},\n  \"benchmarks\": [\n", options.samples,
+                     options.min_time_ms);
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& r = results[i];
+    out += fmt::format("    {{\"name\": \"{}\", \"unit\": \"ns/op\", \"ops_per_sample\": {}, \"median\": {:.3f}, "
+                       "\"mad\": {:.3f}, \"mean\": {:.3f}, \"stddev\": {:.3f}, \"min\": {:.3f}, \"max\": {:.3f}}}{}\n",
+                       JsonEscape(r.name), r.ops, r.median, r.mad, r.mean, r.stddev, r.min, r.max,
+                       i + 1 < results.size() ? "," : "");
+  }
+  out += "  ]\n}\n";
+  file << out;
+  return true;
+}
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--list") {
+      options.list = true;
+    } else if (arg == "--filter" && has_value) {
+      options.filter = argv[++i];
+    } else if (arg == "--samples" && has_value) {
+      options.samples = std::max(1, std::atoi(argv[++i]));
+    } else if (arg == "--min-time" && has_value) {
+      options.min_time_ms = std::max(0.1, std::atof(argv[++i]));
+    } else if (arg == "--cpu" && has_value) {
+      options.cpu = std::atoi(argv[++i]);
+    } else if (arg == "--json" && has_value) {
+      options.json_path = argv[++i];
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, options)) {
+    std::cerr << "usage: " << argv[0]
+              << " [--filter text] [--samples n] [--min-time ms] [--cpu n] [--json output.json] [--list]" << std::endl;
+    return 1;
+  }
+#ifdef __linux__
+  if (options.cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(options.cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+      std::cerr << "unable to pin to cpu " << options.cpu << std::endl;
+    }
+  }
+#endif
+#ifdef STEP_EVERY_INSTRUCTION
+  std::cerr << "built with a debugging feature, the numbers don't reflect a release build" << std::endl;
+#endif
+
+  if (!options.list && (!CheckOpcodes() || !CheckCompress() || !CheckTraceFile() ||
+                        !CheckSnapshots() || !CheckReload())) {
+    return 1;
+  }
+#ifndef STEP_EVERY_INSTRUCTION
+  if (!options.list && !CheckIdioms()) {
+    return 1;
+  }
+#endif
+#ifdef ENABLE_ALLOCATION_COUNTER
+  if (!options.list && !CheckAllocations()) {
+    return 1;
+  }
+#endif
+
+  Runner runner(options);
+  {
+    std::unique_ptr<Headless> machine = SyntheticMachine();
+    machine->RunFrame(); // the ROM turns the LCD on
+    BenchBus(runner, *machine);
+    BenchPPU(runner, *machine);
+    BenchFrame(runner, *machine);
+    BenchReset(runner, *machine);
+  }
+  {
+    std::unique_ptr<Headless> machine = SyntheticMachine();
+    machine->RunFrame();
+    BenchSnapshot(runner, *machine);
+  }
+  if (IsExecutionModeAvailable(ExecutionMode::Threaded)) {
+    std::unique_ptr<Headless> machine = SyntheticMachine(ExecutionMode::Threaded);
+    machine->RunFrame();
+    BenchFrame(runner, *machine, "frame/synthetic/threaded");
+  }
+  {
+    // the dispatch loops overwrite WRAM and the registers, they get a machine of their own
+    BenchDispatch(runner, *SyntheticMachine());
+  }
+  BenchTexture(runner);
+
+  if (!options.json_path.empty() && !options.list) {
+    if (!WriteJson(options.json_path, options, runner.results())) {
+      std::cerr << "unable to write " << options.json_path << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -1,5 +1,7 @@
 #include "cartridge.h"
+#include "coverage.h"
 #include "debug.h"
+#include "state.h"
 
 u32 DetermineROMBankNumber(ROMSize rom_size) {
   switch (rom_size) {
@@ -27,13 +29,17 @@ u32 DetermineRAMBankNumber(RAMSize rom_size) {
   }
 }
 
-Cartridge::Cartridge(const std::string& path) {
-  data_ = LoadBin(path);
-  if (data_.empty()) {
+Cartridge::Cartridge(const std::string& path) : Cartridge(LoadBin(path)) {
+  path_ = path;
+}
+
+Cartridge::Cartridge(std::vector<u8> data) : data_(std::make_shared<const std::vector<u8>>(std::move(data))) {
+  const std::vector<u8>& rom = *data_;
+  if (rom.empty()) {
     is_valid_ = false;
     return;
   }
-  u8 cgbflag = data_[0x143] & 0b11011111;
+  u8 cgbflag = rom[0x143] & 0b11011111;
   if (cgbflag == 0b10000000) {
     compatibility_ = CartridgeCompatibility::Both;
   } else if (cgbflag == 0b11000000) {
@@ -41,12 +47,12 @@ Cartridge::Cartridge(const std::string& path) {
   } else {
     compatibility_ = CartridgeCompatibility::OnlyDMG;
   }
-  type_ = (CartridgeType) data_[0x0147];
+  type_ = (CartridgeType) rom[0x0147];
   std::cout << "cartridge type: " << (u64)type_ << std::endl;
 
-  rom_size_ = (ROMSize) data_[0x148];
+  rom_size_ = (ROMSize) rom[0x148];
   rom_bank_num_ = DetermineROMBankNumber(rom_size_);
-  ram_size_ = (RAMSize) data_[0x149];
+  ram_size_ = (RAMSize) rom[0x149];
   ram_bank_num_ = DetermineRAMBankNumber(ram_size_);
   if (rom_bank_num_ == -1 || ram_bank_num_ == -1) {
     is_valid_ = false;
@@ -57,20 +63,39 @@ Cartridge::Cartridge(const std::string& path) {
 
   // initialize and load roms
   u32 current = 0x0000;
+  rom_banks_ = std::make_shared<ROMBanks>(rom_bank_num_);
   for (int i = 0; i < rom_bank_num_; ++i) {
-    rom_banks_.emplace_back();
-    rom_banks_[i].fill(0);
-    memcpy(rom_banks_[i].data(), data_.data() + current, CARTRIDGE_ROM_SIZE);
+    ROMBanks::value_type& bank = (*rom_banks_)[i];
+    bank.fill(0);
+    memcpy(bank.data(), rom.data() + current, CARTRIDGE_ROM_SIZE);
     current += CARTRIDGE_ROM_SIZE;
   }
-  std::cout << "unread data left: " << data_.size() - current << std::endl;
-  // initialize rams
-  for (int i = 0; i < ram_size_; ++i) {
-    ram_banks_.emplace_back();
-  }
+  std::cout << "unread data left: " << rom.size() - current << std::endl;
+  is_valid_ = true;
+}
+
+std::unique_ptr<Cartridge> Cartridge::Share() const {
+  std::unique_ptr<Cartridge> cartridge(new Cartridge());
+  cartridge->data_ = data_;
+  cartridge->path_ = path_;
+  cartridge->is_valid_ = is_valid_;
+  cartridge->rom_size_ = rom_size_;
+  cartridge->rom_bank_num_ = rom_bank_num_;
+  cartridge->ram_size_ = ram_size_;
+  cartridge->ram_bank_num_ = ram_bank_num_;
+  cartridge->compatibility_ = compatibility_;
+  cartridge->type_ = type_;
+  cartridge->rom_banks_ = rom_banks_;
+  return cartridge;
+}
+
+void Cartridge::InitBus(MemoryBus& bus) {
+  bus_ = &bus;
+  // the bank select register picks one of 4
+  ram_banks_ = bus.arena().NewArray<std::array<u8, CARTRIDGE_RAM_SIZE>>(std::max<u32>(ram_bank_num_, 4));
   ram_bank_select_ = 0;
-  ram_bank_md_ = std::make_unique<SwitchingArrayMemoryDevice<CARTRIDGE_RAM_SIZE>>(CARTRIDGE_RAM_START_ADDRESS, &ram_banks_[0], kMemoryAccessBoth);
-  rom_bank_00_md_ = std::make_unique<SwitchingArrayWithHandlerMemoryDevice<CARTRIDGE_ROM_SIZE>>(CARTRIDGE_ROM_00_START_ADDRESS, &rom_banks_[0], [this](u16 address,u8 previous, u8 value, bool failed) -> bool {
+  ram_bank_md_ = bus.arena().New<CopyOnWriteArrayMemoryDevice<CARTRIDGE_RAM_SIZE>>(CARTRIDGE_RAM_START_ADDRESS, ram_banks_, kMemoryAccessBoth);
+  rom_bank_00_md_ = bus.arena().New<SwitchingArrayWithHandlerMemoryDevice<CARTRIDGE_ROM_SIZE>>(CARTRIDGE_ROM_00_START_ADDRESS, &(*rom_banks_)[0], [this](u16 address,u8 previous, u8 value, bool failed) -> bool {
     //std::cout << "written rom bank 00: " << ToHex(address) << ", " << ToHex(value) << std::endl;
     if (address <= 0x1FFF) { // RAM Enable
       if ((value & 0x0a) == 0x0a) {
@@ -90,19 +115,20 @@ Cartridge::Cartridge(const std::string& path) {
         return previous;
       }
       rom_bank_select_ = new_value;
-      rom_bank_01_md_->Switch(&rom_banks_[rom_bank_select_]);
+      rom_bank_01_md_->Switch(&(*rom_banks_)[rom_bank_select_]);
       //std::cout << "rom bank select: " << ToHex(rom_bank_select_) << std::endl;
+      COVERAGE_BANK_CHANGE(rom_bank_select_);
       EMIT_BANK_CHANGE(*bus_);
     }
     return previous;
   }, kMemoryAccessRead);
   rom_bank_select_ = 1;
-  rom_bank_01_md_ = std::make_unique<SwitchingArrayWithHandlerMemoryDevice<CARTRIDGE_ROM_SIZE>>(CARTRIDGE_ROM_01_START_ADDRESS, &rom_banks_[rom_bank_select_], [this](u16 address,u8 previous, u8 value, bool failed) -> bool {
+  rom_bank_01_md_ = bus.arena().New<SwitchingArrayWithHandlerMemoryDevice<CARTRIDGE_ROM_SIZE>>(CARTRIDGE_ROM_01_START_ADDRESS, &(*rom_banks_)[rom_bank_select_], [this](u16 address,u8 previous, u8 value, bool failed) -> bool {
     //std::cout << "written rom bank 01: " << ToHex(address) << ", " << ToHex(value) << std::endl;
     if (address >= 0xA000 && address <= 0xBFFF) {
       //std::cout << "written " << ToHex(value) << " to ram select." << std::endl;
       ram_bank_select_ = value & 0x03;
-      ram_bank_md_->Switch(&ram_banks_[ram_bank_select_]);
+      ram_bank_md_->Switch(ram_bank_select_);
       //std::cout << "ram bank select: " << ToHex(ram_bank_select_) << std::endl;
       EMIT_BANK_CHANGE(*bus_);
     } else if (address >= 0x4000 && address <= 0x5FFF) {
@@ -110,11 +136,6 @@ Cartridge::Cartridge(const std::string& path) {
     }
     return previous;
   }, kMemoryAccessRead);
-  is_valid_ = true;
-}
-
-void Cartridge::InitBus(MemoryBus& bus) {
-  bus_ = &bus;
   bus.AddDevice(CARTRIDGE_ROM_00_START_ADDRESS, CARTRIDGE_ROM_00_END_ADDRESS, rom_bank_00_md_.get());
   if (rom_bank_num_ > 1) {
     bus.AddDevice(CARTRIDGE_ROM_01_START_ADDRESS, CARTRIDGE_ROM_01_END_ADDRESS, rom_bank_01_md_.get());
@@ -122,5 +143,39 @@ void Cartridge::InitBus(MemoryBus& bus) {
   if (ram_bank_num_ > 0) {
     bus.AddDevice(CARTRIDGE_RAM_START_ADDRESS, CARTRIDGE_RAM_END_ADDRESS, ram_bank_md_.get());
   }
+  COVERAGE_BANK_CHANGE(rom_bank_select_);
   EMIT_BANK_CHANGE(*bus_);
-}
\ No newline at end of file
+}
+
+void Cartridge::RemoveFromBus() {
+  bus_->RemoveDevice(ram_bank_md_.get());
+  bus_->RemoveDevice(rom_bank_01_md_.get());
+  bus_->RemoveDevice(rom_bank_00_md_.get());
+}
+
+void Cartridge::Reset() {
+  rom_bank_select_ = 1;
+  rom_bank_01_md_->Switch(&(*rom_banks_)[rom_bank_select_]);
+  ram_bank_select_ = 0;
+  ram_bank_md_->Switch(ram_bank_select_);
+  ram_bank_md_->EnableAccess(kMemoryAccessBoth);
+  // there are no save files, so RAM starts out empty like on a fresh load
+  ram_bank_md_->Fill(0);
+  COVERAGE_BANK_CHANGE(rom_bank_select_);
+  EMIT_BANK_CHANGE(*bus_);
+}
+
+template<typename Archive>
+void Cartridge::Serialize(Archive& archive) {
+  archive(rom_bank_select_, ram_bank_select_);
+  archive.Access(*ram_bank_md_);
+  archive.Banks(*ram_bank_md_);
+  if constexpr (Archive::kLoading) {
+    rom_bank_01_md_->Switch(&(*rom_banks_)[rom_bank_select_]);
+    COVERAGE_BANK_CHANGE(rom_bank_select_);
+    EMIT_BANK_CHANGE(*bus_);
+  }
+}
+
+template void Cartridge::Serialize(StateWriter& archive);
+template void Cartridge::Serialize(StateReader& archive);
\ No newline at end of file
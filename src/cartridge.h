@@ -68,16 +68,41 @@ u32 DetermineRAMBankNumber(RAMSize rom_size);
 class Cartridge {
  public:
   Cartridge(const std::string& path);
+  // an image already in memory, e.g. a synthetic ROM
+  explicit Cartridge(std::vector<u8> data);
 
-  const std::vector<u8>& data() const { return data_; }
+  // another cartridge with the same ROM, which they share, not mapped yet
+  std::unique_ptr<Cartridge> Share() const;
+
+  const std::vector<u8>& data() const { return *data_; }
+  // the file the ROM was loaded from, empty for an image made in memory
+  const std::string& path() const { return path_; }
 
   bool is_valid() const { return is_valid_;}
 
+  // makes the devices and the RAM in the bus's arena and maps them, once
   void InitBus(MemoryBus& bus);
+  // unmaps what InitBus mapped so another cartridge can go into the same bus
+  void RemoveFromBus();
+  // the banks and the RAM as InitBus left them, the ROM isn't touched
+  void Reset();
+  // the selected banks and the RAM, both ways, see state.h
+  template<typename Archive>
+  void Serialize(Archive& archive);
 
   CartridgeCompatibility compatibility() const { return compatibility_; }
+
+  // bank mapped at $4000-$7FFF
+  u8 rom_bank() const { return rom_bank_select_; }
+  u32 rom_bank_count() const { return rom_bank_num_; }
  private:
-  std::vector<u8> data_;
+  using ROMBanks = std::vector<std::array<u8, CARTRIDGE_ROM_SIZE>>;
+
+  Cartridge() = default;
+
+  // never written after loading, so the cartridges made by Share read it from any thread
+  std::shared_ptr<const std::vector<u8>> data_;
+  std::string path_;
   bool is_valid_;
 
   MemoryBus* bus_;
@@ -88,13 +113,13 @@ class Cartridge {
   CartridgeCompatibility compatibility_;
   CartridgeType type_;
 
-  u8 rom_bank_select_;
-  std::vector<std::array<u8, CARTRIDGE_ROM_SIZE>> rom_banks_;
-  std::unique_ptr<SwitchingArrayMemoryDevice<CARTRIDGE_ROM_SIZE>> rom_bank_00_md_;
-  std::unique_ptr<SwitchingArrayMemoryDevice<CARTRIDGE_ROM_SIZE>> rom_bank_01_md_;
+  u8 rom_bank_select_ = 1;
+  std::shared_ptr<ROMBanks> rom_banks_; // the devices map it read only
+  ArenaPtr<SwitchingArrayMemoryDevice<CARTRIDGE_ROM_SIZE>> rom_bank_00_md_;
+  ArenaPtr<SwitchingArrayMemoryDevice<CARTRIDGE_ROM_SIZE>> rom_bank_01_md_;
 
-  u8 ram_bank_select_;
-  std::vector<std::array<u8, CARTRIDGE_RAM_SIZE>> ram_banks_;
-  std::unique_ptr<SwitchingArrayMemoryDevice<CARTRIDGE_RAM_SIZE>> ram_bank_md_;
+  u8 ram_bank_select_ = 0;
+  std::span<std::array<u8, CARTRIDGE_RAM_SIZE>> ram_banks_; // in the bus's arena
+  ArenaPtr<CopyOnWriteArrayMemoryDevice<CARTRIDGE_RAM_SIZE>> ram_bank_md_;
 
 };
@@ -0,0 +1,142 @@
+#include "compress.h"
+#include <cstring>
+
+namespace Compress {
+
+static constexpr size_t kMinMatch = 4;
+// the format ends every block with literals, a match can't start in the last 12 bytes
+// or run into the last 5
+static constexpr size_t kLastLiterals = 5;
+static constexpr size_t kMatchLimit = 12;
+static constexpr size_t kMaxOffset = 0xFFFF;
+static constexpr u32 kHashBits = 12;
+
+static u32 Read32(const u8* p) {
+  u32 value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static u32 Hash(u32 sequence) {
+  return (sequence * 2654435761u) >> (32 - kHashBits);
+}
+
+// lengths of 15 and above continue in bytes of 255 until a smaller one
+static u8* WriteLength(u8* out, size_t length) {
+  for (; length >= 255; length -= 255) {
+    *out++ = 255;
+  }
+  *out++ = (u8) length;
+  return out;
+}
+
+static u8* WriteSequence(u8* out, const u8* literals, size_t literal_length, size_t offset, size_t match_length) {
+  u8& token = *out++;
+  token = (u8) (std::min<size_t>(literal_length, 15) << 4);
+  if (literal_length >= 15) {
+    out = WriteLength(out, literal_length - 15);
+  }
+  std::memcpy(out, literals, literal_length);
+  out += literal_length;
+  if (match_length == 0) {
+    return out; // the last sequence has no match
+  }
+  *out++ = (u8) offset;
+  *out++ = (u8) (offset >> 8);
+  match_length -= kMinMatch;
+  token |= (u8) std::min<size_t>(match_length, 15);
+  if (match_length >= 15) {
+    out = WriteLength(out, match_length - 15);
+  }
+  return out;
+}
+
+size_t CompressBlock(std::span<const u8> input, u8* output) {
+  const u8* in = input.data();
+  size_t size = input.size();
+  u8* out = output;
+  size_t anchor = 0; // start of the pending literals
+  if (size > kMatchLimit) {
+    // positions + 1 of the last sequence with each hash, 0 if there was none
+    u32 table[1 << kHashBits] = {};
+    size_t position = 0;
+    while (position + kMatchLimit < size) {
+      u32 sequence = Read32(in + position);
+      u32& entry = table[Hash(sequence)];
+      size_t candidate = entry;
+      entry = position + 1;
+      if (candidate == 0 || position - (candidate - 1) > kMaxOffset || Read32(in + candidate - 1) != sequence) {
+        position++;
+        continue;
+      }
+      size_t match = candidate - 1;
+      size_t length = kMinMatch;
+      while (position + length < size - kLastLiterals && in[match + length] == in[position + length]) {
+        length++;
+      }
+      out = WriteSequence(out, in + anchor, position - anchor, position - match, length);
+      position += length;
+      anchor = position;
+    }
+  }
+  out = WriteSequence(out, in + anchor, size - anchor, 0, 0);
+  return out - output;
+}
+
+// reads the extra bytes of a length that didn't fit into its nibble
+static bool ReadLength(const u8*& in, const u8* end, size_t& length) {
+  u8 byte;
+  do {
+    if (in == end) {
+      return false;
+    }
+    byte = *in++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+bool DecompressBlock(std::span<const u8> input, std::span<u8> output) {
+  const u8* in = input.data();
+  const u8* in_end = in + input.size();
+  u8* out = output.data();
+  u8* out_end = out + output.size();
+  while (in < in_end) {
+    u8 token = *in++;
+    size_t literal_length = token >> 4;
+    if (literal_length == 15 && !ReadLength(in, in_end, literal_length)) {
+      return false;
+    }
+    if (literal_length > (size_t) (in_end - in) || literal_length > (size_t) (out_end - out)) {
+      return false;
+    }
+    std::memcpy(out, in, literal_length);
+    in += literal_length;
+    out += literal_length;
+    if (in == in_end) {
+      break; // the last sequence
+    }
+    if (in_end - in < 2) {
+      return false;
+    }
+    size_t offset = in[0] | (in[1] << 8);
+    in += 2;
+    size_t match_length = token & 0xF;
+    if (match_length == 15 && !ReadLength(in, in_end, match_length)) {
+      return false;
+    }
+    match_length += kMinMatch;
+    if (offset == 0 || offset > (size_t) (out - output.data()) || match_length > (size_t) (out_end - out)) {
+      return false;
+    }
+    // matches may overlap their own output, copy byte by byte
+    const u8* match = out - offset;
+    for (size_t i = 0; i < match_length; i++) {
+      out[i] = match[i];
+    }
+    out += match_length;
+  }
+  return out == out_end;
+}
+
+}
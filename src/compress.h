@@ -0,0 +1,25 @@
+#pragma once
+
+#include "util.h"
+#include <span>
+
+// LZ4 block format, fast enough to keep up with the emulator on a background thread.
+//
+// A block is a list of sequences: a token with the literal and match lengths, the
+// literals, then a 16 bit offset back into the output and the rest of the match
+// length. Only whole blocks are handled, the caller stores the sizes.
+
+namespace Compress {
+
+// largest output CompressBlock can produce for size bytes
+constexpr size_t CompressBound(size_t size) { return size + size / 255 + 16; }
+
+// compresses input into output, which holds at least CompressBound(input.size())
+// bytes, returns the compressed size
+size_t CompressBlock(std::span<const u8> input, u8* output);
+
+// output must be exactly the size of the uncompressed block, false if the input is
+// corrupt or doesn't fill it
+bool DecompressBlock(std::span<const u8> input, std::span<u8> output);
+
+}
@@ -0,0 +1,369 @@
+#include "headless.h"
+#include "synthetic_rom.h"
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// laneboy-corpus [--frames n] [--modes interpreter,threaded,recompiled] [--input script]
+//                [--json output.json] [--verbose] [<rom or directory>...]
+//
+// Runs every ROM headless for a fixed number of frames in each execution mode and
+// reports emulated frames per second, instructions per second and peak RSS, the end
+// to end numbers next to laneboy-bench's microbenchmarks. Directories are searched for
+// .gb and .gbc files. Without any, it runs the default corpus, the ROMs of
+// DefaultCorpus, written to the corpus directory next to the .input scripts checked in
+// there, so the numbers compare across checkouts.
+//
+// Input comes from --input, or else from <rom>.input next to the ROM if there is one,
+// see InputScript. With the same script every run emulates exactly the same frames, the
+// output hash shows whether the modes agree.
+//
+// Every run is a child process of its own so the peak RSS is the run's and a crashing
+// ROM doesn't take the others with it.
+
+namespace {
+
+struct Options {
+  u64 frames = 3600; // a minute of game time
+  std::vector<ExecutionMode> modes{ExecutionMode::Interpreter};
+  std::string input_path;
+  std::string json_path;
+  bool verbose = false;
+  std::vector<std::string> paths;
+};
+
+// where the default corpus goes, the build points it at the source tree's
+#ifndef CORPUS_DIR
+#define CORPUS_DIR "corpus"
+#endif
+
+enum RunStatus : u32 {
+  kRunOk,
+  kRunInvalidCartridge,
+  kRunNoRecompiledCode,
+  kRunBadInput,
+  kRunCrashed,
+};
+
+const char* RunStatusToString(RunStatus status) {
+  switch (status) {
+    case kRunOk: return "ok";
+    case kRunInvalidCartridge: return "invalid cartridge";
+    case kRunNoRecompiledCode: return "no recompiled code, run laneboy-recompile";
+    case kRunBadInput: return "bad input script";
+    case kRunCrashed: return "crashed";
+  }
+  return "";
+}
+
+// what the child sends back through the pipe
+struct RunStats {
+  RunStatus status;
+  u64 frames;
+  u64 instructions;
+  double seconds;
+  double cpu_seconds;
+  u64 output_hash;
+};
+
+struct Run {
+  std::string rom;
+  ExecutionMode mode;
+  RunStats stats;
+  u64 peak_rss_kb;
+};
+
+double Seconds(const timeval& time) {
+  return time.tv_sec + time.tv_usec / 1e6;
+}
+
+RunStats RunRom(const std::string& rom, ExecutionMode mode, const Options& options) {
+  RunStats stats{};
+  std::string input_path = options.input_path;
+  if (input_path.empty()) {
+    std::filesystem::path own = std::filesystem::path(rom).replace_extension(".input");
+    if (std::filesystem::exists(own)) {
+      input_path = own.string();
+    }
+  }
+  std::optional<InputScript> script = InputScript::Parse("");
+  if (!input_path.empty()) {
+    std::string error;
+    script = InputScript::Load(input_path, &error);
+    if (!script) {
+      std::cerr << input_path << ": " << error << std::endl;
+      stats.status = kRunBadInput;
+      return stats;
+    }
+  }
+
+  auto cartridge = std::make_unique<Cartridge>(rom);
+  if (!cartridge->is_valid()) {
+    stats.status = kRunInvalidCartridge;
+    return stats;
+  }
+  Headless machine(std::move(cartridge), mode);
+  if (mode == ExecutionMode::Recompiled && !machine.recompiled_loaded()) {
+    stats.status = kRunNoRecompiledCode;
+    return stats;
+  }
+
+  auto begin = std::chrono::steady_clock::now();
+  for (u64 frame = 0; frame < options.frames && machine.cpu_->running_; frame++) {
+    machine.cpu_->SetButtons(script->ButtonsAt(frame));
+    machine.RunFrame();
+    stats.frames++;
+  }
+  stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  stats.cpu_seconds = Seconds(usage.ru_utime) + Seconds(usage.ru_stime);
+  stats.instructions = machine.instructions();
+  stats.output_hash = machine.HashOutput();
+  stats.status = kRunOk;
+  return stats;
+}
+
+Run RunInChild(const std::string& rom, ExecutionMode mode, const Options& options) {
+  Run run{rom, mode, {kRunCrashed}, 0};
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return run;
+  }
+  std::cout.flush();
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    if (!options.verbose) {
+      // the cartridge and the PPU log to stdout
+      int null = open("/dev/null", O_WRONLY);
+      dup2(null, STDOUT_FILENO);
+    }
+    RunStats stats = RunRom(rom, mode, options);
+    std::cout.flush();
+    bool sent = write(fds[1], &stats, sizeof(stats)) == sizeof(stats);
+    _exit(sent ? 0 : 1);
+  }
+  close(fds[1]);
+  if (pid > 0) {
+    RunStats stats;
+    if (read(fds[0], &stats, sizeof(stats)) == sizeof(stats)) {
+      run.stats = stats;
+    }
+    int status;
+    rusage usage{};
+    wait4(pid, &status, 0, &usage);
+    run.peak_rss_kb = usage.ru_maxrss; // kilobytes on Linux
+#ifdef __APPLE__
+    run.peak_rss_kb /= 1024; // bytes on macOS
+#endif
+  }
+  close(fds[0]);
+  return run;
+}
+
+double Fps(const Run& run) {
+  return run.stats.seconds > 0 ? run.stats.frames / run.stats.seconds : 0;
+}
+
+double InstructionsPerSecond(const Run& run) {
+  return run.stats.seconds > 0 ? run.stats.instructions / run.stats.seconds : 0;
+}
+
+std::vector<std::string> FindRoms(const std::vector<std::string>& paths) {
+  std::vector<std::string> roms;
+  for (const std::string& path : paths) {
+    if (!std::filesystem::is_directory(path)) {
+      roms.push_back(path);
+      continue;
+    }
+    std::vector<std::string> found;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(path)) {
+      std::string extension = entry.path().extension().string();
+      if (entry.is_regular_file() && (extension == ".gb" || extension == ".gbc")) {
+        found.push_back(entry.path().string());
+      }
+    }
+    // directory order isn't stable, the report should be
+    std::sort(found.begin(), found.end());
+    roms.insert(roms.end(), found.begin(), found.end());
+  }
+  return roms;
+}
+
+std::string JsonEscape(const std::string& text) {
+  std::string out;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out += '\\';
+    }
+    out += c;
+  }
+  return out;
+}
+
+bool WriteJson(const std::string& path, const Options& options, const std::vector<Run>& runs,
+               const std::vector<std::pair<ExecutionMode, double>>& geomeans) {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    return false;
+  }
+  std::string out = fmt::format("{{\n  \"frames\": {},\n  \"runs\": [\n", options.frames);
+  for (size_t i = 0; i < runs.size(); i++) {
+    const Run& run = runs[i];
+    out += fmt::format("    {{\"rom\": \"{}\", \"mode\": \"{}\", \"status\": \"{}\", \"frames\": {}, "
+                       "\"seconds\": {:.6f}, \"cpu_seconds\": {:.6f}, \"fps\": {:.3f}, \"instructions\": {}, "
+                       "\"instructions_per_second\": {:.0f}, \"peak_rss_kb\": {}, \"output_hash\": \"{:016x}\"}}{}\n",
+                       JsonEscape(run.rom), ExecutionModeToString(run.mode), RunStatusToString(run.stats.status),
+                       run.stats.frames, run.stats.seconds, run.stats.cpu_seconds, Fps(run), run.stats.instructions,
+                       InstructionsPerSecond(run), run.peak_rss_kb, run.stats.output_hash,
+                       i + 1 < runs.size() ? "," : "");
+  }
+  out += "  ],\n  \"geomean_fps\": {";
+  for (size_t i = 0; i < geomeans.size(); i++) {
+    out += fmt::format("{}\"{}\": {:.3f}", i ? ", " : "", ExecutionModeToString(geomeans[i].first),
+                       geomeans[i].second);
+  }
+  out += "}\n}\n";
+  file << out;
+  return true;
+}
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (arg == "--frames" && has_value) {
+      options.frames = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--modes" && has_value) {
+      options.modes.clear();
+      std::istringstream names(argv[++i]);
+      std::string name;
+      while (std::getline(names, name, ',')) {
+        std::optional<ExecutionMode> mode = ExecutionModeFromString(name);
+        if (!mode) {
+          std::cerr << "unknown mode " << name << std::endl;
+          return false;
+        }
+        if (!IsExecutionModeAvailable(*mode)) {
+          std::cerr << name << " isn't available in this build" << std::endl;
+          return false;
+        }
+        options.modes.push_back(*mode);
+      }
+    } else if (arg == "--input" && has_value) {
+      options.input_path = argv[++i];
+    } else if (arg == "--json" && has_value) {
+      options.json_path = argv[++i];
+    } else if (arg == "--verbose") {
+      options.verbose = true;
+    } else if (arg.starts_with("--")) {
+      return false;
+    } else {
+      options.paths.push_back(arg);
+    }
+  }
+  return !options.modes.empty() && options.frames > 0;
+}
+
+// the ROMs of the default corpus, rewritten every time so they match this build
+bool WriteDefaultCorpus() {
+  std::error_code error;
+  std::filesystem::create_directories(CORPUS_DIR, error);
+  for (const CorpusRom& rom : DefaultCorpus()) {
+    std::string path = fmt::format("{}/{}.gb", CORPUS_DIR, rom.name);
+    std::vector<u8> bytes = rom.build();
+    std::ofstream file(path, std::ios::binary);
+    if (!file.write((const char*) bytes.data(), bytes.size())) {
+      std::cerr << "unable to write " << path << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  if (!ParseOptions(argc, argv, options)) {
+    std::cerr << "usage: " << argv[0] << " [--frames n] [--modes interpreter,threaded,recompiled] "
+              << "[--input script] [--json output.json] [--verbose] [<rom or directory>...]" << std::endl;
+    return 1;
+  }
+  if (options.paths.empty()) {
+    if (!WriteDefaultCorpus()) {
+      return 1;
+    }
+    options.paths.push_back(CORPUS_DIR);
+  }
+#ifdef STEP_EVERY_INSTRUCTION
+  std::cerr << "built with a debugging feature, the numbers don't reflect a release build" << std::endl;
+#endif
+  std::vector<std::string> roms = FindRoms(options.paths);
+  if (roms.empty()) {
+    std::cerr << "no ROMs found" << std::endl;
+    return 1;
+  }
+
+  std::cout << fmt::format("{:<32} {:<12} {:>8} {:>10} {:>8} {:>10} {:>8}  {}", "rom", "mode", "frames", "fps",
+                           "MIPS", "peak RSS", "speedup", "output")
+            << std::endl;
+  std::vector<Run> runs;
+  for (const std::string& rom : roms) {
+    std::string name = std::filesystem::path(rom).stem().string();
+    // the first mode that ran is what the others are compared to
+    std::optional<size_t> baseline;
+    for (ExecutionMode mode : options.modes) {
+      runs.push_back(RunInChild(rom, mode, options));
+      const Run& run = runs.back();
+      if (run.stats.status != kRunOk) {
+        std::cout << fmt::format("{:<32} {:<12} {}", name, ExecutionModeToString(mode),
+                                 RunStatusToString(run.stats.status))
+                  << std::endl;
+        continue;
+      }
+      if (!baseline) {
+        baseline = runs.size() - 1;
+      }
+      const Run& base = runs[*baseline];
+      // every mode has to draw the same picture, a different hash is an emulation bug
+      bool agrees = base.stats.output_hash == run.stats.output_hash;
+      std::cout << fmt::format("{:<32} {:<12} {:>8} {:>10.1f} {:>8.2f} {:>7} MB {:>7.2f}x  {:016x}{}", name,
+                               ExecutionModeToString(mode), run.stats.frames, Fps(run),
+                               InstructionsPerSecond(run) / 1e6, run.peak_rss_kb / 1024,
+                               Fps(base) > 0 ? Fps(run) / Fps(base) : 0, run.stats.output_hash,
+                               agrees ? "" : " differs")
+                << std::endl;
+    }
+  }
+
+  // the geometric mean keeps one fast ROM from dominating
+  std::vector<std::pair<ExecutionMode, double>> geomeans;
+  for (ExecutionMode mode : options.modes) {
+    double log_sum = 0;
+    u32 count = 0;
+    for (const Run& run : runs) {
+      if (run.mode == mode && run.stats.status == kRunOk && Fps(run) > 0) {
+        log_sum += std::log(Fps(run));
+        count++;
+      }
+    }
+    if (count > 0) {
+      geomeans.push_back({mode, std::exp(log_sum / count)});
+      std::cout << fmt::format("{:<12} geomean {:.1f} fps over {} ROMs", ExecutionModeToString(mode),
+                               geomeans.back().second, count)
+                << std::endl;
+    }
+  }
+
+  if (!options.json_path.empty() && !WriteJson(options.json_path, options, runs, geomeans)) {
+    std::cerr << "unable to write " << options.json_path << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,144 @@
+#include "coverage.h"
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef ENABLE_COVERAGE
+
+namespace Coverage {
+
+static constexpr char kMagic[8] = {'L', 'B', 'C', 'O', 'V', 'E', 'R', 0};
+
+static CoverageBank scratch_;
+CoverageBank* mapped_[2] = {&scratch_, &scratch_};
+
+static bool running_ = false;
+static std::string rom_path_;
+static std::vector<CoverageBank> banks_;
+
+// covered bytes, executed or read, at the end of each frame
+static u64 covered_ = 0;
+static std::vector<u32> frame_deltas_;
+static std::atomic<u32> last_frame_delta_ = 0;
+
+static u64 Count(const CoverageBank& bank) {
+  u64 count = 0;
+  for (size_t i = 0; i < bank.executed.size(); i += 8) {
+    u64 executed;
+    u64 read;
+    std::memcpy(&executed, &bank.executed[i], sizeof(executed));
+    std::memcpy(&read, &bank.read[i], sizeof(read));
+    count += std::popcount(executed | read);
+  }
+  return count;
+}
+
+void Start(const std::string& rom_path, u32 bank_count) {
+  Stop();
+  running_ = true;
+  rom_path_ = rom_path;
+  banks_.assign(std::max<u32>(bank_count, 2), CoverageBank{});
+  mapped_[0] = &banks_[0];
+  mapped_[1] = &banks_[1];
+  covered_ = 0;
+  frame_deltas_.clear();
+  last_frame_delta_ = 0;
+}
+
+bool running() {
+  return running_;
+}
+
+void OnBankChange(u32 bank) {
+  if (running_ && bank < banks_.size()) {
+    mapped_[1] = &banks_[bank];
+  }
+}
+
+void OnFrame() {
+  if (!running_) {
+    return;
+  }
+  u64 covered = 0;
+  for (const CoverageBank& bank : banks_) {
+    covered += Count(bank);
+  }
+  u32 delta = covered - covered_;
+  covered_ = covered;
+  frame_deltas_.push_back(delta);
+  last_frame_delta_.store(delta, std::memory_order_relaxed);
+}
+
+const std::vector<CoverageBank>& banks() {
+  return banks_;
+}
+
+u32 last_frame_delta() {
+  return last_frame_delta_.load(std::memory_order_relaxed);
+}
+
+bool Save(const std::string& path, const std::vector<CoverageBank>& banks) {
+  std::ofstream output(path, std::ios::binary | std::ios::trunc);
+  if (!output.is_open()) {
+    return false;
+  }
+  u32 count = banks.size();
+  output.write(kMagic, sizeof(kMagic));
+  output.write((const char*) &count, sizeof(count));
+  output.write((const char*) banks.data(), banks.size() * sizeof(CoverageBank));
+  return (bool) output;
+}
+
+bool Load(const std::string& path, std::vector<CoverageBank>& banks) {
+  std::ifstream input(path, std::ios::binary);
+  char magic[sizeof(kMagic)];
+  u32 count;
+  if (!input.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+      !input.read((char*) &count, sizeof(count))) {
+    return false;
+  }
+  banks.resize(count);
+  return (bool) input.read((char*) banks.data(), banks.size() * sizeof(CoverageBank));
+}
+
+static void WriteSummary(const std::string& path) {
+  std::ofstream output(path);
+  output << fmt::format("{}: {} banks\n\n", rom_path_, banks_.size());
+  output << fmt::format("{:>4} {:>9} {:>7} {:>9} {:>7}\n", "bank", "executed", "%", "read", "%");
+  for (size_t i = 0; i < banks_.size(); i++) {
+    u64 executed = 0;
+    u64 read = 0;
+    for (size_t j = 0; j < banks_[i].executed.size(); j++) {
+      executed += std::popcount(banks_[i].executed[j]);
+      read += std::popcount(banks_[i].read[j]);
+    }
+    output << fmt::format("{:>4X} {:>9} {:>7.2f} {:>9} {:>7.2f}\n", i, executed, 100.0 * executed / CARTRIDGE_ROM_SIZE,
+                          read, 100.0 * read / CARTRIDGE_ROM_SIZE);
+  }
+  output << "\nnew bytes per frame, frames without any are left out\n";
+  for (size_t frame = 0; frame < frame_deltas_.size(); frame++) {
+    if (frame_deltas_[frame] != 0) {
+      output << fmt::format("{:>8} +{}\n", frame, frame_deltas_[frame]);
+    }
+  }
+}
+
+void Stop() {
+  if (!running_) {
+    return;
+  }
+  running_ = false;
+  mapped_[0] = &scratch_;
+  mapped_[1] = &scratch_;
+
+  std::filesystem::create_directories("coverage");
+  std::string base = "coverage/" + std::filesystem::path(rom_path_).stem().string();
+  Save(base + ".cov", banks_);
+  WriteSummary(base + ".txt");
+  std::cout << "wrote the coverage to " << base << ".cov and " << base << ".txt" << std::endl;
+}
+
+}
+
+#endif
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "util.h"
+#include <array>
+#include <atomic>
+
+// ROM coverage, built with -DCOVERAGE=1.
+//
+// Each ROM bank has two bitmaps with a bit per byte: the opcodes CPU::Step ran and
+// the bytes MemoryBus::Read returned, operands and fetched opcodes included. The
+// bitmaps of the banks mapped at $0000 and $4000 are kept at hand so marking an
+// address is a compare and a bit set.
+//
+// Every frame the newly covered bytes are counted, Stop writes coverage/<rom>.cov
+// with the bitmaps and coverage/<rom>.txt with the totals and those deltas.
+
+#ifdef COVERAGE
+#define ENABLE_COVERAGE
+#endif
+
+struct CoverageBank {
+  std::array<u8, CARTRIDGE_ROM_SIZE / 8> executed{};
+  std::array<u8, CARTRIDGE_ROM_SIZE / 8> read{};
+};
+
+namespace Coverage {
+
+// banks mapped at $0000 and $4000, a scratch bank when nothing is recorded
+extern CoverageBank* mapped_[2];
+
+void Start(const std::string& rom_path, u32 bank_count);
+// writes the bitmaps and the summary of the current run, if any
+void Stop();
+bool running();
+
+// bank is the one now mapped at $4000
+void OnBankChange(u32 bank);
+void OnFrame();
+
+inline void OnExecute(u16 pc) {
+  if (pc <= CARTRIDGE_ROM_01_END_ADDRESS) {
+    mapped_[pc >> 14]->executed[(pc & 0x3FFF) >> 3] |= 1 << (pc & 7);
+  }
+}
+
+inline void OnRead(u16 address) {
+  if (address <= CARTRIDGE_ROM_01_END_ADDRESS) {
+    mapped_[address >> 14]->read[(address & 0x3FFF) >> 3] |= 1 << (address & 7);
+  }
+}
+
+// the bitmaps are written by the emulator thread without locking, readers on other
+// threads may see a frame old state
+const std::vector<CoverageBank>& banks();
+// bytes covered in the last frame that weren't before
+u32 last_frame_delta();
+
+bool Save(const std::string& path, const std::vector<CoverageBank>& banks);
+// false if the file doesn't exist or isn't a coverage dump
+bool Load(const std::string& path, std::vector<CoverageBank>& banks);
+
+}
+
+#ifdef ENABLE_COVERAGE
+#define START_COVERAGE(rom_path, bank_count) Coverage::Start(rom_path, bank_count)
+#define STOP_COVERAGE() Coverage::Stop()
+#define COVERAGE_BANK_CHANGE(bank) Coverage::OnBankChange(bank)
+#define COVERAGE_FRAME() Coverage::OnFrame()
+#define COVERAGE_EXECUTE(pc) Coverage::OnExecute(pc)
+#define COVERAGE_READ(address) Coverage::OnRead(address)
+#else
+#define START_COVERAGE(rom_path, bank_count)
+#define STOP_COVERAGE()
+#define COVERAGE_BANK_CHANGE(bank)
+#define COVERAGE_FRAME()
+#define COVERAGE_EXECUTE(pc)
+#define COVERAGE_READ(address)
+#endif
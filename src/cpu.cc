@@ -2,6 +2,9 @@
 #include "cpu_events.h"
 #include "debug.h"
 #include "instructions.h"
+#include "opcodes.h"
+#include "state.h"
+#include <bit>
 
 // todo change this to generic memory devices, no need for a custom type
 class BootROMDevice : public MemoryDevice {
@@ -28,31 +31,34 @@ class BootROMDevice : public MemoryDevice {
 CPU::CPU(EventBus& event_bus, MemoryBus& bus) : event_bus_(event_bus), bus_(bus) {
   event_bus_.Subscribe(BIND_FN(OnEvent));
 
-  SetClockSpeed(BASE_CPU_CLOCK_SPEED);
-
-  ie_md_ = std::make_unique<FixedPointerMemoryDevice<1, u8>>(&ie_, kMemoryAccessBoth);
+  ie_md_ = bus_.arena().New<FixedPointerWithHandlerMemoryDevice<1, u8>>(&ie_, [this](u16 address, u8 previous, u8 value, bool failed) -> u8 {
+    ie_ = value;
+    UpdateInterruptState();
+    return value;
+  }, kMemoryAccessBoth);
   bus_.AddDevice(INTERRUPT_ENABLE_ADDRESS, ie_md_.get(), true);
-  if_md_ = std::make_unique<FixedPointerMemoryDevice<1, u8>>(&if_, kMemoryAccessBoth);
+  if_md_ = bus_.arena().New<FixedPointerWithHandlerMemoryDevice<1, u8>>(&if_, [this](u16 address, u8 previous, u8 value, bool failed) -> u8 {
+    if_ = value;
+    UpdateInterruptState();
+    return value;
+  }, kMemoryAccessBoth);
   bus_.AddDevice(INTERRUPT_FLAG_ADDRESS, if_md_.get(), true);
-  div_md_ = std::make_unique<FixedPointerWithHandlerMemoryDevice<1, u8>>(&div_, [this](u16 address, u8 previous, u8 value, bool failed) -> u8 {
+  div_md_ = bus_.arena().New<FixedPointerWithHandlerMemoryDevice<1, u8>>(&div_, [this](u16 address, u8 previous, u8 value, bool failed) -> u8 {
     return 0x00;
   }, kMemoryAccessBoth);
   bus_.AddDevice(DIV_ADDRESS, div_md_.get(), true);
-  tima_ = 0;
-  tima_md_ = std::make_unique<FixedPointerMemoryDevice<1, u8>>(&tima_, kMemoryAccessBoth);
+  tima_md_ = bus_.arena().New<FixedPointerMemoryDevice<1, u8>>(&tima_, kMemoryAccessBoth);
   bus_.AddDevice(TIMA_ADDRESS, tima_md_.get(), true);
-  tma_ = 0;
-  tma_md_ = std::make_unique<FixedPointerMemoryDevice<1, u8>>(&tma_, kMemoryAccessBoth);
+  tma_md_ = bus_.arena().New<FixedPointerMemoryDevice<1, u8>>(&tma_, kMemoryAccessBoth);
   bus_.AddDevice(TMA_ADDRESS, tma_md_.get(), true);
-  tac_ = 0;
-  tac_md_ = std::make_unique<FixedPointerWithHandlerMemoryDevice<1, u8>>(&tac_, [this](u16 address, u8 previous, u8 value, bool failed){
+  tac_md_ = bus_.arena().New<FixedPointerWithHandlerMemoryDevice<1, u8>>(&tac_, [this](u16 address, u8 previous, u8 value, bool failed){
     if ((previous & 0b11) != (value & 0b11)) {
       SetClockFrequency();
     }
     return value;
   }, kMemoryAccessBoth);
   bus_.AddDevice(TAC_ADDRESS, tac_md_.get(), true);
-  boot_unmap_md_ = std::make_unique<FixedPointerWithHandlerMemoryDevice<1, u8>>(&boot_unloaded_, [this](u16 address, u8 previous, u8 value, bool failed){
+  boot_unmap_md_ = bus_.arena().New<FixedPointerWithHandlerMemoryDevice<1, u8>>(&boot_unloaded_, [this](u16 address, u8 previous, u8 value, bool failed){
     if (value != 0) {
       UnloadBootRom();
       return 0xFF;
@@ -62,67 +68,42 @@ CPU::CPU(EventBus& event_bus, MemoryBus& bus) : event_bus_(event_bus), bus_(bus)
   bus_.AddDevice(BOOT_UNMAP_ADDRESS, boot_unmap_md_.get(), true);
 
   // WRAM 0 is fixed
-  wram_0_.fill(0);
-  wram_0_md_ = std::make_unique<FixedArrayMemoryDevice<WRAM_SIZE>>(WRAM_0_START_ADDRESS, &wram_0_, kMemoryAccessBoth);
+  wram_0_md_ = bus_.arena().New<CopyOnWriteArrayMemoryDevice<WRAM_SIZE>>(WRAM_0_START_ADDRESS, std::array{&wram_0_}, kMemoryAccessBoth);
   bus_.AddDevice(WRAM_0_START_ADDRESS, WRAM_0_END_ADDRESS, wram_0_md_.get());
 
   // WRAM 1 is selectable
-  wram_1_.fill(0);
-  wram_select_ = 0x01;
-  wram_1_7_md_ = std::make_unique<SwitchingArrayMemoryDevice<WRAM_SIZE>>(WRAM_1_7_START_ADDRESS, &wram_1_, kMemoryAccessBoth);
+  wram_1_7_md_ = bus_.arena().New<CopyOnWriteArrayMemoryDevice<WRAM_SIZE>>(
+      WRAM_1_7_START_ADDRESS, std::array{&wram_1_, &wram_2_, &wram_3_, &wram_4_, &wram_5_, &wram_6_, &wram_7_}, kMemoryAccessBoth);
   bus_.AddDevice(WRAM_1_7_START_ADDRESS, WRAM_1_7_END_ADDRESS, wram_1_7_md_.get());
-  wram_select_md_ = std::make_unique<FixedPointerWithHandlerMemoryDevice<1, u8>>(&wram_select_, [this](u16 address, u8 previous, u8 value, bool failed){
+  wram_select_md_ = bus_.arena().New<FixedPointerWithHandlerMemoryDevice<1, u8>>(&wram_select_, [this](u16 address, u8 previous, u8 value, bool failed){
     if (previous == value || cpu_mode_ == kCPUModeDMG) {
       return previous;
     }
-    std::cout << "wram select: " << ToHex(previous) << " -> " << ToHex(value) << std::endl;
-    switch (value & 0x07) {
-      case 0:
-        value = 1;
-      case 1:
-        wram_1_7_md_->Switch(&wram_1_);
-        break;
-      case 2:
-        wram_1_7_md_->Switch(&wram_2_);
-        break;
-      case 3:
-        wram_1_7_md_->Switch(&wram_3_);
-        break;
-      case 4:
-        wram_1_7_md_->Switch(&wram_4_);
-        break;
-      case 5:
-        wram_1_7_md_->Switch(&wram_5_);
-        break;
-      case 6:
-        wram_1_7_md_->Switch(&wram_6_);
-        break;
-      case 7:
-        wram_1_7_md_->Switch(&wram_7_);
-        break;
-      default:
-        value = previous;
-        break;
+    //std::cout << "wram select: " << ToHex(previous) << " -> " << ToHex(value) << std::endl;
+    u8 bank = value & 0x07;
+    if (bank == 0) {
+      value = 1;
+      bank = 1;
     }
+    wram_1_7_md_->Switch(bank - 1);
     EMIT_BANK_CHANGE(bus_);
     return value;
   }, kMemoryAccessBoth);
   bus_.AddDevice(WRAM_BANK_SELECT_ADDRESS, wram_select_md_.get());
 
-  oam_md_ = std::make_unique<FixedPointerMemoryDevice<OAM_SIZE, u8>>(OAM_START_ADDRESS, oam_.data(), kMemoryAccessBoth);
+  oam_md_ = bus_.arena().New<FixedPointerMemoryDevice<OAM_SIZE, u8>>(OAM_START_ADDRESS, oam_.data(), kMemoryAccessBoth);
   bus_.AddDevice(OAM_START_ADDRESS, OAM_END_ADDRESS, oam_md_.get());
 
-  hram_md_ = std::make_unique<FixedArrayMemoryDevice<HRAM_SIZE>>(HRAM_START_ADDRESS, &hram_, kMemoryAccessBoth);
+  hram_md_ = bus_.arena().New<FixedArrayMemoryDevice<HRAM_SIZE>>(HRAM_START_ADDRESS, &hram_, kMemoryAccessBoth);
   bus_.AddDevice(HRAM_START_ADDRESS, HRAM_END_ADDRESS, hram_md_.get());
 
-  audio_md_ = std::make_unique<FixedArrayMemoryDevice<AUDIO_SIZE>>(AUDIO_START_ADDRESS, &audio_, kMemoryAccessBoth);
+  audio_md_ = bus_.arena().New<FixedArrayMemoryDevice<AUDIO_SIZE>>(AUDIO_START_ADDRESS, &audio_, kMemoryAccessBoth);
   bus_.AddDevice(AUDIO_START_ADDRESS, AUDIO_END_ADDRESS, audio_md_.get());
 
-  wave_pattern_md_ = std::make_unique<FixedArrayMemoryDevice<WAVE_PATTERN_SIZE>>(WAVE_PATTERN_START_ADDRESS, &wave_pattern_, kMemoryAccessBoth);
+  wave_pattern_md_ = bus_.arena().New<FixedArrayMemoryDevice<WAVE_PATTERN_SIZE>>(WAVE_PATTERN_START_ADDRESS, &wave_pattern_, kMemoryAccessBoth);
   bus_.AddDevice(WAVE_PATTERN_START_ADDRESS, WAVE_PATTERN_END_ADDRESS, wave_pattern_md_.get());
 
-  dma_ = 0x00;
-  dma_md_ = std::make_unique<FixedPointerWithHandlerMemoryDevice<1, u8>>(&dma_, [this](u16 address, u8 previous, u8 value, bool failed) {
+  dma_md_ = bus_.arena().New<FixedPointerWithHandlerMemoryDevice<1, u8>>(&dma_, [this](u16 address, u8 previous, u8 value, bool failed) {
     if (value != 0 && dma_ == 0) {
       StartDMA(value);
       return value;
@@ -131,8 +112,7 @@ CPU::CPU(EventBus& event_bus, MemoryBus& bus) : event_bus_(event_bus), bus_(bus)
   }, kMemoryAccessBoth);
   bus.AddDevice(DMA_ADDRESS, dma_md_.get());
 
-  cpu_mode_lock_ = 0;
-  cpu_mode_lock_md_ = std::make_unique<FixedPointerWithHandlerMemoryDevice<1, CPUMode>>(&cpu_mode_, [this](u16 address, CPUMode previous, CPUMode value, bool failed) {
+  cpu_mode_lock_md_ = bus_.arena().New<FixedPointerWithHandlerMemoryDevice<1, CPUMode>>(&cpu_mode_, [this](u16 address, CPUMode previous, CPUMode value, bool failed) {
     if (value != 0 && previous == 0) {
       cpu_mode_lock_md_->DisableAccess(kMemoryAccessBoth);
       cpu_mode_md_->DisableAccess(kMemoryAccessWrite);
@@ -141,8 +121,7 @@ CPU::CPU(EventBus& event_bus, MemoryBus& bus) : event_bus_(event_bus), bus_(bus)
     }
     return previous;
   }, kMemoryAccessBoth);
-  cpu_mode_ = kCPUModeDMG;
-  cpu_mode_md_ = std::make_unique<FixedPointerWithHandlerMemoryDevice<1, CPUMode>>(&cpu_mode_, [this](u16 address, CPUMode previous, CPUMode value, bool failed) {
+  cpu_mode_md_ = bus_.arena().New<FixedPointerWithHandlerMemoryDevice<1, CPUMode>>(&cpu_mode_, [this](u16 address, CPUMode previous, CPUMode value, bool failed) {
     if (value == previous || cpu_mode_lock_ != 0) {
       return previous;
     }
@@ -154,21 +133,19 @@ CPU::CPU(EventBus& event_bus, MemoryBus& bus) : event_bus_(event_bus), bus_(bus)
     return value;
   }, kMemoryAccessBoth);
 
-  vram_0_.fill(00);
-  vram_md_ = std::make_unique<SwitchingArrayMemoryDevice<VRAM_SIZE>>(VRAM_START_ADDRESS, &vram_0_, kMemoryAccessBoth);
+  vram_md_ = bus_.arena().New<CopyOnWriteArrayMemoryDevice<VRAM_SIZE>>(VRAM_START_ADDRESS, std::array{&vram_0_, &vram_1_}, kMemoryAccessBoth);
   bus_.AddDevice(VRAM_START_ADDRESS, VRAM_END_ADDRESS, vram_md_.get());
 
-  vram_select_ = 0;
-  vram_select_md_ = std::make_unique<FixedPointerWithHandlerMemoryDevice<1, u8>>(&vram_select_, [this](u16 address, u8 previous, u8 value, bool failed){
+  vram_select_md_ = bus_.arena().New<FixedPointerWithHandlerMemoryDevice<1, u8>>(&vram_select_, [this](u16 address, u8 previous, u8 value, bool failed){
     if (previous == value) {
       return value;
     }
     value = value & 0x02;
-    std::cout << "vram select: " << ToHex(previous) << " -> " << ToHex(value) << std::endl;
+    //std::cout << "vram select: " << ToHex(previous) << " -> " << ToHex(value) << std::endl;
     if (value == 0) {
-      vram_md_->Switch(&vram_0_);
+      vram_md_->Switch(0);
     } else if (value == 1) {
-      vram_md_->Switch(&vram_1_);
+      vram_md_->Switch(1);
     } else {
       value = previous;
     }
@@ -177,14 +154,17 @@ CPU::CPU(EventBus& event_bus, MemoryBus& bus) : event_bus_(event_bus), bus_(bus)
   }, kMemoryAccessBoth);
   bus_.AddDevice(VRAM_BANK_SELECT_ADDRESS, vram_select_md_.get());
 
-  lcdc_md_ = std::make_unique<FixedPointerWithHandlerMemoryDevice<1, LCDC>>(&lcdc_, [this](u16 address, LCDC previous, LCDC value, bool failed) {
-    LCDControlChangeEvent event{value, previous};
-    event_bus_.Emit(event);
+  lcdc_md_ = bus_.arena().New<FixedPointerWithHandlerMemoryDevice<1, LCDC>>(&lcdc_, [this](u16 address, LCDC previous, LCDC value, bool failed) {
+    // games rewrite LCDC all the time, only a change is worth an event
+    if (value.value != previous.value) {
+      LCDControlChangeEvent event{value, previous};
+      event_bus_.Emit(event);
+    }
     return value;
   }, kMemoryAccessBoth);
   bus_.AddDevice(LCD_CONTROL_ADDRESS, lcdc_md_.get());
 
-  lcds_md_ = std::make_unique<FixedPointerWithHandlerMemoryDevice<1, LCDS>>(&lcds_, [this](u16 address, LCDS previous, LCDS value, bool failed) {
+  lcds_md_ = bus_.arena().New<FixedPointerWithHandlerMemoryDevice<1, LCDS>>(&lcds_, [this](u16 address, LCDS previous, LCDS value, bool failed) {
     // first two values are read only
     value.bits.ppu_mode = previous.bits.ppu_mode;
     value.bits.lyc_ly_compare = previous.bits.lyc_ly_compare;
@@ -194,93 +174,225 @@ CPU::CPU(EventBus& event_bus, MemoryBus& bus) : event_bus_(event_bus), bus_(bus)
   }, kMemoryAccessBoth);
   bus_.AddDevice(LCD_STAT_ADDRESS, lcds_md_.get());
 
-  bgp_md_ = std::make_unique<FixedPointerMemoryDevice<1, u8>>(&bgp_, kMemoryAccessBoth);
+  bgp_md_ = bus_.arena().New<FixedPointerMemoryDevice<1, u8>>(&bgp_, kMemoryAccessBoth);
   bus_.AddDevice(LCD_BGP_ADDRESS, bgp_md_.get());
 
-  bcps_ = 0;
-  bgpi_ = 0;
-  bcps_bgpi_md_ = std::make_unique<SwitchingPointerMemoryDevice<1, u8>>(&bcps_, kMemoryAccessBoth);
+  bcps_bgpi_md_ = bus_.arena().New<SwitchingPointerMemoryDevice<1, u8>>(&bcps_, kMemoryAccessBoth);
   bus_.AddDevice(LCD_BCPS_BGPI_ADDRESS, bcps_bgpi_md_.get());
 
-  ocps_ = 0;
-  obpi_ = 0;
-  ocps_obpi_md_ = std::make_unique<SwitchingPointerMemoryDevice<1, u8>>(&ocps_, kMemoryAccessBoth);
+  ocps_obpi_md_ = bus_.arena().New<SwitchingPointerMemoryDevice<1, u8>>(&ocps_, kMemoryAccessBoth);
   bus_.AddDevice(LCD_OCPS_OBPI_ADDRESS, ocps_obpi_md_.get());
 
-  ocpd_ = 0;
-  obpd_ = 0;
-  ocpd_obpd_md_ = std::make_unique<SwitchingPointerMemoryDevice<1, u8>>(&ocpd_, kMemoryAccessBoth);
+  ocpd_obpd_md_ = bus_.arena().New<SwitchingPointerMemoryDevice<1, u8>>(&ocpd_, kMemoryAccessBoth);
   bus_.AddDevice(LCD_OCPD_OBPD_ADDRESS, ocpd_obpd_md_.get());
 
-  joyp_ = 0;
-  joyp_md_ = std::make_unique<FixedPointerMemoryDevice<1, u8>>(&joyp_, kMemoryAccessBoth);
+  joyp_md_ = bus_.arena().New<FixedPointerWithHandlerMemoryDevice<1, u8>>(&joyp_, [this](u16 address, u8 previous, u8 value, bool failed) -> u8 {
+    // only the select bits are writable, the lines follow them
+    joyp_ = value & 0x30;
+    UpdateJoypad();
+    return joyp_;
+  }, kMemoryAccessBoth);
   bus_.AddDevice(JOYP_ADDRESS, joyp_md_.get());
 
-  scx_ = 0;
-  scx_md_ = std::make_unique<FixedPointerMemoryDevice<1, u8>>(&scx_, kMemoryAccessBoth);
+  scx_md_ = bus_.arena().New<FixedPointerMemoryDevice<1, u8>>(&scx_, kMemoryAccessBoth);
   bus_.AddDevice(LCD_SCX_ADDRESS, scx_md_.get());
 
-  scy_ = 0;
-  scy_md_ = std::make_unique<FixedPointerMemoryDevice<1, u8>>(&scy_, kMemoryAccessBoth);
+  scy_md_ = bus_.arena().New<FixedPointerMemoryDevice<1, u8>>(&scy_, kMemoryAccessBoth);
   bus_.AddDevice(LCD_SCY_ADDRESS, scy_md_.get());
 
-  wx_ = 0;
-  wx_md_ = std::make_unique<FixedPointerMemoryDevice<1, u8>>(&wx_, kMemoryAccessBoth);
+  wx_md_ = bus_.arena().New<FixedPointerMemoryDevice<1, u8>>(&wx_, kMemoryAccessBoth);
   bus_.AddDevice(LCD_WX_ADDRESS, wx_md_.get());
 
-  wy_ = 0;
-  wy_md_ = std::make_unique<FixedPointerMemoryDevice<1, u8>>(&wy_, kMemoryAccessBoth);
+  wy_md_ = bus_.arena().New<FixedPointerMemoryDevice<1, u8>>(&wy_, kMemoryAccessBoth);
   bus_.AddDevice(LCD_WY_ADDRESS, wy_md_.get());
 
-  ly_ = 0;
-  ly_md_ = std::make_unique<FixedPointerMemoryDevice<1, u8>>(&ly_, kMemoryAccessRead);
+  ly_md_ = bus_.arena().New<FixedPointerMemoryDevice<1, u8>>(&ly_, kMemoryAccessRead);
   bus_.AddDevice(LCD_LY_ADDRESS, ly_md_.get());
 
-  lyc_ = 0;
-  lyc_md_ = std::make_unique<FixedPointerMemoryDevice<1, u8>>(&lyc_, kMemoryAccessBoth);
+  lyc_md_ = bus_.arena().New<FixedPointerMemoryDevice<1, u8>>(&lyc_, kMemoryAccessBoth);
   bus_.AddDevice(LCD_LYC_ADDRESS, lyc_md_.get());
 
-  obp0_ = 0;
-  obp0_md_ = std::make_unique<FixedPointerMemoryDevice<1, u8>>(&obp0_, kMemoryAccessBoth);
+  obp0_md_ = bus_.arena().New<FixedPointerMemoryDevice<1, u8>>(&obp0_, kMemoryAccessBoth);
   bus_.AddDevice(LCD_OBP0_ADDRESS, obp0_md_.get());
 
-  obp1_ = 0;
-  obp1_md_ = std::make_unique<FixedPointerMemoryDevice<1, u8>>(&obp1_, kMemoryAccessBoth);
+  obp1_md_ = bus_.arena().New<FixedPointerMemoryDevice<1, u8>>(&obp1_, kMemoryAccessBoth);
   bus_.AddDevice(LCD_OBP1_ADDRESS, obp1_md_.get());
 
-  sb_ = 0;
-  sb_md_ = std::make_unique<FixedPointerMemoryDevice<1, u8>>(&sb_, kMemoryAccessBoth);
+  sb_md_ = bus_.arena().New<FixedPointerMemoryDevice<1, u8>>(&sb_, kMemoryAccessBoth);
   bus_.AddDevice(SB_ADDRESS, sb_md_.get());
 
-  sc_ = 0;
-  sc_md_ = std::make_unique<FixedPointerMemoryDevice<1, u8>>(&sc_, kMemoryAccessBoth);
+  sc_md_ = bus_.arena().New<FixedPointerMemoryDevice<1, u8>>(&sc_, kMemoryAccessBoth);
   bus_.AddDevice(SC_ADDRESS, sc_md_.get());
 
-  key1_ = 0;
-  key1_md_ = std::make_unique<FixedPointerMemoryDevice<1, u8>>(&key1_, kMemoryAccessBoth);
+  key1_md_ = bus_.arena().New<FixedPointerWithHandlerMemoryDevice<1, u8>>(&key1_, [this](u16 address, u8 previous, u8 value, bool failed) -> u8 {
+    if (cpu_mode_ != kCPUModeCGB) {
+      return previous;
+    }
+    // only the prepare bit is writable, current speed is read only
+    return (previous & 0x80) | 0x7E | (value & 0x01);
+  }, kMemoryAccessBoth);
   bus_.AddDevice(KEY1_ADDRESS, key1_md_.get());
+
+  Reset();
 }
 
+void CPU::Reset() {
+  registers_ = Registers{};
+  halted_ = false;
+  cycles_consumed_ = 0;
+  ic_ = 0;
+  cycle_count_ = 0;
+  SetDoubleSpeed(false);
+
+  ime_ = false;
+  ime_delay_ = false;
+  halt_bug_ = false;
+  ie_ = 0;
+  if_ = 0;
+  UpdateInterruptState();
+
+  div_ = 0;
+  tima_ = 0;
+  tma_ = 0;
+  tac_ = 0;
+  tic_ = 0;
+  timer_clock_ = 0;
+  div_clock_ = 0;
+  tima_overflow_ = false;
+  stall_cycles_ = 0;
+
+  wram_select_ = 0x01;
+  wram_0_md_->Fill(0);
+  wram_1_7_md_->Fill(0);
+  wram_1_7_md_->Switch(0);
+  oam_.fill(0);
+  hram_.fill(0);
+  audio_.fill(0);
+  wave_pattern_.fill(0);
+
+  vram_select_ = 0;
+  vram_md_->Fill(0);
+  vram_md_->Switch(0);
+
+  ly_ = 0;
+  lyc_ = 0;
+  obp0_ = 0;
+  obp1_ = 0;
+  lcdc_ = {};
+  lcds_ = {};
+  bgp_ = 0;
+  bcps_ = 0;
+  bgpi_ = 0;
+  ocps_ = 0;
+  obpi_ = 0;
+  ocpd_ = 0;
+  obpd_ = 0;
+  scx_ = 0;
+  scy_ = 0;
+  wx_ = 0;
+  wy_ = 0;
+  joyp_ = 0xCF;
+  buttons_ = 0;
+
+  cpu_mode_ = kCPUModeDMG;
+  cpu_mode_lock_ = 0;
+  cpu_mode_md_->EnableAccess(kMemoryAccessBoth);
+  cpu_mode_lock_md_->EnableAccess(kMemoryAccessBoth);
+  dma_ = 0x00;
+  dma_current_ = 0;
+  sb_ = 0;
+  sc_ = 0;
+  key1_ = 0x7E;
+
+  if (cartridge_) {
+    cartridge_->Reset();
+    ApplyCompatibility();
+  }
+  // the boot ROM maps itself over the cartridge again
+  if (rom_device_ && boot_unloaded_) {
+    MapBootRom();
+  }
+}
+
+template<typename Archive>
+void CPU::Serialize(Archive& archive) {
+  archive(registers_, running_, halted_, clock_speed_, cycles_consumed_, ic_, cycle_count_);
+  archive(double_speed_, speed_shift_, key1_);
+  archive(ime_, ime_delay_, halt_bug_, ie_, if_, pending_interrupts_, check_interrupts_);
+  archive(div_, tima_, tma_, tac_, tic_, timer_clock_, div_clock_, tima_overflow_, stall_cycles_);
+
+  // the boot ROM is mapped or unmapped to match, machines without one only keep the flag
+  u8 boot_unloaded = boot_unloaded_;
+  archive(boot_unloaded);
+  if constexpr (Archive::kLoading) {
+    if (!rom_device_) {
+      boot_unloaded_ = boot_unloaded;
+    } else if (boot_unloaded && !boot_unloaded_) {
+      UnloadBootRom();
+    } else if (!boot_unloaded && boot_unloaded_) {
+      MapBootRom();
+    }
+  }
+
+  archive(wram_select_, vram_select_);
+  archive.Banks(*wram_0_md_);
+  archive.Banks(*wram_1_7_md_);
+  archive.Banks(*vram_md_);
+  archive(oam_, hram_, audio_, wave_pattern_);
+
+  archive(ly_, lyc_, obp0_, obp1_, lcdc_, lcds_, bgp_, bcps_, bgpi_, ocps_, obpi_, ocpd_, obpd_);
+  archive(scx_, scy_, wx_, wy_, joyp_, buttons_);
+  archive(cpu_mode_, cpu_mode_lock_);
+  archive.Access(*cpu_mode_md_);
+  archive.Access(*cpu_mode_lock_md_);
+  archive(dma_, dma_current_, sb_, sc_);
+}
+
+template void CPU::Serialize(StateWriter& archive);
+template void CPU::Serialize(StateReader& archive);
+
 void CPU::Stop() {
-  /*if (key1_ == 0x01) {
-    clock_speed_ = DOUBLE_CPU_CLOCK_SPEED;
+  if (cpu_mode_ == kCPUModeCGB && (key1_ & 0x01)) {
+    SetDoubleSpeed(!double_speed_);
+    // DIV is reset and the CPU stalls for 2050 M-cycles while the clock settles,
+    // UpdateTimers doesn't clock DIV and TIMA with them
+    div_ = 0;
+    div_clock_ = 0;
+    cycles_consumed_ += kSpeedSwitchStallCycles;
+    stall_cycles_ += kSpeedSwitchStallCycles;
     return;
   }
-  running_ = false;*/
   halted_ = true;
   // stop is much more complicated than this
   // https://gbdev.io/pandocs/Reducing_Power_Consumption.html#the-bizarre-case-of-the-game-boy-stop-instruction-before-even-considering-timing
 }
 
 void CPU::Halt() {
+  if (!ime_ && pending_interrupts_ != 0) {
+    // halt bug, the CPU doesn't halt and fails to increment PC after the next opcode
+    halt_bug_ = true;
+    return;
+  }
   halted_ = true;
+  UpdateInterruptState();
   //std::cout << "halted" << std::endl;
 }
 
 void CPU::Step() {
+  INSTRUMENT_FINE_ZONE("CPU::Step");
+  INSTRUMENT_COUNT("instructions", 1);
   cycles_consumed_ = 0;
 //  std::cout << ToHex(registers_.sp) << std::endl;
-  auto instruction = Fetch(alu, registers_, bus_);
+#ifdef ENABLE_DEBUGGER
+  u16 pc = registers_.pc;
+  // the handlers must agree with the opcode table the debugger and the recompiler use
+  u8 opcode = bus_.Peek(pc);
+  const OpcodeInfo& info = opcode == 0xCB ? PrefixedOpcode(bus_.Peek(pc + 1)) : Opcode(opcode);
+#endif
+  EMIT_TRACE_INSTRUCTION(*this);
+  COVERAGE_EXECUTE(registers_.pc);
+  auto instruction = Fetch(instruction_buffer_, alu, registers_, bus_, halt_bug_);
+  halt_bug_ = false;
 #ifdef ENABLE_DEBUGGER
   if (!instruction) {
     DEBUGGER_PAUSE_HERE();
@@ -292,47 +404,72 @@ void CPU::Step() {
     abort();
   }
 #endif
-  EMIT_PRE_EXEC_INSTRUCTION();
+  EMIT_PRE_EXEC_INSTRUCTION(pc);
+#ifndef STEP_EVERY_INSTRUCTION
+  u16 next_pc = registers_.pc;
+#endif
   int cycles = instruction->Execute(*this, alu, registers_, bus_);
   ic_++;
   EMIT_POST_EXEC_INSTRUCTION();
+#ifdef ENABLE_DEBUGGER
+  assert(cycles == info.cycles || cycles == info.cycles_taken);
+#endif
+#ifndef STEP_EVERY_INSTRUCTION
+  // a taken backward jump may close a copy or fill loop, the debugger wants to see every iteration
+  if (instruction->type_ == InstructionType::JR && registers_.pc < next_pc) {
+    cycles += RunIdiom(kIdiomSliceCycles);
+  }
+#endif
   cycles_consumed_ += cycles;
 }
 
 void CPU::HandleInterrupts() {
-  if (ime_) {
-    u8 max = static_cast<u8>(kInterruptMax);
-    for (u8 i = 0; i < max; ++i) {
-      auto type = (InterruptType) (1 << i);
-      if ((ie_ & if_ & type) == 0) {
-        continue;
-      }
-      SetInterruptMasterEnable(false, true);
-      ClearInterrupt(type);
-
-      u16 address = 0x0040 + (i * 8);
-      // cpu waits wait 2 M-cycles
-      cycles_consumed_ += 4 * 2; // 8 T-cycles
-
-      // pushing the PC to stack consumes 2 M-cycles
-      EMIT_CALL(registers_.pc, registers_.sp, address, true);
-      Push(registers_.pc);
-      cycles_consumed_ += 4 * 2; // 8 T-cycles
-
-      // changing the PC consumes 1 last M-cycle
-      registers_.pc = address;
-      cycles_consumed_ += 4 * 1; // 4 T-cycles
-
-      //std::cout << "jump to interrupt: " << ToHex(registers_.pc) << std::endl;
-      break;
-    }
+  if (!check_interrupts_) {
+    return;
   }
-  if (ime_pending_ != ime_) {
-    SetInterruptMasterEnable(ime_pending_, true);
+  if (ime_delay_) {
+    // EI was the last instruction, interrupts are serviced after the next one
+    ime_delay_ = false;
+    ime_ = true;
+    UpdateInterruptState();
+    return;
+  }
+  // any enabled interrupt wakes the CPU up, even when IME is off
+  halted_ = false;
+  if (!ime_) {
+    UpdateInterruptState();
+    return;
   }
+  // lower bits have higher priority
+  u8 index = std::countr_zero(pending_interrupts_);
+  auto type = (InterruptType) (1 << index);
+  SetInterruptMasterEnable(false, true);
+  ClearInterrupt(type);
+
+  u16 address = 0x0040 + (index * 8);
+  // cpu waits wait 2 M-cycles
+  cycles_consumed_ += 4 * 2; // 8 T-cycles
+
+  // pushing the PC to stack consumes 2 M-cycles
+  EMIT_CALL(registers_.pc, registers_.sp(), address, true);
+  PROFILE_CALL(*this, registers_.pc, address);
+  Push(registers_.pc);
+  cycles_consumed_ += 4 * 2; // 8 T-cycles
+
+  // changing the PC consumes 1 last M-cycle
+  registers_.pc = address;
+  cycles_consumed_ += 4 * 1; // 4 T-cycles
+
+  //std::cout << "jump to interrupt: " << ToHex(registers_.pc) << std::endl;
 }
 
 void CPU::UpdateTimers(u32 cycles) {
+  cycle_count_ += cycles;
+  if (stall_cycles_ != 0) [[unlikely]] {
+    u32 stalled = std::min(cycles, stall_cycles_);
+    stall_cycles_ -= stalled;
+    cycles -= stalled;
+  }
   tic_ += cycles;
   if (tima_ == 0 && tima_overflow_) {
     SendInterrupt(kInterruptTypeTimer);
@@ -382,66 +519,104 @@ bool CPU::IsTimerEnabled() {
 }
 
 void CPU::EnableInterrupt(InterruptType type) {
-  std::cout << "enable interrupt: " << InterruptTypeToString(type) << std::endl;
+  //std::cout << "enable interrupt: " << InterruptTypeToString(type) << std::endl;
   ie_ |= (u8)type;
+  UpdateInterruptState();
 }
 
 void CPU::DisableInterrupt(InterruptType type) {
-  std::cout << "disable interrupt: " << InterruptTypeToString(type) << std::endl;
+  //std::cout << "disable interrupt: " << InterruptTypeToString(type) << std::endl;
   ie_ &= ~(u8)type;
+  UpdateInterruptState();
 }
 
 void CPU::SendInterrupt(InterruptType type) {
   //std::cout << "send interrupt: " << InterruptTypeToString(type) << std::endl;
   if_ |= (u8)type;
-  halted_ = false;
+  UpdateInterruptState();
+}
+
+void CPU::SetButtons(u8 buttons) {
+  u8 lines = joyp_ & 0x0F;
+  buttons_ = buttons;
+  UpdateJoypad();
+  // a selected line going from high to low
+  if (lines & ~joyp_ & 0x0F) {
+    SendInterrupt(kInterruptTypeJoypad);
+  }
+}
+
+void CPU::UpdateJoypad() {
+  u8 pressed = 0;
+  if (!(joyp_ & 0x10)) {
+    pressed |= buttons_ & 0x0F;
+  }
+  if (!(joyp_ & 0x20)) {
+    pressed |= buttons_ >> 4;
+  }
+  joyp_ = 0xC0 | (joyp_ & 0x30) | (~pressed & 0x0F);
 }
 
 void CPU::ClearInterrupt(InterruptType type) {
   //std::cout << "clear interrupt: " << InterruptTypeToString(type) << std::endl;
   if_ &= ~(u8)type;
+  UpdateInterruptState();
 }
 
 void CPU::SetInterruptMasterEnable(bool enable, bool immediate) {
-  if (immediate) {
+  if (immediate || !enable) {
+    // DI and RETI take effect right away
     ime_ = enable;
-    ime_pending_ = ime_;
+    ime_delay_ = false;
     //std::cout << "interrupt master enable: " << BoolToStr(enable) << std::endl;
-  } else {
-    ime_pending_ = enable;
+  } else if (!ime_) {
+    ime_delay_ = true;
     //std::cout << "interrupt master enable pending: " << BoolToStr(enable) << std::endl;
   }
+  UpdateInterruptState();
+}
+
+void CPU::UpdateInterruptState() {
+  pending_interrupts_ = ie_ & if_ & 0x1F;
+  check_interrupts_ = ime_delay_ || (pending_interrupts_ != 0 && (ime_ || halted_));
 }
 
 void CPU::SetClockSpeed(u32 clock_speed) {
   clock_speed_ = clock_speed;
 }
 
+void CPU::SetDoubleSpeed(bool enable) {
+  double_speed_ = enable;
+  speed_shift_ = enable ? 0 : 1;
+  key1_ = enable ? 0xFE : 0x7E;
+  SetClockSpeed(enable ? DOUBLE_CPU_CLOCK_SPEED : BASE_CPU_CLOCK_SPEED);
+}
+
 void CPU::Push(u16 value) {
-  registers_.sp = registers_.sp - 2;
+  registers_.set_sp(registers_.sp() - 2);
 #ifdef ENABLE_DEBUGGER
-  if (!bus_.CheckAccess(registers_.sp, kMemoryAccessBoth) ||
-      !bus_.CheckAccess(registers_.sp + 1, kMemoryAccessBoth)) {
+  if (!bus_.CheckAccess(registers_.sp(), kMemoryAccessBoth) ||
+      !bus_.CheckAccess(registers_.sp() + 1, kMemoryAccessBoth)) {
     std::cerr << "push stack overflow!" << std::endl;
     DEBUGGER_PAUSE_HERE();
     return;
   }
 #endif
-  bus_.WriteWord(registers_.sp, value);
+  bus_.WriteWord(registers_.sp(), value);
   //std::cout << "push: " << ToHex(registers_.sp) << " <- " << ToHex(value) << std::endl;
 }
 
 u16 CPU::Pop() {
 #ifdef ENABLE_DEBUGGER
-  if (!bus_.CheckAccess(registers_.sp, kMemoryAccessBoth) ||
-      !bus_.CheckAccess(registers_.sp + 1, kMemoryAccessBoth)) {
+  if (!bus_.CheckAccess(registers_.sp(), kMemoryAccessBoth) ||
+      !bus_.CheckAccess(registers_.sp() + 1, kMemoryAccessBoth)) {
     std::cerr << "pop stack overflow!" << std::endl;
     DEBUGGER_PAUSE_HERE();
     return 0xFF;
   }
 #endif
-  u16 value = bus_.ReadWord(registers_.sp);
-  registers_.sp = registers_.sp + 2;
+  u16 value = bus_.ReadWord(registers_.sp());
+  registers_.set_sp(registers_.sp() + 2);
   //std::cout << "pop: " << ToHex(registers_.sp) << " -> " << ToHex(value) << std::endl;
   return value;
 }
@@ -457,6 +632,7 @@ void CPU::ProcessDMA() {
   if (dma_ == 0) {
     return;
   }
+  INSTRUMENT_ZONE("CPU::ProcessDMA");
   int runs = cycles_consumed_ / 4;
   while (runs > 0 && dma_current_ < 0xA0) {
     oam_[dma_current_] = bus_.Read((dma_ * 0x0100) + dma_current_);
@@ -479,14 +655,20 @@ void CPU::LoadBootRom(std::vector<u8> data) {
   if (!boot_unloaded_) {
     return;
   }
-  boot_unloaded_ = false;
   int size = data.size(); // keep the size before moving
-  rom_device_ = std::make_unique<BootROMDevice>(std::move(data));
+  rom_device_ = bus_.arena().New<BootROMDevice>(std::move(data));
   rom_size_ = size;
-  bus_.AddDevice(0x0000, 0x0100, rom_device_.get());
-  if (size > 0x0100) { // for loading DMG rom, probably should get rid of it
-    bus_.AddDevice(0x0200, 0x08FF, rom_device_.get());
+  MapBootRom();
+}
+
+void CPU::MapBootRom() {
+  boot_unloaded_ = false;
+  bus_.PushFrontDevice(0x0000, 0x0100, rom_device_.get());
+  if (rom_size_ > 0x0100) { // for loading DMG rom, probably should get rid of it
+    bus_.PushFrontDevice(0x0200, 0x08FF, rom_device_.get());
   }
+  // what's at $0000 changed, the same as a bank switch to whoever caches it
+  EMIT_BANK_CHANGE(bus_);
 }
 
 void CPU::UnloadBootRom() {
@@ -498,11 +680,28 @@ void CPU::UnloadBootRom() {
   if (rom_size_ > 0x0100) {
     bus_.PopFrontDevice(0x0200, 0x08FF);
   }
-  rom_size_ = 0;
   EMIT_ROM_UNMAP(bus_);
 }
 
 void CPU::LoadCartridge(std::unique_ptr<Cartridge> cartridge) {
+  if (cartridge_) {
+    cartridge_->RemoveFromBus();
+    cartridge_ = nullptr;
+    // nothing was made after the old cartridge, the new one reuses its space
+    if (bus_.arena().used() == cartridge_arena_end_) {
+      bus_.arena().Rewind(cartridge_arena_begin_);
+    }
+  }
   cartridge_ = std::move(cartridge);
+  ApplyCompatibility();
+  cartridge_arena_begin_ = bus_.arena().used();
   cartridge_->InitBus(bus_);
+  cartridge_arena_end_ = bus_.arena().used();
+}
+
+void CPU::ApplyCompatibility() {
+  // the CGB boot rom copies the header's compatibility flag into KEY0, our boot rom doesn't
+  if (cartridge_->compatibility() != CartridgeCompatibility::OnlyDMG) {
+    cpu_mode_ = kCPUModeCGB;
+  }
 }
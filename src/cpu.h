@@ -2,9 +2,15 @@
 
 #include "alu.h"
 #include "cartridge.h"
+#include "coverage.h"
+#include "debug.h"
 #include "event.h"
+#include "instrument.h"
 #include "memory.h"
+#include "profiler.h"
 #include "register.h"
+#include "trace.h"
+#include <cstddef>
 
 inline std::string InterruptTypeToString(InterruptType type) {
   switch (type) {
@@ -23,15 +29,72 @@ inline std::string InterruptTypeToString(InterruptType type) {
   }
 }
 
+// the debugger, the tracer, the profiler and coverage need every instruction to go
+// through Step, the threaded interpreter, idioms and recompiled blocks are left out
+// with them
+#if defined(ENABLE_DEBUGGER) || defined(ENABLE_TRACE) || defined(ENABLE_PROFILER) || defined(ENABLE_COVERAGE)
+#define STEP_EVERY_INSTRUCTION
+#endif
+
+// the threaded interpreter relies on labels as values and doesn't report
+// every instruction, so it is only built in release builds, THREADED_INTERPRETER
+// makes the emulator use it, tools can pick it at runtime either way
+#if defined(__GNUC__) && !defined(STEP_EVERY_INSTRUCTION)
+#define HAVE_THREADED_INTERPRETER
+#endif
+#if defined(THREADED_INTERPRETER) && defined(HAVE_THREADED_INTERPRETER)
+#define USE_THREADED_INTERPRETER
+#endif
+
+struct Instruction;
+
+// Where Fetch builds the instruction it decodes, one is reused for every instruction
+// so stepping doesn't allocate, see instructions.h
+class InstructionBuffer {
+ public:
+  static constexpr size_t kSize = 32;
+
+  template<typename T, typename... Args>
+  Instruction* Emplace(Args&&... args);
+
+ private:
+  alignas(std::max_align_t) std::byte storage_[kSize];
+};
+
 class CPU {
  public:
+  // a recognized loop runs at most this long at once so timers, the PPU and
+  // interrupts don't fall more than a scanline behind
+  static constexpr u32 kIdiomSliceCycles = 456;
+  // T-cycles STOP stalls for while the clock settles after a speed switch
+  static constexpr u32 kSpeedSwitchStallCycles = 2050 * 4;
+#ifdef HAVE_THREADED_INTERPRETER
+  // T-cycles the threaded interpreter may run before timers and the PPU catch up
+  static constexpr u32 kThreadedSliceCycles = 80;
+#endif
+
   CPU(EventBus& event_bus, MemoryBus& bus);
   CPU(const CPU&) = delete;
 
+  // back to the state after power on without remaking the devices, the cartridge
+  // and the boot ROM stay loaded and mapped, running_ is left alone
+  void Reset();
+  // all of the state except the cartridge's, both ways, see state.h
+  template<typename Archive>
+  void Serialize(Archive& archive);
+
   // Control
   void Stop();
   void Halt();
   void Step();
+#ifdef HAVE_THREADED_INTERPRETER
+  // runs instructions until at least budget T-cycles are used, the budget is
+  // only checked after branches and memory writes
+  void StepThreaded(u32 budget);
+#endif
+  // runs the copy or fill loop at the PC natively, see idioms.h, returns the T-cycles
+  // used or 0 if there is none or its memory isn't plain RAM
+  u32 RunIdiom(u32 max_cycles);
   void HandleInterrupts();
 
   void UpdateTimers(u32 cycles);
@@ -44,8 +107,24 @@ class CPU {
   void SendInterrupt(InterruptType type);
   void ClearInterrupt(InterruptType type);
   void SetInterruptMasterEnable(bool enable, bool immediate = false);
+  void UpdateInterruptState();
+
+  // JoypadButton bits of the buttons held down, pressing one the game is
+  // polling requests the joypad interrupt
+  void SetButtons(u8 buttons);
+  void UpdateJoypad(); // JOYP's lines from the select bits and buttons_
 
   void SetClockSpeed(u32 clock_speed);
+  void SetDoubleSpeed(bool enable);
+
+  // scheduler ticks used by the last step, see SCHEDULER_CLOCK_SPEED
+  u32 ticks_consumed() const { return cycles_consumed_ << speed_shift_; }
+
+  // ROM bank mapped at address, 0 outside the switchable bank
+  u16 CodeBank(u16 address) const {
+    bool switchable = address >= CARTRIDGE_ROM_01_START_ADDRESS && address <= CARTRIDGE_ROM_01_END_ADDRESS;
+    return switchable && cartridge_ ? cartridge_->rom_bank() : 0;
+  }
 
   void Push(u16 value);
   u16 Pop();
@@ -58,8 +137,13 @@ class CPU {
   // Load
   void LoadBootRom(std::vector<u8> data);
   void UnloadBootRom();
+  // replaces the cartridge if there is one, Reset after that to start it
   void LoadCartridge(std::unique_ptr<Cartridge> cartridge);
 
+ private:
+  void MapBootRom();
+  void ApplyCompatibility(); // CPU mode from the cartridge header
+
  public:
   Registers registers_;
   EventBus& event_bus_;
@@ -67,7 +151,10 @@ class CPU {
   ALU alu{registers_};
 
   std::unique_ptr<Cartridge> cartridge_;
-  std::unique_ptr<MemoryDevice> rom_device_;
+  // where the cartridge's devices and RAM start and end in the bus's arena
+  size_t cartridge_arena_begin_ = 0;
+  size_t cartridge_arena_end_ = 0;
+  ArenaPtr<MemoryDevice> rom_device_;
   u16 rom_size_;
 
   bool running_ = false;
@@ -75,17 +162,25 @@ class CPU {
   u32 clock_speed_ = 0; // in T-cycles
   u32 cycles_consumed_ = 0;
   u32 ic_ = 0; // instruction counter
+  InstructionBuffer instruction_buffer_;
+  u64 cycle_count_ = 0; // T-cycles since power on, counted by UpdateTimers
   u8 boot_unloaded_ = true; // not loaded by default
-  std::unique_ptr<MemoryDevice> boot_unmap_md_;
+  ArenaPtr<MemoryDevice> boot_unmap_md_;
 
-  // todo double speed mode switching
+  // Double speed mode, switched by STOP when KEY1 is armed
+  bool double_speed_ = false;
+  u8 speed_shift_ = 1; // T-cycle to scheduler tick shift, 1 in normal speed, 0 in double speed
 
   // Interrupt
   bool ime_ = false;
-  bool ime_pending_ = false;
+  bool ime_delay_ = false; // EI enables IME after the next instruction
+  bool halt_bug_ = false;
   u8 ie_ = 0;
 
   u8 if_ = 0;
+  // cached by UpdateInterruptState whenever IE, IF, IME or HALT changes
+  u8 pending_interrupts_ = 0; // ie_ & if_
+  bool check_interrupts_ = false; // HandleInterrupts has something to do
   // Timer
   u8 div_;
   u8 tima_ = 0;
@@ -96,6 +191,7 @@ class CPU {
   s32 timer_clock_ = 0;
   s32 div_clock_ = 0;
   bool tima_overflow_ = false;
+  u32 stall_cycles_ = 0; // of the speed switch, DIV and TIMA don't count them
 
   // Bank stuff
   // Work RAM (4KiB each)
@@ -108,112 +204,113 @@ class CPU {
   std::array<u8, WRAM_SIZE> wram_5_;
   std::array<u8, WRAM_SIZE> wram_6_;
   std::array<u8, WRAM_SIZE> wram_7_;
-  std::unique_ptr<MemoryDevice> wram_0_md_; // switches 1-7
-  std::unique_ptr<SwitchingArrayMemoryDevice<WRAM_SIZE>> wram_1_7_md_; // switches 1-7
-  std::unique_ptr<MemoryDevice> wram_select_md_;
+  ArenaPtr<CopyOnWriteArrayMemoryDevice<WRAM_SIZE>> wram_0_md_;
+  ArenaPtr<CopyOnWriteArrayMemoryDevice<WRAM_SIZE>> wram_1_7_md_; // switches 1-7
+  ArenaPtr<MemoryDevice> wram_select_md_;
 
   // Other regions
   std::array<u8, OAM_SIZE> oam_;
-  std::unique_ptr<MemoryDevice> oam_md_;
+  ArenaPtr<MemoryDevice> oam_md_;
 
   std::array<u8, HRAM_SIZE> hram_;
-  std::unique_ptr<MemoryDevice> hram_md_;
+  ArenaPtr<MemoryDevice> hram_md_;
 
   // Audio Stuff
   std::array<u8, AUDIO_SIZE> audio_;
-  std::unique_ptr<MemoryDevice> audio_md_;
+  ArenaPtr<MemoryDevice> audio_md_;
 
   std::array<u8, WAVE_PATTERN_SIZE> wave_pattern_;
-  std::unique_ptr<MemoryDevice> wave_pattern_md_;
+  ArenaPtr<MemoryDevice> wave_pattern_md_;
 
   // Video RAM (8KiB each)
   u8 vram_select_;
   std::array<u8, VRAM_SIZE> vram_0_;
   std::array<u8, VRAM_SIZE> vram_1_;
-  std::unique_ptr<SwitchingArrayMemoryDevice<VRAM_SIZE>> vram_md_; // switches 0-1, only in CGB mode
-  std::unique_ptr<MemoryDevice> vram_select_md_;
+  ArenaPtr<CopyOnWriteArrayMemoryDevice<VRAM_SIZE>> vram_md_; // switches 0-1, only in CGB mode
+  ArenaPtr<MemoryDevice> vram_select_md_;
 
   u8 ly_; // read only
-  std::unique_ptr<MemoryDevice> ly_md_;
+  ArenaPtr<MemoryDevice> ly_md_;
 
   u8 lyc_;
-  std::unique_ptr<MemoryDevice> lyc_md_; // read/write
+  ArenaPtr<MemoryDevice> lyc_md_; // read/write
 
   u8 obp0_;
-  std::unique_ptr<MemoryDevice> obp0_md_;
+  ArenaPtr<MemoryDevice> obp0_md_;
 
   u8 obp1_;
-  std::unique_ptr<MemoryDevice> obp1_md_;
+  ArenaPtr<MemoryDevice> obp1_md_;
 
   LCDC lcdc_;
-  std::unique_ptr<MemoryDevice> lcdc_md_;
+  ArenaPtr<MemoryDevice> lcdc_md_;
 
   LCDS lcds_;
-  std::unique_ptr<MemoryDevice> lcds_md_;
+  ArenaPtr<MemoryDevice> lcds_md_;
 
   // only in DMG mode
   u8 bgp_;
-  std::unique_ptr<MemoryDevice> bgp_md_;
+  ArenaPtr<MemoryDevice> bgp_md_;
 
 
   // only in DMG
   u8 bcps_;
   // only in CGB
   u8 bgpi_;
-  std::unique_ptr<MemoryDevice> bcps_bgpi_md_;
+  ArenaPtr<MemoryDevice> bcps_bgpi_md_;
 
   // only in DMG
   u8 ocps_;
   // only in CGB
   u8 obpi_;
-  std::unique_ptr<MemoryDevice> ocps_obpi_md_;
+  ArenaPtr<MemoryDevice> ocps_obpi_md_;
 
   // only in DMG
   u8 ocpd_;
   // only in CGB
   u8 obpd_;
-  std::unique_ptr<MemoryDevice> ocpd_obpd_md_;
+  ArenaPtr<MemoryDevice> ocpd_obpd_md_;
 
   u8 scx_;
-  std::unique_ptr<MemoryDevice> scx_md_;
+  ArenaPtr<MemoryDevice> scx_md_;
 
   u8 scy_;
-  std::unique_ptr<MemoryDevice> scy_md_;
+  ArenaPtr<MemoryDevice> scy_md_;
 
   u8 wx_;
-  std::unique_ptr<MemoryDevice> wx_md_;
+  ArenaPtr<MemoryDevice> wx_md_;
 
   u8 wy_;
-  std::unique_ptr<MemoryDevice> wy_md_;
+  ArenaPtr<MemoryDevice> wy_md_;
 
   u8 joyp_;
-  std::unique_ptr<MemoryDevice> joyp_md_;
+  u8 buttons_ = 0; // JoypadButton bits
+  ArenaPtr<MemoryDevice> joyp_md_;
 
   CPUMode cpu_mode_;
-  std::unique_ptr<MemoryDevice> cpu_mode_md_;
+  ArenaPtr<MemoryDevice> cpu_mode_md_;
   u8 cpu_mode_lock_;
-  std::unique_ptr<MemoryDevice> cpu_mode_lock_md_;
+  ArenaPtr<MemoryDevice> cpu_mode_lock_md_;
 
   u8 dma_;
   s16 dma_current_;
-  std::unique_ptr<MemoryDevice> dma_md_;
+  ArenaPtr<MemoryDevice> dma_md_;
 
   // Timer and interrupt memory devices for mapping
-  std::unique_ptr<MemoryDevice> ie_md_;
-  std::unique_ptr<MemoryDevice> if_md_;
-  std::unique_ptr<MemoryDevice> div_md_;
-  std::unique_ptr<MemoryDevice> tima_md_;
-  std::unique_ptr<MemoryDevice> tma_md_;
-  std::unique_ptr<MemoryDevice> tac_md_;
+  ArenaPtr<MemoryDevice> ie_md_;
+  ArenaPtr<MemoryDevice> if_md_;
+  ArenaPtr<MemoryDevice> div_md_;
+  ArenaPtr<MemoryDevice> tima_md_;
+  ArenaPtr<MemoryDevice> tma_md_;
+  ArenaPtr<MemoryDevice> tac_md_;
 
   // Serial
   u8 sb_;
-  std::unique_ptr<MemoryDevice> sb_md_;
+  ArenaPtr<MemoryDevice> sb_md_;
   u8 sc_;
-  std::unique_ptr<MemoryDevice> sc_md_;
+  ArenaPtr<MemoryDevice> sc_md_;
 
   // Prepare speed switch
   u8 key1_;
-  std::unique_ptr<MemoryDevice> key1_md_;
+  ArenaPtr<MemoryDevice> key1_md_;
 
 };
\ No newline at end of file
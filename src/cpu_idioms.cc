@@ -0,0 +1,90 @@
+#include "cpu.h"
+#include "idioms.h"
+#include <algorithm>
+
+u32 CPU::RunIdiom(u32 max_cycles) {
+  u16 pc = registers_.pc;
+  if (check_interrupts_ || halt_bug_) {
+    return 0;
+  }
+  const u8* page = bus_.ReadPagePointer(pc);
+  if (!page) {
+    return 0;
+  }
+  const LoopPattern* pattern = MatchLoopIdiom(page + (pc & 0xFF), 0x100 - (pc & 0xFF));
+  if (!pattern) {
+    return 0;
+  }
+
+  constexpr u8 kOffsetA = RegisterOffset(ArithmeticTarget::A);
+  u8 a = registers_.file[kOffsetA];
+  u16 hl = registers_.Get<ArithmeticTarget::HL>();
+  u16 de = registers_.Get<ArithmeticTarget::DE>();
+  bool copy = pattern->idiom == LoopIdiom::CopyHLToDE || pattern->idiom == LoopIdiom::CopyDEToHL;
+  bool decrement = pattern->idiom == LoopIdiom::FillDecrementB || pattern->idiom == LoopIdiom::FillDecrementC;
+  ArithmeticTarget counter_target = copy ? ArithmeticTarget::BC
+      : pattern->idiom == LoopIdiom::FillIncrementB || pattern->idiom == LoopIdiom::FillDecrementB ? ArithmeticTarget::B
+      : ArithmeticTarget::C;
+  u32 counter = registers_.Get(counter_target);
+  if (counter == 0) {
+    // the counter wraps around on the first iteration
+    counter = copy ? 0x10000 : 0x100;
+  }
+  u32 iterations = std::min<u32>(counter, std::max<u32>(max_cycles / pattern->cycles, 1));
+
+  // the bytes are moved a page at a time, the loop stops early in front of a page
+  // with side effects and the interpreter runs that iteration
+  u16 source = pattern->idiom == LoopIdiom::CopyHLToDE ? hl : de;
+  u16 destination = pattern->idiom == LoopIdiom::CopyHLToDE ? de : hl;
+  u32 done = 0;
+  while (done < iterations) {
+    u32 chunk = iterations - done;
+    u8* to = bus_.WritePagePointer(destination);
+    if (!to) {
+      break;
+    }
+    if (copy) {
+      const u8* from = bus_.ReadPagePointer(source);
+      if (!from) {
+        break;
+      }
+      chunk = std::min<u32>({chunk, 0x100u - (source & 0xFF), 0x100u - (destination & 0xFF)});
+      // byte by byte like the guest loop in case the ranges overlap
+      for (u32 i = 0; i < chunk; i++) {
+        to[(destination & 0xFF) + i] = from[(source & 0xFF) + i];
+      }
+      source += chunk;
+    } else if (decrement) {
+      chunk = std::min<u32>(chunk, (destination & 0xFF) + 1);
+      std::memset(to + (destination & 0xFF) - chunk + 1, a, chunk);
+    } else {
+      chunk = std::min<u32>(chunk, 0x100u - (destination & 0xFF));
+      std::memset(to + (destination & 0xFF), a, chunk);
+    }
+    destination = decrement ? destination - chunk : destination + chunk;
+    done += chunk;
+  }
+  if (done == 0) {
+    return 0;
+  }
+
+  bool finished = done == counter;
+  if (copy) {
+    u16 bc = counter - done;
+    registers_.Set<ArithmeticTarget::BC>(bc);
+    registers_.Set<ArithmeticTarget::HL>(pattern->idiom == LoopIdiom::CopyHLToDE ? source : destination);
+    registers_.Set<ArithmeticTarget::DE>(pattern->idiom == LoopIdiom::CopyHLToDE ? destination : source);
+    // the last ld a,b / or c leaves b | c in A
+    a = (bc >> 8) | (bc & 0xFF);
+    registers_.flags.FromByte(a == 0 ? 0x80 : 0x00);
+  } else {
+    registers_.Set<ArithmeticTarget::HL>(destination);
+    // the flags are the ones of the last decrement
+    registers_.Set(counter_target, alu.Dec(counter - done + 1));
+  }
+  registers_.file[kOffsetA] = a;
+
+  registers_.pc = finished ? pc + pattern->length : pc;
+  ic_ += done * pattern->instructions;
+  return done * pattern->cycles - (finished ? 4 : 0);
+}
@@ -0,0 +1,511 @@
+#include "cpu.h"
+#include "instructions.h"
+#include "opcodes.h"
+
+#ifdef HAVE_THREADED_INTERPRETER
+
+// B, C, D, E, H, L, [HL], A as encoded in the operand bits of an opcode
+static constexpr u8 kOperandOffsets[8] = {
+    RegisterOffset(ArithmeticTarget::B), RegisterOffset(ArithmeticTarget::C),
+    RegisterOffset(ArithmeticTarget::D), RegisterOffset(ArithmeticTarget::E),
+    RegisterOffset(ArithmeticTarget::H), RegisterOffset(ArithmeticTarget::L),
+    0, RegisterOffset(ArithmeticTarget::A)};
+static constexpr u8 kOperandMemory = 6;
+static constexpr u8 kOffsetA = RegisterOffset(ArithmeticTarget::A);
+static constexpr u8 kOffsetHL = RegisterOffset(ArithmeticTarget::HL);
+
+static constexpr const std::array<u16, 512>* kShiftTables[8] = {
+    &kShiftTable<ShiftOp::RLC>, &kShiftTable<ShiftOp::RRC>, &kShiftTable<ShiftOp::RL>, &kShiftTable<ShiftOp::RR>,
+    &kShiftTable<ShiftOp::SLA>, &kShiftTable<ShiftOp::SRA>, &kShiftTable<ShiftOp::SWAP>, &kShiftTable<ShiftOp::SRL>};
+
+// no 256-byte page has this index, forces the next fetch to resolve the page again
+static constexpr u16 kNoPage = 0x100;
+
+void CPU::StepThreaded(u32 budget) {
+  cycles_consumed_ = 0;
+  if (halt_bug_) {
+    // the doubled opcode read is only modelled by the decoder
+    Step();
+    return;
+  }
+
+  static void* const kLabels[256] = {
+      &&nop, &&ld_rr_n16, &&ld_rr_a, &&inc_rr, &&inc_r, &&dec_r, &&ld_r_n8, &&generic, &&generic, &&generic, &&ld_a_rr, &&dec_rr, &&inc_r, &&dec_r, &&ld_r_n8, &&generic,  // 0x
+      &&generic, &&ld_rr_n16, &&ld_rr_a, &&inc_rr, &&inc_r, &&dec_r, &&ld_r_n8, &&generic, &&jr, &&generic, &&ld_a_rr, &&dec_rr, &&inc_r, &&dec_r, &&ld_r_n8, &&generic,  // 1x
+      &&jr_cc, &&ld_rr_n16, &&ld_hli_a, &&inc_rr, &&inc_r, &&dec_r, &&ld_r_n8, &&generic, &&jr_cc, &&generic, &&ld_a_hli, &&dec_rr, &&inc_r, &&dec_r, &&ld_r_n8, &&generic,  // 2x
+      &&jr_cc, &&ld_rr_n16, &&ld_hld_a, &&inc_rr, &&inc_hl, &&dec_hl, &&ld_hl_n8, &&generic, &&jr_cc, &&generic, &&ld_a_hld, &&dec_rr, &&inc_r, &&dec_r, &&ld_r_n8, &&generic,  // 3x
+      &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_hl, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_hl, &&ld_r_r,  // 4x
+      &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_hl, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_hl, &&ld_r_r,  // 5x
+      &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_hl, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_hl, &&ld_r_r,  // 6x
+      &&ld_hl_r, &&ld_hl_r, &&ld_hl_r, &&ld_hl_r, &&ld_hl_r, &&ld_hl_r, &&generic, &&ld_hl_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_r, &&ld_r_hl, &&ld_r_r,  // 7x
+      &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_hl, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_hl, &&alu_r,  // 8x
+      &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_hl, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_hl, &&alu_r,  // 9x
+      &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_hl, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_hl, &&alu_r,  // Ax
+      &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_hl, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_r, &&alu_hl, &&alu_r,  // Bx
+      &&ret_cc, &&pop_rr, &&jp_cc, &&jp, &&call_cc, &&push_rr, &&alu_n8, &&generic, &&ret_cc, &&ret, &&jp_cc, &&prefixed, &&call_cc, &&call, &&alu_n8, &&generic,  // Cx
+      &&ret_cc, &&pop_rr, &&jp_cc, &&generic, &&call_cc, &&push_rr, &&alu_n8, &&generic, &&ret_cc, &&generic, &&jp_cc, &&generic, &&call_cc, &&generic, &&alu_n8, &&generic,  // Dx
+      &&ldh_n_a, &&pop_rr, &&ldh_c_a, &&generic, &&generic, &&push_rr, &&alu_n8, &&generic, &&generic, &&jp_hl, &&ld_nn_a, &&generic, &&generic, &&generic, &&alu_n8, &&generic,  // Ex
+      &&ldh_a_n, &&pop_af, &&ldh_a_c, &&generic, &&generic, &&push_af, &&alu_n8, &&generic, &&generic, &&generic, &&ld_a_nn, &&generic, &&generic, &&generic, &&alu_n8, &&generic,  // Fx
+  };
+
+  u32 cycles = 0;
+  u32 count = 0;
+  u8 opcode;
+
+  // opcodes are read straight from the ROM page the PC is in, anything else goes through the bus
+  u16 code_page = kNoPage;
+  const u8* code = nullptr;
+  auto fetch = [&]() -> u8 {
+    u16 pc = registers_.pc;
+    registers_.pc = pc + 1;
+    if ((pc >> 8) != code_page) {
+      code_page = pc >> 8;
+      code = pc < 0x8000 ? bus_.ReadPagePointer(pc) : nullptr;
+    }
+    return code ? code[pc & 0xFF] : bus_.Read(pc);
+  };
+  auto fetch_word = [&]() -> u16 {
+    u8 low = fetch();
+    return low | (fetch() << 8);
+  };
+  auto get_word = [&](u8 offset) -> u16 {
+    u16 value;
+    std::memcpy(&value, &registers_.file[offset], sizeof(value));
+    return value;
+  };
+  auto set_word = [&](u8 offset, u16 value) {
+    std::memcpy(&registers_.file[offset], &value, sizeof(value));
+  };
+  auto write = [&](u16 address, u8 value) {
+    bus_.Write(address, value);
+    // the write may have switched a ROM bank or unmapped the boot ROM
+    code_page = kNoPage;
+  };
+  // NZ, Z, NC, C
+  auto condition = [&]() -> bool {
+    switch ((opcode >> 3) & 0x3) {
+      case 0: return !registers_.flags.zero();
+      case 1: return registers_.flags.zero();
+      case 2: return !registers_.flags.carry();
+      default: return registers_.flags.carry();
+    }
+  };
+  // ADD, ADC, SUB, SBC, AND, XOR, OR, CP
+  auto arithmetic = [&](u8 value) {
+    u8& a = registers_.file[kOffsetA];
+    switch ((opcode >> 3) & 0x7) {
+      case 0: a = alu.Add(a, value); break;
+      case 1: a = alu.AddWithCarry(a, value); break;
+      case 2: a = alu.Sub(a, value); break;
+      case 3: a = alu.SubWithCarry(a, value); break;
+      case 4:
+        a &= value;
+        registers_.flags.FromByte(a == 0 ? 0xA0 : 0x20);
+        break;
+      case 5:
+        a ^= value;
+        registers_.flags.FromByte(a == 0 ? 0x80 : 0x00);
+        break;
+      case 6:
+        a |= value;
+        registers_.flags.FromByte(a == 0 ? 0x80 : 0x00);
+        break;
+      case 7: alu.Sub(a, value); break;
+    }
+  };
+
+  // straight-line instructions jump to the next handler directly, the budget
+  // and interrupt state are only looked at after branches and memory writes
+#define THREADED_DISPATCH() \
+  count++;                  \
+  opcode = fetch();         \
+  goto *kLabels[opcode]
+#define THREADED_CHECKPOINT()                                 \
+  if (cycles >= budget || check_interrupts_ || halted_) {     \
+    count++;                                                  \
+    goto exit;                                                \
+  }                                                           \
+  THREADED_DISPATCH()
+  // timers and the PPU only catch up after the slice, so I/O registers are only
+  // accessed at the start of one, the instruction is run again from its first byte
+#define THREADED_SYNC_IO(address, length)                          \
+  if ((address) >= 0xFF00 && (address) < 0xFF80 && cycles != 0) {  \
+    registers_.pc = registers_.pc - (length);                      \
+    goto exit;                                                     \
+  }
+
+  opcode = fetch();
+  goto *kLabels[opcode];
+
+nop:
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+
+ld_rr_n16:
+  set_word((opcode >> 4) * 2, fetch_word());
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+
+ld_rr_a: {
+  u16 address = get_word((opcode >> 4) * 2);
+  THREADED_SYNC_IO(address, 1);
+  write(address, registers_.file[kOffsetA]);
+  cycles += Opcode(opcode).cycles;
+  THREADED_CHECKPOINT();
+}
+
+ld_hli_a: {
+  u16 hl = get_word(kOffsetHL);
+  THREADED_SYNC_IO(hl, 1);
+  write(hl, registers_.file[kOffsetA]);
+  set_word(kOffsetHL, hl + 1);
+  cycles += Opcode(opcode).cycles;
+  THREADED_CHECKPOINT();
+}
+
+ld_hld_a: {
+  u16 hl = get_word(kOffsetHL);
+  THREADED_SYNC_IO(hl, 1);
+  write(hl, registers_.file[kOffsetA]);
+  set_word(kOffsetHL, hl - 1);
+  cycles += Opcode(opcode).cycles;
+  THREADED_CHECKPOINT();
+}
+
+ld_a_rr: {
+  u16 address = get_word((opcode >> 4) * 2);
+  THREADED_SYNC_IO(address, 1);
+  registers_.file[kOffsetA] = bus_.Read(address);
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+}
+
+ld_a_hli: {
+  u16 hl = get_word(kOffsetHL);
+  THREADED_SYNC_IO(hl, 1);
+  registers_.file[kOffsetA] = bus_.Read(hl);
+  set_word(kOffsetHL, hl + 1);
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+}
+
+ld_a_hld: {
+  u16 hl = get_word(kOffsetHL);
+  THREADED_SYNC_IO(hl, 1);
+  registers_.file[kOffsetA] = bus_.Read(hl);
+  set_word(kOffsetHL, hl - 1);
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+}
+
+inc_rr:
+  set_word((opcode >> 4) * 2, get_word((opcode >> 4) * 2) + 1);
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+
+dec_rr:
+  set_word((opcode >> 4) * 2, get_word((opcode >> 4) * 2) - 1);
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+
+inc_r: {
+  u8& r = registers_.file[kOperandOffsets[(opcode >> 3) & 0x7]];
+  r = alu.Inc(r);
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+}
+
+dec_r: {
+  u8& r = registers_.file[kOperandOffsets[(opcode >> 3) & 0x7]];
+  r = alu.Dec(r);
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+}
+
+inc_hl: {
+  u16 hl = get_word(kOffsetHL);
+  THREADED_SYNC_IO(hl, 1);
+  write(hl, alu.Inc(bus_.Read(hl)));
+  cycles += Opcode(opcode).cycles;
+  THREADED_CHECKPOINT();
+}
+
+dec_hl: {
+  u16 hl = get_word(kOffsetHL);
+  THREADED_SYNC_IO(hl, 1);
+  write(hl, alu.Dec(bus_.Read(hl)));
+  cycles += Opcode(opcode).cycles;
+  THREADED_CHECKPOINT();
+}
+
+ld_r_n8:
+  registers_.file[kOperandOffsets[(opcode >> 3) & 0x7]] = fetch();
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+
+ld_hl_n8: {
+  u16 hl = get_word(kOffsetHL);
+  THREADED_SYNC_IO(hl, 1);
+  write(hl, fetch());
+  cycles += Opcode(opcode).cycles;
+  THREADED_CHECKPOINT();
+}
+
+ld_r_r:
+  registers_.file[kOperandOffsets[(opcode >> 3) & 0x7]] = registers_.file[kOperandOffsets[opcode & 0x7]];
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+
+ld_r_hl: {
+  u16 hl = get_word(kOffsetHL);
+  THREADED_SYNC_IO(hl, 1);
+  registers_.file[kOperandOffsets[(opcode >> 3) & 0x7]] = bus_.Read(hl);
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+}
+
+ld_hl_r: {
+  u16 hl = get_word(kOffsetHL);
+  THREADED_SYNC_IO(hl, 1);
+  write(hl, registers_.file[kOperandOffsets[opcode & 0x7]]);
+  cycles += Opcode(opcode).cycles;
+  THREADED_CHECKPOINT();
+}
+
+alu_r:
+  arithmetic(registers_.file[kOperandOffsets[opcode & 0x7]]);
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+
+alu_hl: {
+  u16 hl = get_word(kOffsetHL);
+  THREADED_SYNC_IO(hl, 1);
+  arithmetic(bus_.Read(hl));
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+}
+
+alu_n8:
+  arithmetic(fetch());
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+
+jr: {
+  s8 offset = fetch();
+  registers_.pc = registers_.pc + offset;
+  cycles += Opcode(opcode).cycles;
+  THREADED_CHECKPOINT();
+}
+
+jr_cc: {
+  s8 offset = fetch();
+  if (condition()) {
+    registers_.pc = registers_.pc + offset;
+    cycles += Opcode(opcode).cycles_taken;
+    if (offset < 0) {
+      // copy and fill loops finish natively, they only touch RAM so the code page stays valid
+      cycles += RunIdiom(kIdiomSliceCycles);
+    }
+  } else {
+    cycles += Opcode(opcode).cycles;
+  }
+  THREADED_CHECKPOINT();
+}
+
+jp:
+  registers_.pc = fetch_word();
+  cycles += Opcode(opcode).cycles;
+  THREADED_CHECKPOINT();
+
+jp_cc: {
+  u16 address = fetch_word();
+  if (condition()) {
+    registers_.pc = address;
+    cycles += Opcode(opcode).cycles_taken;
+  } else {
+    cycles += Opcode(opcode).cycles;
+  }
+  THREADED_CHECKPOINT();
+}
+
+jp_hl:
+  registers_.pc = get_word(kOffsetHL);
+  cycles += Opcode(opcode).cycles;
+  THREADED_CHECKPOINT();
+
+call: {
+  u16 address = fetch_word();
+  Push(registers_.pc);
+  registers_.pc = address;
+  code_page = kNoPage;
+  cycles += Opcode(opcode).cycles;
+  THREADED_CHECKPOINT();
+}
+
+call_cc: {
+  u16 address = fetch_word();
+  if (condition()) {
+    Push(registers_.pc);
+    registers_.pc = address;
+    code_page = kNoPage;
+    cycles += Opcode(opcode).cycles_taken;
+  } else {
+    cycles += Opcode(opcode).cycles;
+  }
+  THREADED_CHECKPOINT();
+}
+
+ret:
+  registers_.pc = Pop();
+  cycles += Opcode(opcode).cycles;
+  THREADED_CHECKPOINT();
+
+ret_cc:
+  if (condition()) {
+    registers_.pc = Pop();
+    cycles += Opcode(opcode).cycles_taken;
+  } else {
+    cycles += Opcode(opcode).cycles;
+  }
+  THREADED_CHECKPOINT();
+
+pop_rr:
+  set_word(((opcode >> 4) - 0xC) * 2, Pop());
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+
+pop_af: {
+  u16 value = Pop();
+  registers_.file[kOffsetA] = value >> 8;
+  registers_.flags.FromByte(value & 0xF0);
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+}
+
+push_rr:
+  Push(get_word(((opcode >> 4) - 0xC) * 2));
+  code_page = kNoPage;
+  cycles += Opcode(opcode).cycles;
+  THREADED_CHECKPOINT();
+
+push_af:
+  Push((registers_.file[kOffsetA] << 8) | registers_.flags.ToByte());
+  code_page = kNoPage;
+  cycles += Opcode(opcode).cycles;
+  THREADED_CHECKPOINT();
+
+ldh_n_a: {
+  u16 address = 0xFF00 + fetch();
+  THREADED_SYNC_IO(address, 2);
+  write(address, registers_.file[kOffsetA]);
+  cycles += Opcode(opcode).cycles;
+  THREADED_CHECKPOINT();
+}
+
+ldh_a_n: {
+  u16 address = 0xFF00 + fetch();
+  THREADED_SYNC_IO(address, 2);
+  registers_.file[kOffsetA] = bus_.Read(address);
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+}
+
+ldh_c_a: {
+  u16 address = 0xFF00 + registers_.file[kOperandOffsets[1]];
+  THREADED_SYNC_IO(address, 1);
+  write(address, registers_.file[kOffsetA]);
+  cycles += Opcode(opcode).cycles;
+  THREADED_CHECKPOINT();
+}
+
+ldh_a_c: {
+  u16 address = 0xFF00 + registers_.file[kOperandOffsets[1]];
+  THREADED_SYNC_IO(address, 1);
+  registers_.file[kOffsetA] = bus_.Read(address);
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+}
+
+ld_nn_a: {
+  u16 address = fetch_word();
+  THREADED_SYNC_IO(address, 3);
+  write(address, registers_.file[kOffsetA]);
+  cycles += Opcode(opcode).cycles;
+  THREADED_CHECKPOINT();
+}
+
+ld_a_nn: {
+  u16 address = fetch_word();
+  THREADED_SYNC_IO(address, 3);
+  registers_.file[kOffsetA] = bus_.Read(address);
+  cycles += Opcode(opcode).cycles;
+  THREADED_DISPATCH();
+}
+
+prefixed: {
+  u8 cb = fetch();
+  u8 operand = cb & 0x7;
+  u8 bit = (cb >> 3) & 0x7;
+  u16 hl = get_word(kOffsetHL);
+  if (operand == kOperandMemory) {
+    THREADED_SYNC_IO(hl, 2);
+  }
+  u8 value = operand == kOperandMemory ? bus_.Read(hl) : registers_.file[kOperandOffsets[operand]];
+  switch (cb >> 6) {
+    case 0: {
+      u16 entry = (*kShiftTables[bit])[(registers_.flags.carry() << 8) | value];
+      registers_.flags.FromByte(entry & 0xFF);
+      value = entry >> 8;
+      break;
+    }
+    case 1:
+      registers_.flags.zero((value & (1 << bit)) == 0);
+      registers_.flags.half_carry(true);
+      registers_.flags.subtract(false);
+      cycles += PrefixedOpcode(cb).cycles;
+      THREADED_DISPATCH();
+    case 2:
+      value &= ~(1 << bit);
+      break;
+    case 3:
+      value |= 1 << bit;
+      break;
+  }
+  if (operand == kOperandMemory) {
+    write(hl, value);
+    cycles += PrefixedOpcode(cb).cycles;
+    THREADED_CHECKPOINT();
+  }
+  registers_.file[kOperandOffsets[operand]] = value;
+  cycles += PrefixedOpcode(cb).cycles;
+  THREADED_DISPATCH();
+}
+
+generic: {
+  // everything else is decoded and executed like in Step
+  registers_.pc = registers_.pc - 1;
+  auto instruction = Fetch(instruction_buffer_, alu, registers_, bus_);
+  if (!instruction) {
+    std::cerr << "hit an invalid instruction" << std::endl;
+    abort();
+  }
+  cycles += instruction->Execute(*this, alu, registers_, bus_);
+  code_page = kNoPage;
+  if (halt_bug_) {
+    // a HALT hit the halt bug, the next StepThreaded leaves the doubled read to Step
+    count++;
+    goto exit;
+  }
+  THREADED_CHECKPOINT();
+}
+
+exit:
+  ic_ += count;
+  cycles_consumed_ = cycles;
+
+#undef THREADED_SYNC_IO
+#undef THREADED_CHECKPOINT
+#undef THREADED_DISPATCH
+}
+
+#endif
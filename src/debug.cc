@@ -1,20 +1,85 @@
 #include "debug.h"
-#include "instructions.h"
-#include <unordered_set>
+#include "debug_condition.h"
+#include "disassembler.h"
+#include <atomic>
+#include <bitset>
+#include <condition_variable>
+#include <map>
 
 #ifdef ENABLE_DEBUGGER
 
 namespace Debugger {
 
+// a bank switchable part of the address space, each one is disassembled on its own
+struct Region {
+  u16 start;
+  u16 end;
+};
+
+static constexpr std::array<Region, 8> kRegions = {{
+    {0x0000, 0x3FFF}, // ROM bank 0, the boot ROM covers its first page until it is unmapped
+    {0x4000, 0x7FFF}, // switchable ROM bank
+    {0x8000, 0x9FFF}, // VRAM
+    {0xA000, 0xBFFF}, // cartridge RAM
+    {0xC000, 0xCFFF}, // WRAM bank 0
+    {0xD000, 0xDFFF}, // switchable WRAM bank
+    {0xE000, 0xFDFF}, // echo RAM
+    {0xFE00, 0xFFFF}, // OAM, IO and HRAM
+}};
+
+// disassembly of a region with one set of banks mapped, length 0 where no instruction starts
+using RegionView = std::vector<Disassembler::Instruction>;
+
+// the storage behind each page of a region tells which banks are mapped there
+struct ViewKey {
+  size_t region;
+  std::vector<const u8*> pages;
+
+  auto operator<=>(const ViewKey&) const = default;
+};
+
 // todo sync
-static std::unordered_map<u16, std::string> disassemble_;
-static std::array<u16, 0x10000> memory_cache_; // todo utilize this to prevent disassembling instructions over and over again
-static std::unordered_set<u16> breakpoints_;
-static std::unordered_map<u16, u8> lengths_;
+// every view decoded so far, switching banks only changes which ones are visible
+static std::map<ViewKey, RegionView> memory_cache_;
+// views of regions that aren't plain memory, decoded again on every switch
+static std::array<RegionView, kRegions.size()> uncached_;
+static std::array<RegionView*, kRegions.size()> views_{};
+// pages written since the visible views last decoded them
+static std::bitset<0x100> dirty_pages_;
+static MemoryBus* bus_ = nullptr;
+static const Registers* registers_ = nullptr;
+static std::bitset<0x10000> breakpoints_;
+static std::bitset<0x10000> read_watchpoints_;
+static std::bitset<0x10000> write_watchpoints_;
+static u32 breakpoint_count_ = 0;
+
+struct BreakpointCondition {
+  Condition condition;
+  u32 hits;
+};
+
+// a watched range, the bitmaps above are built from these
+struct Watchpoint {
+  u16 first;
+  u16 last;
+  MemoryAccess access;
+  std::optional<Condition> condition;
+  u32 hits;
+};
+
+// only consulted once the bitmaps matched, most breakpoints don't have one
+static std::unordered_map<u16, BreakpointCondition> breakpoint_conditions_;
+static std::vector<Watchpoint> watchpoints_;
+// set while anything may stop before the next instruction, the hooks return right away otherwise
+static std::atomic<bool> armed_ = true;
+static std::atomic<bool> watching_ = false;
+// between the pre and post exec hooks, reads of the debugger and the UI don't hit watchpoints
+static thread_local bool executing_ = false;
 static u16 current_ = 0;
 static bool step_ = true;
 static u16 next_ = 0xFFFF;
 static bool lock_ = true;
+static std::condition_variable resume_;
 static std::vector<CallStackEntry> call_stack_;
 static u16 previous_write_address_ = 0;
 static u8 previous_write_value_ = 0;
@@ -22,121 +87,288 @@ static std::mutex mutex_;
 static std::mutex disassemble_mutex_;
 static bool instructions_changed_ = false;
 
+// the debugger's own reads of the bus must not hit watchpoints
+struct Inspecting {
+  bool executing = executing_;
+
+  Inspecting() { executing_ = false; }
+  ~Inspecting() { executing_ = executing; }
+};
+
+// call with mutex_ held whenever step_, next_ or the breakpoints change
+static void UpdateArmed() {
+  armed_ = step_ || next_ != 0xFFFF || breakpoint_count_ != 0;
+}
+
+static size_t RegionOf(u16 address) {
+  size_t region = 0;
+  while (address > kRegions[region].end) {
+    region++;
+  }
+  return region;
+}
+
+// instruction starting at the address in the visible view
+static Disassembler::Instruction InstructionAt(u16 address) {
+  size_t region = RegionOf(address);
+  if (!views_[region]) {
+    return {};
+  }
+  return (*views_[region])[address - kRegions[region].start];
+}
+
 void Reset() {
   std::scoped_lock lock2{disassemble_mutex_, mutex_};
   lock_ = false;
-  memory_cache_.fill(0);
-  disassemble_.clear();
-  lengths_.clear();
+  memory_cache_.clear();
+  views_.fill(nullptr);
+  dirty_pages_.reset();
+  bus_ = nullptr;
+  registers_ = nullptr;
   current_ = 0;
   step_ = true;
+  UpdateArmed();
   previous_write_address_ = 0;
   previous_write_value_ = 0;
   instructions_changed_ = true;
+  resume_.notify_all();
 }
 
-void DisassembleFromMemory(MemoryBus& bus) {
-  {
-    std::scoped_lock lock{disassemble_mutex_, mutex_};
-    disassemble_.clear();
-    lengths_.clear();
+static RegionView DisassembleRegion(MemoryBus& bus, const Region& region) {
+  // the bus is peeked into a copy first, the disassembler only sees plain bytes and
+  // coverage doesn't count the sweep as reads
+  static std::array<u8, 0x4000> memory;
+  static std::array<bool, 0x4000> readable;
+  u32 size = region.end - region.start + 1;
+  for (u32 offset = 0; offset < size; offset++) {
+    u16 address = region.start + offset;
+    readable[offset] = bus.CheckAccess(address, kMemoryAccessRead);
+    memory[offset] = readable[offset] ? bus.Peek(address) : 0;
+  }
+  RegionView view(size, Disassembler::Instruction{});
+  u32 offset = 0;
+  while (offset < size) {
+    if (!readable[offset]) {
+      offset++;
+      continue;
+    }
+    u16 address = region.start + offset;
+    Disassembler::Instruction instruction = Disassembler::Decode(std::span(memory).subspan(offset, size - offset), address);
+    if (instruction.length == 0) {
+      break;
+    }
+    if (instruction.valid()) {
+      view[offset] = instruction;
+    }
+    offset += instruction.length;
+  }
+  return view;
+}
+
+// decodes a written page of the visible view again, lock the disassembly before calling,
+// returns true if its last instruction reaches into the next page
+static bool RefreshPage(MemoryBus& bus, u8 page) {
+  u16 first = page << 8;
+  size_t index = RegionOf(first);
+  const Region& region = kRegions[index];
+  RegionView* view = views_[index];
+  if (!view) {
+    return false;
+  }
+  // an instruction of the previous page may reach into this one
+  u32 offset = first - region.start;
+  for (u32 back = 1; back <= 2 && back <= offset; back++) {
+    const Disassembler::Instruction& previous = (*view)[offset - back];
+    if (previous.length != 0) {
+      offset += std::max<u32>(previous.length, back) - back;
+      break;
+    }
+  }
+  // the page and the two bytes after it, the last instruction may reach past the page
+  std::array<u8, 0x102> memory{};
+  std::array<bool, 0x102> readable{};
+  u32 size = std::min<u32>(region.end - first + 1, memory.size());
+  for (u32 i = 0; i < size; i++) {
+    readable[i] = bus.CheckAccess(first + i, kMemoryAccessRead);
+    memory[i] = readable[i] ? bus.Peek(first + i) : 0;
+  }
+  u32 base = first - region.start;
+  u32 end = base + std::min<u32>(size, 0x100);
+  for (u32 i = base; i < offset; i++) {
+    (*view)[i] = {};
+  }
+  while (offset < end) {
+    u32 i = offset - base;
+    Disassembler::Instruction instruction{};
+    if (readable[i]) {
+      instruction = Disassembler::Decode(std::span(memory).subspan(i, size - i), region.start + offset);
+    }
+    u8 length = std::max<u8>(instruction.length, 1);
+    if (!instruction.valid()) {
+      instruction = {};
+    }
+    if ((*view)[offset] != instruction) {
+      (*view)[offset] = instruction;
+      instructions_changed_ = true;
+    }
+    for (u32 j = 1; j < length && offset + j < view->size(); j++) {
+      (*view)[offset + j] = {};
+    }
+    offset += length;
+  }
+  return offset > end && first + 0x100 <= region.end;
+}
+
+// brings the visible views up to date with the memory written since the last call
+static void RefreshDirtyPages(MemoryBus& bus) {
+  if (dirty_pages_.none()) {
+    return;
+  }
+  Inspecting inspecting;
+  bool panic = bus.panic_on_invalid_access();
+  bus.panic_on_invalid_access(false);
+  std::scoped_lock lock{disassemble_mutex_, mutex_};
+  bool spilled = false;
+  for (u32 page = 0; page < dirty_pages_.size(); page++) {
+    // the next page is decoded too when the instruction boundaries moved into it
+    spilled = (dirty_pages_[page] || spilled) && RefreshPage(bus, page);
   }
+  dirty_pages_.reset();
+  bus.panic_on_invalid_access(panic);
+}
+
+// points every region at the view of the banks mapped now, decoding only the ones never seen
+static void UpdateViews(MemoryBus& bus) {
+  // the pending writes belong to the views that are about to be switched out
+  RefreshDirtyPages(bus);
+  Inspecting inspecting;
   bool panic = bus.panic_on_invalid_access();
   bus.panic_on_invalid_access(false);
-  EventBus fake_event_bus{};
-  Registers registers{};
-  ALU alu{registers};
-  registers.pc = 0;
-  while (registers.pc < 0xFFFF) {
-    if (!bus.CheckAccess(registers.pc + 1, kMemoryAccessRead)) {
-      if (((u32)registers.pc + 1) > 0xFFFF) {
-        break;
+  std::scoped_lock lock{disassemble_mutex_, mutex_};
+  for (size_t i = 0; i < kRegions.size(); i++) {
+    const Region& region = kRegions[i];
+    ViewKey key{i, {}};
+    bool direct = true;
+    for (u32 page = region.start; page <= region.end && direct; page += 0x100) {
+      key.pages.push_back(bus.ReadPagePointer(page));
+      direct = key.pages.back() != nullptr;
+    }
+    RegionView* view;
+    if (direct) {
+      auto it = memory_cache_.find(key);
+      if (it == memory_cache_.end()) {
+        it = memory_cache_.emplace(std::move(key), DisassembleRegion(bus, region)).first;
       }
-      registers.pc = registers.pc + 1;
-      continue;
+      view = &it->second;
+    } else {
+      RegionView decoded = DisassembleRegion(bus, region);
+      if (views_[i] == &uncached_[i] && decoded == uncached_[i]) {
+        continue;
+      }
+      uncached_[i] = std::move(decoded);
+      view = &uncached_[i];
     }
-    u16 start = registers.pc;
-    Fetch(alu, registers, bus);
-    u16 end = registers.pc;
-    if (end < start) {
-      break; // overflow
+    if (views_[i] != view || view == &uncached_[i]) {
+      views_[i] = view;
+      instructions_changed_ = true;
     }
   }
   bus.panic_on_invalid_access(panic);
 }
-void Init(MemoryBus& bus) {
-  step_ = true;
+
+void Init(MemoryBus& bus, const Registers& registers) {
+  {
+    std::scoped_lock lock{mutex_};
+    step_ = true;
+    UpdateArmed();
+  }
   current_ = 0;
-  DisassembleFromMemory(bus);
+  bus_ = &bus;
+  registers_ = &registers;
+  UpdateViews(bus);
 }
 
-void OnEmitInstruction(MemoryBus& bus, u16 pc, u16 n, std::string name) {
-  std::vector<std::string> bytes;
-  u16 i = 0;
-  while (i < n) {
-    bytes.push_back(ToHex(bus.Read(pc + i), false));
-    i++;
-  }
-  while (bytes.size() < 4) {
-    bytes.emplace_back("  ");
+// evaluates a condition for the hook that matched, call with mutex_ held
+static bool Holds(const Condition& condition, u32 hits, u16 address, u8 value, u8 old) {
+  if (!bus_ || !registers_) {
+    return true;
   }
-  std::string out;
-  for (const auto& item : bytes) {
-    out += item;
-    out += " ";
-  }
-  out.pop_back();
-  out += " : ";
-  out += name;
-  std::scoped_lock lock{disassemble_mutex_, mutex_}; // we lock before doing any changes
-  if (disassemble_.contains(pc) && disassemble_[pc] == out) {
-    current_ = pc;
-    return;
-  }
-  instructions_changed_ = true;
-  disassemble_[pc] = out;
-  lengths_[pc] = n;
-  for (int j = 1; j < n; ++j) {
-    lengths_[pc + j] = 0;
+  Inspecting inspecting;
+  return condition.Evaluate({*registers_, *bus_, hits, address, value, old});
+}
+
+static bool BreakpointHolds(u16 pc) {
+  auto it = breakpoint_conditions_.find(pc);
+  if (it == breakpoint_conditions_.end()) {
+    return true;
   }
-  current_ = pc;
+  it->second.hits++;
+  return Holds(it->second.condition, it->second.hits, pc, 0, 0);
 }
 
-void OnPreExecInstruction() {
-  if (step_ || HasBreakpoint(current_) || next_ == current_) {
-    next_ = 0xFFFF;
-    PauseHere();
+void OnPreExecInstruction(u16 pc) {
+  current_ = pc;
+  if (armed_.load(std::memory_order_relaxed)) {
+    bool pause;
+    {
+      std::scoped_lock lock{mutex_};
+      pause = step_ || next_ == pc || (breakpoints_[pc] && BreakpointHolds(pc));
+      if (pause) {
+        next_ = 0xFFFF;
+      }
+    }
+    if (pause) {
+      PauseHere();
+    }
   }
+  executing_ = true;
 }
 
 void OnPostExecInstruction() {
+  executing_ = false;
+}
 
+// stops before the instruction after the one that touched a watched address,
+// if a watchpoint covering it has no condition or its condition holds
+static void HitWatchpoint(u16 address, MemoryAccess access, u8 value, u8 old) {
+  std::scoped_lock lock{mutex_};
+  bool hit = false;
+  for (Watchpoint& watchpoint : watchpoints_) {
+    if (address < watchpoint.first || address > watchpoint.last || !(watchpoint.access & access)) {
+      continue;
+    }
+    watchpoint.hits++;
+    if (!watchpoint.condition || Holds(*watchpoint.condition, watchpoint.hits, address, value, old)) {
+      hit = true;
+    }
+  }
+  if (hit) {
+    step_ = true;
+    UpdateArmed();
+  }
 }
 
 void OnMemWrite(MemoryBus& bus, u16 pos, u8 oldvalue, u8 value, u8 newvalue) {
+  if (watching_.load(std::memory_order_relaxed) && executing_ && write_watchpoints_[pos]) {
+    HitWatchpoint(pos, kMemoryAccessWrite, newvalue, oldvalue);
+  }
   if (oldvalue == newvalue) {
     return;
   }
   previous_write_address_ = pos;
   previous_write_value_ = oldvalue;
-  u16 current_old = current_;
-  bool panic = bus.panic_on_invalid_access();
-  bus.panic_on_invalid_access(false);
-  EventBus fake_event_bus{};
-  Registers registers{};
-  registers.pc = pos;
-  ALU alu{registers};
-  if (!bus.CheckAccess(registers.pc, kMemoryAccessRead)) {
-    bus.panic_on_invalid_access(panic);
-    return;
-  }
-  Fetch(alu, registers, bus);
-  bus.panic_on_invalid_access(panic);
-  current_ = current_old;
+  // decoded again at the end of the frame or when execution pauses
+  dirty_pages_.set(pos >> 8);
 }
 
-void OnMemRead(MemoryBus& bus, u16 pos, u8 value) {
+void OnFrame(MemoryBus& bus) {
+  RefreshDirtyPages(bus);
+}
 
+void OnMemRead(MemoryBus& bus, u16 pos, u8 value) {
+  if (watching_.load(std::memory_order_relaxed) && executing_ && read_watchpoints_[pos]) {
+    HitWatchpoint(pos, kMemoryAccessRead, value, value);
+  }
 }
 
 void OnCall(u16 pc, u16 sp, u16 value, bool is_interrupt) {
@@ -150,7 +382,9 @@ void OnCall(u16 pc, u16 sp, u16 value, bool is_interrupt) {
 }
 
 void OnReturn(u16 pc, u16 sp, u16 value, bool from_interrupt) {
-  call_stack_.pop_back();
+  if (!call_stack_.empty()) {
+    call_stack_.pop_back();
+  }
   //std::cout << "return: " << ToHex(value) << ", current address: " << ToHex(current_) << ", sp: " << ToHex(sp) << ", int: " << BoolToStr(from_interrupt) << std::endl;
 }
 
@@ -163,24 +397,31 @@ void OnJumpRelative(u16 pc, u16 sp, u16 value) {
 }
 
 void OnBankChange(MemoryBus& bus) {
-  u16 current_temp = current_;
-  DisassembleFromMemory(bus);
-  current_ = current_temp;
+  UpdateViews(bus);
 }
 
 void OnRomUnmap(MemoryBus& bus) {
-  u16 current_temp = current_;
-  DisassembleFromMemory(bus);
-  current_ = current_temp;
+  UpdateViews(bus);
 }
 
-const std::string& GetInstructionAt(u16 address) {
-  std::scoped_lock lock{disassemble_mutex_};
-  static std::string blank = "";
-  if (disassemble_.contains(address)) {
-    return disassemble_[address];
+std::string GetInstructionAt(u16 address) {
+  Disassembler::Instruction instruction;
+  {
+    std::scoped_lock lock{disassemble_mutex_};
+    instruction = InstructionAt(address);
+  }
+  if (instruction.length == 0) {
+    return "";
+  }
+  std::string out;
+  for (u8 i = 0; i < 4; i++) {
+    out += i < instruction.length ? ToHex(instruction.bytes[i], false) : "  ";
+    out += " ";
   }
-  return blank;
+  out.pop_back();
+  out += " : ";
+  Disassembler::Format(instruction, out);
+  return out;
 }
 
 u16 GetCurrentInstruction() {
@@ -189,26 +430,97 @@ u16 GetCurrentInstruction() {
 
 u8 GetInstructionLengthAt(u16 address) {
   std::scoped_lock lock{disassemble_mutex_};
-  u8 len = 0;
-  if (lengths_.contains(address)) {
-    len = lengths_[address];
-  }
-  return len;
+  return InstructionAt(address).length;
 }
 
 bool HasBreakpoint(u16 address) {
-  return breakpoints_.find(address) != breakpoints_.end();
+  return breakpoints_[address];
 }
 
 void SetBreakpoint(u16 address, bool enabled) {
-  if (enabled) {
-    breakpoints_.insert(address);
+  std::scoped_lock lock{mutex_};
+  if (breakpoints_[address] == enabled) {
+    return;
+  }
+  breakpoints_[address] = enabled;
+  breakpoint_count_ = enabled ? breakpoint_count_ + 1 : breakpoint_count_ - 1;
+  UpdateArmed();
+}
+
+bool HasWatchpoint(u16 address, MemoryAccess access) {
+  return ((access & kMemoryAccessRead) && read_watchpoints_[address]) ||
+         ((access & kMemoryAccessWrite) && write_watchpoints_[address]);
+}
+
+bool SetBreakpointCondition(u16 address, const std::string& condition, std::string* error) {
+  std::optional<Condition> parsed;
+  if (!condition.empty() && !(parsed = Condition::Parse(condition, error))) {
+    return false;
+  }
+  std::scoped_lock lock{mutex_};
+  if (parsed) {
+    breakpoint_conditions_.insert_or_assign(address, BreakpointCondition{std::move(*parsed), 0});
   } else {
-    breakpoints_.erase(address);
+    breakpoint_conditions_.erase(address);
+  }
+  return true;
+}
+
+std::string GetBreakpointCondition(u16 address) {
+  std::scoped_lock lock{mutex_};
+  auto it = breakpoint_conditions_.find(address);
+  return it == breakpoint_conditions_.end() ? "" : it->second.condition.text();
+}
+
+// call with mutex_ held after watchpoints_ changed
+static void RebuildWatchpoints() {
+  read_watchpoints_.reset();
+  write_watchpoints_.reset();
+  for (const Watchpoint& watchpoint : watchpoints_) {
+    for (u32 address = watchpoint.first; address <= watchpoint.last; address++) {
+      read_watchpoints_[address] = read_watchpoints_[address] || (watchpoint.access & kMemoryAccessRead);
+      write_watchpoints_[address] = write_watchpoints_[address] || (watchpoint.access & kMemoryAccessWrite);
+    }
   }
+  watching_ = !watchpoints_.empty();
+}
+
+void SetWatchpoint(u16 address, MemoryAccess access, bool enabled) {
+  if (enabled) {
+    AddWatchpoint(address, address, access, "");
+    return;
+  }
+  std::scoped_lock lock{mutex_};
+  for (Watchpoint& watchpoint : watchpoints_) {
+    if (watchpoint.first == address && watchpoint.last == address) {
+      watchpoint.access = watchpoint.access & static_cast<MemoryAccess>(~access);
+    }
+  }
+  std::erase_if(watchpoints_, [](const Watchpoint& watchpoint) { return watchpoint.access == kMemoryAccessNone; });
+  RebuildWatchpoints();
+}
+
+bool AddWatchpoint(u16 first, u16 last, MemoryAccess access, const std::string& condition, std::string* error) {
+  std::optional<Condition> parsed;
+  if (!condition.empty() && !(parsed = Condition::Parse(condition, error))) {
+    return false;
+  }
+  std::scoped_lock lock{mutex_};
+  watchpoints_.push_back({first, last, access, std::move(parsed), 0});
+  RebuildWatchpoints();
+  return true;
+}
+
+void RemoveWatchpoints(u16 first, u16 last) {
+  std::scoped_lock lock{mutex_};
+  std::erase_if(watchpoints_, [&](const Watchpoint& watchpoint) {
+    return watchpoint.first >= first && watchpoint.last <= last;
+  });
+  RebuildWatchpoints();
 }
 
 bool IsFrozen() {
+  std::scoped_lock lock{mutex_};
   return lock_;
 }
 
@@ -216,12 +528,16 @@ void Step() {
   std::scoped_lock lock{mutex_};
   lock_ = false;
   step_ = true;
+  UpdateArmed();
+  resume_.notify_all();
 }
 
 void Next() {
   std::scoped_lock lock{mutex_};
   lock_ = false;
-  next_ = current_ + lengths_[current_];
+  next_ = current_ + InstructionAt(current_).length;
+  UpdateArmed();
+  resume_.notify_all();
 }
 
 void Out() {
@@ -231,25 +547,32 @@ void Out() {
     auto& data = call_stack_[call_stack_.size() - 1];
     next_ = data.return_address_;
   }
+  UpdateArmed();
+  resume_.notify_all();
 }
 
 void Pause() {
   std::scoped_lock lock{mutex_};
   step_ = true;
+  UpdateArmed();
 }
 
 void PauseHere() {
-  {
-    std::scoped_lock lock{mutex_};
-    lock_ = true;
-    step_ = false;
+  if (bus_) {
+    RefreshDirtyPages(*bus_);
   }
-  while (lock_) { }
+  std::unique_lock lock{mutex_};
+  lock_ = true;
+  step_ = false;
+  UpdateArmed();
+  // the UI thread wakes us up from Step, Next, Out, Continue or Reset
+  resume_.wait(lock, [] { return !lock_; });
 }
 
 void Continue() {
   std::scoped_lock lock{mutex_};
   lock_ = false;
+  resume_.notify_all();
 }
 
 
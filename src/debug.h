@@ -1,6 +1,7 @@
 #pragma once
 
 #include "memory.h"
+#include "register.h"
 
 #ifdef DEBUG
 #define ENABLE_DEBUGGER
@@ -17,11 +18,9 @@ struct CallStackEntry {
 };
 
 void Reset();
-void Init(MemoryBus& bus);
+void Init(MemoryBus& bus, const Registers& registers);
 
-void OnEmitInstruction(MemoryBus& bus, u16 pc, u16 n, std::string name);
-
-void OnPreExecInstruction();
+void OnPreExecInstruction(u16 pc);
 void OnPostExecInstruction();
 void OnMemWrite(MemoryBus& bus, u16 pos, u8 oldvalue, u8 value, u8 newvalue);
 void OnMemRead(MemoryBus& bus, u16 pos, u8 value);
@@ -31,8 +30,10 @@ void OnReturn(u16 pc, u16 sp, u16 value, bool from_interrupt);
 void OnJump(u16 pc, u16 sp, u16 value);
 void OnJumpRelative(u16 pc, u16 sp, u16 value);
 void OnBankChange(MemoryBus& bus);
+void OnFrame(MemoryBus& bus);
 
-const std::string& GetInstructionAt(u16 address);
+// instruction bytes and mnemonic, empty if no instruction starts at the address
+std::string GetInstructionAt(u16 address);
 
 u16 GetCurrentInstruction();
 u8 GetInstructionLengthAt(u16 address);
@@ -41,6 +42,21 @@ bool HasBreakpoint(u16 address);
 
 void SetBreakpoint(u16 address, bool enabled);
 
+// the breakpoint at the address only stops when the condition holds, see debug_condition.h,
+// an empty condition always stops. Returns false and keeps the old one if it doesn't parse
+bool SetBreakpointCondition(u16 address, const std::string& condition, std::string* error = nullptr);
+std::string GetBreakpointCondition(u16 address);
+
+// access is kMemoryAccessRead, kMemoryAccessWrite or both, execution stops after the
+// instruction that reads or writes the address
+bool HasWatchpoint(u16 address, MemoryAccess access);
+void SetWatchpoint(u16 address, MemoryAccess access, bool enabled);
+
+// watches first..last, stops only when the condition holds unless it is empty
+bool AddWatchpoint(u16 first, u16 last, MemoryAccess access, const std::string& condition, std::string* error = nullptr);
+// removes the watchpoints inside first..last
+void RemoveWatchpoints(u16 first, u16 last);
+
 bool IsFrozen();
 void Step();
 void Next();
@@ -61,10 +77,9 @@ const std::vector<CallStackEntry>& GetCallStack();
 
 
 #ifdef ENABLE_DEBUGGER
-#define INIT_DEBUGGER(memory) Debugger::Init(memory)
+#define INIT_DEBUGGER(memory, registers) Debugger::Init(memory, registers)
 #define RESET_DEBUGGER(memory) Debugger::Reset()
-#define EMIT_INSTRUCTION(begin_pc, name, args...) Debugger::OnEmitInstruction(bus, begin_pc, registers.pc - begin_pc, fmt::format(name, ##args))
-#define EMIT_PRE_EXEC_INSTRUCTION() Debugger::OnPreExecInstruction()
+#define EMIT_PRE_EXEC_INSTRUCTION(pc) Debugger::OnPreExecInstruction(pc)
 #define EMIT_POST_EXEC_INSTRUCTION() Debugger::OnPostExecInstruction()
 #define EMIT_MEM_WRITE(pos, oldvalue, value, newvalue) Debugger::OnMemWrite(*this, pos, oldvalue, value, newvalue)
 #define EMIT_MEM_READ(pos, value) Debugger::OnMemRead(*this, pos, value)
@@ -76,11 +91,11 @@ const std::vector<CallStackEntry>& GetCallStack();
 #define DEBUGGER_PAUSE() Debugger::Pause()
 #define DEBUGGER_PAUSE_HERE() Debugger::PauseHere()
 #define EMIT_BANK_CHANGE(bus) Debugger::OnBankChange(bus)
+#define EMIT_FRAME(bus) Debugger::OnFrame(bus)
 #else
-#define INIT_DEBUGGER(memory)
+#define INIT_DEBUGGER(memory, registers)
 #define RESET_DEBUGGER()
-#define EMIT_INSTRUCTION(begin_pc, name, args...)
-#define EMIT_PRE_EXEC_INSTRUCTION()
+#define EMIT_PRE_EXEC_INSTRUCTION(pc)
 #define EMIT_POST_EXEC_INSTRUCTION()
 #define EMIT_MEM_WRITE(pos, oldvalue, value, newvalue)
 #define EMIT_MEM_READ(pos, value)
@@ -92,4 +107,5 @@ const std::vector<CallStackEntry>& GetCallStack();
 #define DEBUGGER_PAUSE()
 #define DEBUGGER_PAUSE_HERE()
 #define EMIT_BANK_CHANGE(bus)
+#define EMIT_FRAME(bus)
 #endif
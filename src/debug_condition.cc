@@ -0,0 +1,346 @@
+#include "debug_condition.h"
+#include "debug.h"
+
+#ifdef ENABLE_DEBUGGER
+
+namespace Debugger {
+
+enum ConditionRegister : u32 { kA, kF, kB, kC, kD, kE, kH, kL, kAF, kBC, kDE, kHL, kSP, kPC };
+enum ConditionVariable : u32 { kHits, kAddress, kValue, kOld };
+
+struct ConditionName {
+  std::string_view name;
+  bool is_register;
+  u32 index;
+};
+
+static constexpr ConditionName kNames[] = {
+    {"a", true, kA}, {"f", true, kF}, {"b", true, kB}, {"c", true, kC}, {"d", true, kD},
+    {"e", true, kE}, {"h", true, kH}, {"l", true, kL}, {"af", true, kAF}, {"bc", true, kBC},
+    {"de", true, kDE}, {"hl", true, kHL}, {"sp", true, kSP}, {"pc", true, kPC},
+    {"hits", false, kHits}, {"address", false, kAddress}, {"value", false, kValue}, {"old", false, kOld},
+};
+
+// recursive descent over the C precedence levels, emits the bytecode as it goes
+class ConditionParser {
+ public:
+  using Op = Condition::Op;
+
+  ConditionParser(std::string_view text, Condition& condition) : text_(text), code_(condition.code_) {}
+
+  bool Parse() {
+    Skip();
+    if (!Expression(0)) {
+      return false;
+    }
+    if (position_ != text_.size()) {
+      return Fail("unexpected '" + std::string(1, text_[position_]) + "'");
+    }
+    if (max_depth_ > Condition::kMaxStack) {
+      return Fail("condition is too long");
+    }
+    return true;
+  }
+
+  const std::string& error() const { return error_; }
+
+ private:
+  struct Binary {
+    std::string_view token;
+    int level;
+    Op op;
+  };
+
+  // longer tokens first so "<=" isn't read as "<"
+  static constexpr Binary kBinary[] = {
+      {"||", 0, Op::Or}, {"&&", 1, Op::And}, {"==", 5, Op::Equal}, {"!=", 5, Op::NotEqual},
+      {"<=", 6, Op::LessEqual}, {">=", 6, Op::GreaterEqual}, {"<<", 7, Op::ShiftLeft},
+      {">>", 7, Op::ShiftRight}, {"|", 2, Op::Or}, {"^", 3, Op::Xor}, {"&", 4, Op::And},
+      {"<", 6, Op::Less}, {">", 6, Op::Greater}, {"+", 8, Op::Add}, {"-", 8, Op::Subtract},
+      {"*", 9, Op::Multiply}, {"/", 9, Op::Divide}, {"%", 9, Op::Modulo},
+  };
+
+  bool Fail(std::string message) {
+    if (error_.empty()) {
+      error_ = std::move(message) + " at column " + std::to_string(position_ + 1);
+    }
+    return false;
+  }
+
+  void Skip() {
+    while (position_ < text_.size() && std::isspace((unsigned char)text_[position_])) {
+      position_++;
+    }
+  }
+
+  bool Accept(std::string_view token) {
+    if (text_.substr(position_, token.size()) != token) {
+      return false;
+    }
+    position_ += token.size();
+    Skip();
+    return true;
+  }
+
+  void Emit(Op op, u32 operand = 0) {
+    code_.push_back({op, operand});
+    switch (op) {
+      case Op::Push:
+      case Op::Register:
+      case Op::Variable:
+        depth_++;
+        max_depth_ = std::max(max_depth_, depth_);
+        break;
+      case Op::Load:
+      case Op::Not:
+      case Op::Complement:
+      case Op::Negate:
+      case Op::Bool:
+        break;
+      default:
+        depth_--; // binary operators, and the jumps when they fall through
+        break;
+    }
+  }
+
+  // precedence climbing, the binary operators at level or above
+  bool Expression(int level) {
+    if (!Unary()) {
+      return false;
+    }
+    while (position_ < text_.size()) {
+      const Binary* binary = nullptr;
+      for (const Binary& candidate : kBinary) {
+        if (text_.substr(position_, candidate.token.size()) == candidate.token) {
+          binary = &candidate;
+          break;
+        }
+      }
+      if (!binary || binary->level < level) {
+        return true; // the caller's operator, or not an operator at all
+      }
+      Accept(binary->token);
+      if (binary->level <= 1) {
+        // && and || short circuit, the right side isn't evaluated when the left one decides
+        Emit(Op::Bool);
+        size_t jump = code_.size();
+        Emit(binary->level == 0 ? Op::JumpIfTrue : Op::JumpIfFalse);
+        if (!Expression(binary->level + 1)) {
+          return false;
+        }
+        Emit(Op::Bool);
+        code_[jump].operand = code_.size();
+      } else {
+        if (!Expression(binary->level + 1)) {
+          return false;
+        }
+        Emit(binary->op);
+      }
+    }
+    return true;
+  }
+
+  bool Unary() {
+    for (auto [token, op] : {std::pair{"!", Op::Not}, std::pair{"~", Op::Complement}, std::pair{"-", Op::Negate}}) {
+      // "!=" is never at the start of an operand
+      if (Accept(token)) {
+        if (!Unary()) {
+          return false;
+        }
+        Emit(op);
+        return true;
+      }
+    }
+    return Primary();
+  }
+
+  bool Primary() {
+    if (position_ >= text_.size()) {
+      return Fail("expected an operand");
+    }
+    if (Accept("(")) {
+      if (!Expression(0)) {
+        return false;
+      }
+      return Accept(")") || Fail("expected ')'");
+    }
+    if (Accept("[")) {
+      if (!Expression(0)) {
+        return false;
+      }
+      Emit(Op::Load);
+      return Accept("]") || Fail("expected ']'");
+    }
+    char c = text_[position_];
+    if (std::isdigit((unsigned char)c) || c == '$') {
+      return Number();
+    }
+    if (std::isalpha((unsigned char)c)) {
+      size_t start = position_;
+      while (position_ < text_.size() && std::isalnum((unsigned char)text_[position_])) {
+        position_++;
+      }
+      std::string name(text_.substr(start, position_ - start));
+      for (char& n : name) {
+        n = std::tolower((unsigned char)n);
+      }
+      for (const ConditionName& known : kNames) {
+        if (known.name == name) {
+          Emit(known.is_register ? Op::Register : Op::Variable, known.index);
+          Skip();
+          return true;
+        }
+      }
+      position_ = start;
+      return Fail("unknown name '" + name + "'");
+    }
+    return Fail("expected an operand");
+  }
+
+  bool Number() {
+    int base = 10;
+    if (Accept("$")) {
+      base = 16;
+    } else if (text_.substr(position_, 2) == "0x" || text_.substr(position_, 2) == "0X") {
+      position_ += 2;
+      base = 16;
+    } else if (text_.substr(position_, 2) == "0b" || text_.substr(position_, 2) == "0B") {
+      position_ += 2;
+      base = 2;
+    }
+    u64 value = 0;
+    size_t digits = 0;
+    while (position_ < text_.size()) {
+      char c = std::tolower((unsigned char)text_[position_]);
+      int digit = std::isdigit((unsigned char)c) ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : 99;
+      if (digit >= base) {
+        break;
+      }
+      value = value * base + digit;
+      if (value > 0xFFFFFFFF) {
+        return Fail("number is too large");
+      }
+      position_++;
+      digits++;
+    }
+    if (digits == 0) {
+      return Fail("expected digits");
+    }
+    Emit(Op::Push, value);
+    Skip();
+    return true;
+  }
+
+  std::string_view text_;
+  std::vector<Condition::Instruction>& code_;
+  size_t position_ = 0;
+  size_t depth_ = 0;
+  size_t max_depth_ = 0;
+  std::string error_;
+};
+
+std::optional<Condition> Condition::Parse(std::string_view text, std::string* error) {
+  Condition condition;
+  condition.text_ = text;
+  ConditionParser parser(text, condition);
+  if (!parser.Parse()) {
+    if (error) {
+      *error = parser.error();
+    }
+    return std::nullopt;
+  }
+  return condition;
+}
+
+static s64 ReadRegister(const Registers& registers, u32 index) {
+  switch (index) {
+    case kA: return registers.Get<ArithmeticTarget::A>();
+    case kF: return registers.flags.ToByte();
+    case kB: return registers.Get<ArithmeticTarget::B>();
+    case kC: return registers.Get<ArithmeticTarget::C>();
+    case kD: return registers.Get<ArithmeticTarget::D>();
+    case kE: return registers.Get<ArithmeticTarget::E>();
+    case kH: return registers.Get<ArithmeticTarget::H>();
+    case kL: return registers.Get<ArithmeticTarget::L>();
+    case kAF: return (registers.Get<ArithmeticTarget::A>() << 8) | registers.flags.ToByte();
+    case kBC: return registers.Get<ArithmeticTarget::BC>();
+    case kDE: return registers.Get<ArithmeticTarget::DE>();
+    case kHL: return registers.Get<ArithmeticTarget::HL>();
+    case kSP: return registers.sp();
+    case kPC: return registers.pc;
+  }
+  return 0;
+}
+
+bool Condition::Evaluate(const ConditionContext& context) const {
+  std::array<s64, kMaxStack> stack;
+  size_t top = 0; // number of values on the stack
+  size_t pc = 0;
+  while (pc < code_.size()) {
+    const Instruction& instruction = code_[pc++];
+    switch (instruction.op) {
+      case Op::Push:
+        stack[top++] = instruction.operand;
+        continue;
+      case Op::Register:
+        stack[top++] = ReadRegister(context.registers, instruction.operand);
+        continue;
+      case Op::Variable:
+        switch (instruction.operand) {
+          case kHits: stack[top++] = context.hits; break;
+          case kAddress: stack[top++] = context.address; break;
+          case kValue: stack[top++] = context.value; break;
+          default: stack[top++] = context.old; break;
+        }
+        continue;
+      default:
+        break;
+    }
+    s64& a = stack[top - 1];
+    switch (instruction.op) {
+      case Op::Load: a = context.bus.Peek((u16)a); continue;
+      case Op::Not: a = !a; continue;
+      case Op::Complement: a = ~a; continue;
+      case Op::Negate: a = -a; continue;
+      case Op::Bool: a = a != 0; continue;
+      case Op::JumpIfFalse:
+      case Op::JumpIfTrue:
+        if ((a != 0) == (instruction.op == Op::JumpIfTrue)) {
+          pc = instruction.operand;
+        } else {
+          top--;
+        }
+        continue;
+      default:
+        break;
+    }
+    // binary operators, the result replaces the left operand
+    s64 b = a;
+    top--;
+    s64& left = stack[top - 1];
+    switch (instruction.op) {
+      case Op::Multiply: left *= b; break;
+      case Op::Divide: left = b == 0 ? 0 : left / b; break;
+      case Op::Modulo: left = b == 0 ? 0 : left % b; break;
+      case Op::Add: left += b; break;
+      case Op::Subtract: left -= b; break;
+      case Op::ShiftLeft: left = b >= 0 && b < 63 ? left << b : 0; break;
+      case Op::ShiftRight: left = b >= 0 && b < 63 ? left >> b : 0; break;
+      case Op::Less: left = left < b; break;
+      case Op::LessEqual: left = left <= b; break;
+      case Op::Greater: left = left > b; break;
+      case Op::GreaterEqual: left = left >= b; break;
+      case Op::Equal: left = left == b; break;
+      case Op::NotEqual: left = left != b; break;
+      case Op::And: left &= b; break;
+      case Op::Xor: left ^= b; break;
+      case Op::Or: left |= b; break;
+      default: break;
+    }
+  }
+  return top != 0 && stack[top - 1] != 0;
+}
+
+}
+
+#endif
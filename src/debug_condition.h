@@ -0,0 +1,84 @@
+#pragma once
+
+#include "memory.h"
+#include "register.h"
+#include <optional>
+#include <string_view>
+
+// Conditions of breakpoints and watchpoints, e.g. "A == 0x3C && [HL] > 5",
+// "hits >= 100" or "(old ^ value) & 0x80".
+//
+// The text is parsed once into a small stack bytecode, the debugger only runs it
+// when the breakpoint or watchpoint bitmaps say the address is armed.
+//
+// Operands are the registers (A F B C D E H L AF BC DE HL SP PC), numbers (42, 0x2A,
+// $2A, 0b101010), [address] for a byte of memory and the variables hits (times the
+// address was reached, this one included), address, value and old (the byte read or
+// written and the byte it replaced). Operators and their precedence follow C.
+
+namespace Debugger {
+
+struct ConditionContext {
+  const Registers& registers;
+  MemoryBus& bus;
+  u32 hits;
+  u16 address;
+  u8 value;
+  u8 old;
+};
+
+class Condition {
+ public:
+  // nullopt if the text isn't a valid condition, error says why
+  static std::optional<Condition> Parse(std::string_view text, std::string* error = nullptr);
+
+  bool Evaluate(const ConditionContext& context) const;
+
+  const std::string& text() const { return text_; }
+
+ private:
+  enum class Op : u8 {
+    Push,
+    Register,
+    Variable,
+    Load,
+    Not,
+    Complement,
+    Negate,
+    Bool,
+    Multiply,
+    Divide,
+    Modulo,
+    Add,
+    Subtract,
+    ShiftLeft,
+    ShiftRight,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+    Equal,
+    NotEqual,
+    And,
+    Xor,
+    Or,
+    // jump to operand if the top is false (true), keep it then and pop it otherwise
+    JumpIfFalse,
+    JumpIfTrue,
+  };
+
+  struct Instruction {
+    Op op;
+    u32 operand;
+  };
+
+  // deepest the evaluation stack gets, longer conditions are rejected
+  static constexpr size_t kMaxStack = 32;
+
+  friend class ConditionParser;
+
+  std::string text_;
+  std::vector<Instruction> code_;
+};
+
+}
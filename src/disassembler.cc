@@ -0,0 +1,104 @@
+#include "disassembler.h"
+#include <algorithm>
+
+namespace Disassembler {
+
+static constexpr u32 kBankSize = 0x4000;
+
+Instruction Decode(std::span<const u8> code, u16 address) {
+  Instruction instruction{address, 0, {0, 0, 0}, 0};
+  if (code.empty()) {
+    return instruction;
+  }
+  instruction.opcode = code[0];
+  if (code[0] == 0xCB && code.size() > 1) {
+    instruction.opcode = 0x100 | code[1];
+  }
+  u8 length = instruction.info().length;
+  if (length > code.size()) {
+    return instruction;
+  }
+  for (u8 i = 0; i < length; i++) {
+    instruction.bytes[i] = code[i];
+  }
+  instruction.length = length;
+  return instruction;
+}
+
+void Disassemble(std::span<const u8> code, u16 address, std::vector<Instruction>& out) {
+  size_t offset = 0;
+  while (offset < code.size()) {
+    Instruction instruction = Decode(code.subspan(offset), address + offset);
+    if (instruction.length == 0) {
+      break;
+    }
+    out.push_back(instruction);
+    offset += instruction.length;
+  }
+}
+
+void DisassembleRom(std::span<const u8> rom, std::vector<Instruction>& out) {
+  out.reserve(out.size() + rom.size() / 2);
+  for (size_t bank = 0; bank * kBankSize < rom.size(); bank++) {
+    size_t size = std::min<size_t>(kBankSize, rom.size() - bank * kBankSize);
+    Disassemble(rom.subspan(bank * kBankSize, size), bank == 0 ? 0x0000 : 0x4000, out);
+  }
+}
+
+// same text as ToHex, without the stream
+static void AppendHex(std::string& out, u32 value, int digits) {
+  static constexpr char kDigits[] = "0123456789ABCDEF";
+  out += "0x";
+  for (int shift = (digits - 1) * 4; shift >= 0; shift -= 4) {
+    out += kDigits[(value >> shift) & 0xF];
+  }
+}
+
+static void AppendOperand(std::string& out, const Instruction& instruction) {
+  u8 n8 = instruction.bytes[1];
+  switch (instruction.info().operand) {
+    case OperandKind::None:
+      break;
+    case OperandKind::Imm8:
+    case OperandKind::HighPage:
+      AppendHex(out, n8, 2);
+      break;
+    case OperandKind::Imm16:
+      AppendHex(out, n8 | (instruction.bytes[2] << 8), 4);
+      break;
+    case OperandKind::Relative:
+    case OperandKind::Signed: {
+      int value = AsSigned(n8);
+      if (value < 0) {
+        out += '-';
+        value = -value;
+      }
+      AppendHex(out, value, 2);
+      break;
+    }
+  }
+}
+
+void Format(const Instruction& instruction, std::string& out) {
+  const char* format = instruction.info().format;
+  if (!format) {
+    out += "INVALID INSTRUCTION";
+    return;
+  }
+  for (const char* c = format; *c; c++) {
+    if (c[0] == '{' && c[1] == '}') {
+      AppendOperand(out, instruction);
+      c++;
+    } else {
+      out += *c;
+    }
+  }
+}
+
+std::string Format(const Instruction& instruction) {
+  std::string out;
+  Format(instruction, out);
+  return out;
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "opcodes.h"
+#include <span>
+#include <string>
+#include <vector>
+
+// Table driven disassembler, independent of the CPU and the memory bus.
+//
+// Decoding only looks up kOpcodes and copies the instruction bytes into a small
+// struct, the text is built when something asks for it.
+
+namespace Disassembler {
+
+struct Instruction {
+  u16 address;
+  u16 opcode; // index into kOpcodes, $CB opcodes follow the unprefixed ones
+  std::array<u8, 3> bytes;
+  u8 length; // 0 if the code ended inside the instruction
+
+  const OpcodeInfo& info() const { return kOpcodes[opcode]; }
+  bool valid() const { return length != 0 && info().valid(); }
+
+  // the operand as info().operand describes it, the immediate, the $FF00 page address
+  // or where a relative jump lands, 0 if the opcode has none
+  u16 operand() const {
+    switch (info().operand) {
+      case OperandKind::None: return 0;
+      case OperandKind::Imm8: return bytes[1];
+      case OperandKind::Imm16: return bytes[1] | (bytes[2] << 8);
+      case OperandKind::HighPage: return 0xFF00 + bytes[1];
+      case OperandKind::Relative: return address + length + AsSigned(bytes[1]);
+      case OperandKind::Signed: return (u16) AsSigned(bytes[1]);
+    }
+    return 0;
+  }
+
+  bool operator==(const Instruction&) const = default;
+};
+
+// decodes the instruction at the start of code, which is mapped at address
+Instruction Decode(std::span<const u8> code, u16 address);
+
+// decodes code from its start to its end, appends one entry per complete instruction
+void Disassemble(std::span<const u8> code, u16 address, std::vector<Instruction>& out);
+
+// a whole cartridge image, bank 0 is mapped at $0000 and the others at $4000
+void DisassembleRom(std::span<const u8> rom, std::vector<Instruction>& out);
+
+// appends the mnemonic with its operand, e.g. "LD BC, 0x1234"
+void Format(const Instruction& instruction, std::string& out);
+std::string Format(const Instruction& instruction);
+
+}
@@ -1,5 +1,6 @@
 #include "emulator.h"
 #include "debug.h"
+#include <filesystem>
 #include <unordered_set>
 #include "tinyfiledialogs.h"
 
@@ -27,6 +28,10 @@ void Emulator::Start() {
   output_wrapper_ = std::make_unique<TextureWrapper>(*output_);
   vram_output_ = renderer_->CreateTexture(32 * 8, 24 * 8);
   vram_output_wrapper_ = std::make_unique<TextureWrapper>(*vram_output_);
+#if defined(ENABLE_DEBUGGER) && defined(ENABLE_COVERAGE)
+  coverage_output_ = renderer_->CreateTexture(kCoverageWidth, CARTRIDGE_ROM_SIZE / kCoverageWidth);
+  coverage_output_wrapper_ = std::make_unique<TextureWrapper>(*coverage_output_);
+#endif
   Run();
 }
 
@@ -39,77 +44,235 @@ bool Emulator::LoadCartridge(const std::string& file_path) {
     emulator_thread_->join();
   }
   emulator_thread_ = nullptr;
-  ppu_ = nullptr;
-  cpu_ = nullptr;
-  bus_ = nullptr;
+  STOP_TRACE();
+  STOP_PROFILER();
+  STOP_COVERAGE();
+#ifndef STEP_EVERY_INSTRUCTION
+  recompiled_ = nullptr;
+#endif
 
   cartridge_path_ = file_path;
   std::unique_ptr<Cartridge> cartridge = std::make_unique<Cartridge>(file_path);
   if (!cartridge->is_valid()) {
     std::cout << "cartridge is not valid, shutting down!" << std::endl;
+    ppu_ = nullptr;
+    cpu_ = nullptr;
+    bus_ = nullptr;
     return false;
   }
   next_cpu_cycle_ = clock::now();
+  sync_point_ = next_cpu_cycle_;
+  ticks_since_sync_ = scheduler_ticks{0};
 
-  bus_ = std::make_unique<MemoryBus>();
-  cpu_ = std::make_unique<CPU>(*event_bus_, *bus_);
+  // the machine is built once, later loads swap the cartridge in it
+  if (!bus_) {
+    bus_ = std::make_unique<MemoryBus>();
+    cpu_ = bus_->arena().New<CPU>(*event_bus_, *bus_);
 
-  // first load the rom, this will have priority over the cartridge memory
-  cpu_->LoadBootRom(LoadBin("rom/fast_boot.bin"));
+    // first load the rom, this will have priority over the cartridge memory
+    if (boot_rom_.empty()) {
+      boot_rom_ = LoadBin("rom/fast_boot.bin");
+    }
+    cpu_->LoadBootRom(boot_rom_);
 
-  ppu_ = std::make_unique<PPU>(*event_bus_, *cpu_, *bus_, *output_wrapper_);
+    ppu_ = bus_->arena().New<PPU>(*event_bus_, *cpu_, *bus_, *output_wrapper_);
+  }
 
   // load cartridge
+  START_COVERAGE(file_path, cartridge->rom_bank_count());
+  bool reload = cpu_->cartridge_ != nullptr;
   cpu_->LoadCartridge(std::move(cartridge));
+  if (reload) {
+    // from power on like a restart, the last cartridge's run may have left anything behind
+    cpu_->Reset();
+    ppu_->Reset();
+  }
+#ifndef STEP_EVERY_INSTRUCTION
+  recompiled_ = RecompiledCode::Load("recompiled", cpu_->cartridge_->data());
+#endif
 
-  INIT_DEBUGGER(*bus_);
+  INIT_DEBUGGER(*bus_, cpu_->registers_);
+#ifdef ENABLE_TRACE
+  // traces go next to the recompiled code, named after the ROM
+  std::filesystem::create_directories("trace");
+  START_TRACE("trace/" + std::filesystem::path(file_path).stem().string() + ".lbt");
+#endif
+  START_PROFILER(file_path);
+  perf_ = std::make_unique<PerfCounters>();
+  perf_steps_ = 0;
+  perf_ic_ = 0;
+  perf_instructions_ = 0;
+  perf_ticks_ = 0;
+  perf_cpu_ns_ = 0;
+  perf_ppu_ns_ = 0;
+  perf_next_publish_ = PerfCounters::kPublishTicks;
+  perf_frame_base_ = 0;
+  perf_cycle_base_ = 0;
+  perf_samples_.clear();
+  reset_requested_ = false;
   cpu_->running_ = true;
 
   emulator_thread_ = std::make_unique<std::thread>([this]() {
+    INSTRUMENT_THREAD("emulation");
     while (cpu_ && cpu_->running_) {
+      // the plain load keeps the check off the bus while nothing is requested
+      if (reset_requested_.load(std::memory_order_relaxed) && reset_requested_.exchange(false)) {
+        ResetMachine();
+      }
       StepEmulation();
     }
   });
   return true;
 }
 
+void Emulator::Restart() {
+  if (!cpu_ || !cpu_->running_) {
+    LoadCartridge(cartridge_path_);
+    return;
+  }
+  reset_requested_ = true;
+}
+
+void Emulator::ResetMachine() {
+  INSTRUMENT_ZONE("Emulator::ResetMachine");
+  // the HUD's totals are since the load, they carry on from here
+  perf_frame_base_ += ppu_->frame_count_;
+  perf_cycle_base_ += cpu_->cycle_count_;
+  perf_instructions_ += cpu_->ic_ - perf_ic_;
+  perf_ic_ = 0;
+  RESET_DEBUGGER();
+  // the coverage and the profile are of one run from power on like the trace, the
+  // last run's reports are written first. Coverage starts before the cartridge maps its banks
+  STOP_PROFILER();
+  STOP_COVERAGE();
+  START_COVERAGE(cartridge_path_, cpu_->cartridge_->rom_bank_count());
+  cpu_->Reset();
+  ppu_->Reset();
+  INIT_DEBUGGER(*bus_, cpu_->registers_);
+#ifdef ENABLE_TRACE
+  STOP_TRACE();
+  START_TRACE("trace/" + std::filesystem::path(cartridge_path_).stem().string() + ".lbt");
+#endif
+  START_PROFILER(cartridge_path_);
+  next_cpu_cycle_ = clock::now();
+  sync_point_ = next_cpu_cycle_;
+  ticks_since_sync_ = scheduler_ticks{0};
+}
+
 void Emulator::StepEmulation() {
   if (!cpu_ || !cpu_->running_) {
     return;
   }
 
   auto now = clock::now();
-  if (now >= next_cpu_cycle_) {
-    if (!cpu_->halted_) {
+  if (now < next_cpu_cycle_) {
+    return;
+  }
+  INSTRUMENT_ZONE("Emulator::StepEmulation");
+  if (now - next_cpu_cycle_ > std::chrono::milliseconds(100)) {
+    // we fell too far behind (debugger pause, slow host), don't try to catch up
+    sync_point_ = now;
+    ticks_since_sync_ = scheduler_ticks{0};
+  }
+
+  // now doubles as the start of the CPU time of timed steps
+  bool timed = ++perf_steps_ % PerfCounters::kSampledSteps == 0;
+
+  PROFILE_STEP(*cpu_);
+  if (!cpu_->halted_) {
+    INSTRUMENT_ZONE("CPU");
+    bool recompiled = false;
+#ifndef STEP_EVERY_INSTRUCTION
+    recompiled = recompiled_ && recompiled_->Step(*cpu_);
+#endif
+    if (!recompiled) {
+#ifdef USE_THREADED_INTERPRETER
+      cpu_->StepThreaded(CPU::kThreadedSliceCycles);
+#else
       cpu_->Step();
-      cpu_->ProcessDMA();
-      cpu_->HandleInterrupts();
-    } else {
-      cpu_->cycles_consumed_ = 4;
+#endif
     }
-    cpu_->UpdateTimers(cpu_->cycles_consumed_);
-    // todo, PPU it should run at /2 cycle count in double speed mode!
-    for (int i = 0; i < cpu_->cycles_consumed_; i--) {
+    cpu_->ProcessDMA();
+    cpu_->HandleInterrupts();
+  } else {
+    cpu_->cycles_consumed_ = 4;
+    cpu_->HandleInterrupts();
+  }
+  // timers are clocked by the CPU so they run twice as fast in double speed mode
+  cpu_->UpdateTimers(cpu_->cycles_consumed_);
+  // the PPU stays at 4MHz, one dot every two ticks regardless of the CPU speed
+  u32 ticks = cpu_->ticks_consumed();
+  u32 dots = ticks >> 1;
+  clock::time_point ppu_begin;
+  if (timed) {
+    ppu_begin = clock::now();
+    perf_cpu_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(ppu_begin - now).count() * PerfCounters::kSampledSteps;
+  }
+  {
+    INSTRUMENT_ZONE("PPU");
+    for (u32 i = 0; i < dots; i++) {
       ppu_->Step();
       if (ppu_->frame_complete_) {
         update_image_ = true;
       }
     }
-    next_cpu_cycle_ += std::chrono::nanoseconds(static_cast<long>(1'000'000'000 / cpu_->clock_speed_)) * cpu_->cycles_consumed_ / 10;
   }
-  auto end = clock::now();
-  next_cpu_cycle_ -= std::chrono::duration_cast<std::chrono::microseconds>(end - now);
+  if (timed) {
+    perf_ppu_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - ppu_begin).count() * PerfCounters::kSampledSteps;
+  }
+  perf_ticks_ += ticks;
+  if (perf_ticks_ >= perf_next_publish_) {
+    PublishPerf();
+  }
+  ticks_since_sync_ += scheduler_ticks{ticks};
+  next_cpu_cycle_ = sync_point_ + std::chrono::duration_cast<clock::duration>(ticks_since_sync_);
+}
+
+void Emulator::PublishPerf() {
+  perf_instructions_ += cpu_->ic_ - perf_ic_; // ic_ wraps
+  perf_ic_ = cpu_->ic_;
+  perf_->frames.store(perf_frame_base_ + ppu_->frame_count_, std::memory_order_relaxed);
+  perf_->instructions.store(perf_instructions_, std::memory_order_relaxed);
+  perf_->cycles.store(perf_cycle_base_ + cpu_->cycle_count_, std::memory_order_relaxed);
+  perf_->ticks.store(perf_ticks_, std::memory_order_relaxed);
+  perf_->cpu_ns.store(perf_cpu_ns_, std::memory_order_relaxed);
+  perf_->ppu_ns.store(perf_ppu_ns_, std::memory_order_relaxed);
+#ifdef ENABLE_BUS_COUNTERS
+  for (u32 i = 0; i < kBusRegionCount; i++) {
+    perf_->reads[i].store(bus_->read_counts()[i], std::memory_order_relaxed);
+    perf_->writes[i].store(bus_->write_counts()[i], std::memory_order_relaxed);
+  }
+  bus_->ResetAccessCounts();
+#endif
+  perf_next_publish_ = perf_ticks_ + PerfCounters::kPublishTicks;
 }
 
 void Emulator::Run() {
+  INSTRUMENT_THREAD("ui");
   running_ = true;
   while (running_ && !window_->ShouldClose()) {
     //auto now = clock::now();
     //if (now >= next_window_cycle_) {
+    auto upload_begin = clock::now();
     Update();
-    window_->BeginFrame();
+    auto upload_end = clock::now();
+    {
+      INSTRUMENT_ZONE("Window::BeginFrame");
+      window_->BeginFrame();
+    }
+    auto ui_begin = clock::now();
     Render();
-    window_->EndFrame();
+    auto ui_end = clock::now();
+    {
+      // ImGui draws and the buffers are swapped here
+      INSTRUMENT_ZONE("Window::EndFrame");
+      window_->EndFrame();
+    }
+    INSTRUMENT_FLUSH_COUNTERS();
+    // smoothed over about the last 20 UI frames, the UI time leaves out the buffer
+    // swap since it waits for vsync
+    upload_ms_ += (std::chrono::duration<float, std::milli>(upload_end - upload_begin).count() - upload_ms_) * 0.05f;
+    ui_ms_ += (std::chrono::duration<float, std::milli>(ui_end - ui_begin).count() - ui_ms_) * 0.05f;
     //next_window_cycle_ += std::chrono::nanoseconds(static_cast<long>(1'000'000'000 / 60.0));
     //}
   }
@@ -121,6 +284,9 @@ void Emulator::Run() {
     emulator_thread_->join();
   }
   emulator_thread_ = nullptr;
+  STOP_TRACE();
+  STOP_PROFILER();
+  STOP_COVERAGE();
 }
 
 void Emulator::Update() {
@@ -131,6 +297,7 @@ void Emulator::Update() {
 }
 
 void Emulator::Render() {
+  INSTRUMENT_ZONE("Emulator::Render");
   renderer_->ClearColor({255, 255, 255, 255});
   ImGui::SetNextWindowPos(ImGui::GetMainViewport()->WorkPos);
   ImGui::SetNextWindowSize(ImGui::GetMainViewport()->WorkSize);
@@ -166,8 +333,22 @@ void Emulator::Render() {
         }
       }
       if (!cartridge_path_.empty() && ImGui::MenuItem("Restart")) {
-        LoadCartridge(cartridge_path_);
+        Restart();
       }
+#ifdef ENABLE_INSTRUMENTATION
+      if (ImGui::MenuItem(Instrument::capturing() ? "Stop Host Trace" : "Start Host Trace")) {
+        if (Instrument::capturing()) {
+          std::filesystem::create_directories("instrument");
+          Instrument::Stop("instrument/host_trace.json");
+        } else {
+          Instrument::Start();
+        }
+      }
+#endif
+      ImGui::EndMenu();
+    }
+    if (ImGui::BeginMenu("View")) {
+      ImGui::MenuItem("Performance HUD", nullptr, &show_perf_hud_);
       ImGui::EndMenu();
     }
     ImGui::EndMainMenuBar();
@@ -185,6 +366,8 @@ void Emulator::Render() {
   output_->DrawImGui(scaled_width, scaled_height);
   ImGui::End();
 
+  RenderPerfHud();
+
 #ifdef ENABLE_DEBUGGER
   if (cpu_) {
     RenderDebugger();
@@ -192,10 +375,75 @@ void Emulator::Render() {
     RenderMemoryViewer();
     RenderCallStack();
     RenderVRAM();
+#ifdef ENABLE_COVERAGE
+    RenderCoverage();
+#endif
   }
 #endif
 }
 
+void Emulator::RenderPerfHud() {
+  if (!show_perf_hud_ || !perf_) {
+    return;
+  }
+  auto now = clock::now();
+  perf_samples_.push_back({
+      now,
+      perf_->frames.load(std::memory_order_relaxed),
+      perf_->instructions.load(std::memory_order_relaxed),
+      perf_->cycles.load(std::memory_order_relaxed),
+      perf_->ticks.load(std::memory_order_relaxed),
+      perf_->cpu_ns.load(std::memory_order_relaxed),
+      perf_->ppu_ns.load(std::memory_order_relaxed),
+  });
+  while (perf_samples_.size() > 2 && now - perf_samples_.front().time > std::chrono::seconds(1)) {
+    perf_samples_.pop_front();
+  }
+  const PerfSample& first = perf_samples_.front();
+  const PerfSample& last = perf_samples_.back();
+  double seconds = std::chrono::duration<double>(last.time - first.time).count();
+  u64 frames = last.frames - first.frames;
+  // a frame of the real hardware, the budget every share is taken of
+  constexpr double kFrameMs = 1000.0 / 59.73;
+  auto per_frame_ms = [frames](u64 ns) { return frames == 0 ? 0.0 : ns / 1e6 / frames; };
+  double cpu_ms = per_frame_ms(last.cpu_ns - first.cpu_ns);
+  double ppu_ms = per_frame_ms(last.ppu_ns - first.ppu_ns);
+
+  ImGuiViewport* viewport = ImGui::GetMainViewport();
+  ImGui::SetNextWindowPos(ImVec2(viewport->WorkPos.x + viewport->WorkSize.x - 8, viewport->WorkPos.y + 8),
+                          ImGuiCond_Always, ImVec2(1.0f, 0.0f));
+  ImGui::SetNextWindowBgAlpha(0.6f);
+  ImGui::Begin("Performance", nullptr,
+               ImGuiWindowFlags_NoDecoration |
+                   ImGuiWindowFlags_AlwaysAutoResize |
+                   ImGuiWindowFlags_NoSavedSettings |
+                   ImGuiWindowFlags_NoFocusOnAppearing |
+                   ImGuiWindowFlags_NoNav |
+                   ImGuiWindowFlags_NoMove);
+  if (seconds > 0) {
+    ImGui::Text("%.2f MIPS, %.2f M cycles/s", (last.instructions - first.instructions) / seconds / 1e6,
+                (last.cycles - first.cycles) / seconds / 1e6);
+    ImGui::Text("%.1f FPS, %.1f%% speed", frames / seconds,
+                100.0 * (last.ticks - first.ticks) / seconds / SCHEDULER_CLOCK_SPEED);
+  }
+  ImGui::Separator();
+  ImGui::Text("CPU    %5.2f ms %5.1f%%", cpu_ms, 100.0 * cpu_ms / kFrameMs);
+  ImGui::Text("PPU    %5.2f ms %5.1f%%", ppu_ms, 100.0 * ppu_ms / kFrameMs);
+  ImGui::Text("UI     %5.2f ms %5.1f%%", ui_ms_, 100.0 * ui_ms_ / kFrameMs);
+  ImGui::Text("Upload %5.2f ms %5.1f%%", upload_ms_, 100.0 * upload_ms_ / kFrameMs);
+  ImGui::Separator();
+#ifdef ENABLE_BUS_COUNTERS
+  ImGui::Text("bus per frame   reads  writes");
+  for (u32 i = 0; i < kBusRegionCount; i++) {
+    ImGui::Text("%-12s %8u %7u", BusRegionToString((BusRegion) i), perf_->reads[i].load(std::memory_order_relaxed),
+                perf_->writes[i].load(std::memory_order_relaxed));
+  }
+#else
+  ImGui::TextDisabled("bus accesses need COUNT_BUS_ACCESSES");
+#endif
+  ImGui::End();
+}
+
 #ifdef ENABLE_DEBUGGER
 
 struct InstructionEntry {
@@ -284,6 +532,27 @@ void Emulator::RenderDebugger() {
       if (isCurrent || isBreakpoint) {
         ImGui::PopStyleColor();
       }
+
+      // right click sets a conditional breakpoint, e.g. "A == 0x3C && [HL] > 5"
+      static char condition[128];
+      std::string popup = "##Condition" + std::to_string(entry.address);
+      if (ImGui::IsItemClicked(ImGuiMouseButton_Right)) {
+        snprintf(condition, sizeof(condition), "%s", Debugger::GetBreakpointCondition(entry.address).c_str());
+        ImGui::OpenPopup(popup.c_str());
+      }
+      if (ImGui::BeginPopup(popup.c_str())) {
+        ImGui::Text("Break When");
+        if (ImGui::InputText("##condition", condition, sizeof(condition), ImGuiInputTextFlags_EnterReturnsTrue)) {
+          std::string error;
+          if (Debugger::SetBreakpointCondition(entry.address, condition, &error)) {
+            Debugger::SetBreakpoint(entry.address, true);
+            ImGui::CloseCurrentPopup();
+          } else {
+            std::cerr << "invalid condition: " << error << std::endl;
+          }
+        }
+        ImGui::EndPopup();
+      }
     }
   }
 
@@ -338,18 +607,18 @@ void Emulator::RenderDebugger() {
 
 std::vector<std::string> Emulator::GetRegisters() {
   std::vector<std::string> registers = {
-      {"A: " + ToHex(cpu_->registers_.a)},
+      {"A: " + ToHex(cpu_->registers_.Get<ArithmeticTarget::A>())},
       {"BC: " + ToHex(cpu_->registers_.Get(ArithmeticTarget::BC))},
       {"DE: " + ToHex(cpu_->registers_.Get(ArithmeticTarget::DE))},
       {"HL: " + ToHex(cpu_->registers_.Get(ArithmeticTarget::HL))},
       {" "},
-      {"FLAGS: " + ToBinary(cpu_->registers_.flags.v)},
-      {" zero: " + BoolToStr(cpu_->registers_.flags.f.zero)},
-      {" carry: " + BoolToStr(cpu_->registers_.flags.f.carry)},
-      {" half carry: " + BoolToStr(cpu_->registers_.flags.f.half_carry)},
-      {" subtract: " + BoolToStr(cpu_->registers_.flags.f.subtract)},
+      {"FLAGS: " + ToBinary(cpu_->registers_.flags.ToByte())},
+      {" zero: " + BoolToStr(cpu_->registers_.flags.zero())},
+      {" carry: " + BoolToStr(cpu_->registers_.flags.carry())},
+      {" half carry: " + BoolToStr(cpu_->registers_.flags.half_carry())},
+      {" subtract: " + BoolToStr(cpu_->registers_.flags.subtract())},
       {" "},
-      {"SP: " + ToHex(cpu_->registers_.Get(ArithmeticTarget::SP))},
+      {"SP: " + ToHex(cpu_->registers_.sp())},
       {"PC: " + ToHex(cpu_->registers_.pc)},
       {" "},
       {"TAC: " + ToHex(cpu_->tac_)},
@@ -417,7 +686,8 @@ void Emulator::RenderMemoryViewer() {
           ImGui::Selectable("--", false, ImGuiSelectableFlags_Disabled);
           continue;
         }
-        u8 value = bus_->Read(address);
+        // peeked, reading every byte each frame would count as the game reading them
+        u8 value = bus_->Peek(address);
 
         char data[5];
         snprintf(data, sizeof(data), "%02X", value);
@@ -523,4 +793,70 @@ void Emulator::RenderVRAM() {
   ImGui::End();
 }
 
+#ifdef ENABLE_COVERAGE
+void Emulator::RenderCoverage() {
+  if (!ImGui::Begin("Coverage")) {
+    ImGui::End();
+    return;
+  }
+
+  const std::vector<CoverageBank>& banks = Coverage::banks();
+  static int bank = 0;
+  // bytes light up when they are first covered and fade back over about a second
+  static std::array<u8, CARTRIDGE_ROM_SIZE> heat;
+  static CoverageBank previous;
+  static int previous_bank = -1;
+  if (banks.empty()) {
+    ImGui::End();
+    return;
+  }
+  bank = std::clamp(bank, 0, (int) banks.size() - 1);
+  ImGui::SliderInt("Bank", &bank, 0, (int) banks.size() - 1);
+  const CoverageBank& current = banks[bank];
+  if (bank != previous_bank) {
+    heat.fill(0);
+    previous = current;
+    previous_bank = bank;
+  }
+
+  u32 executed = 0;
+  u32 read = 0;
+  for (u32 i = 0; i < CARTRIDGE_ROM_SIZE; i++) {
+    u8 mask = 1 << (i & 7);
+    bool is_executed = current.executed[i >> 3] & mask;
+    bool is_read = current.read[i >> 3] & mask;
+    if ((is_executed && !(previous.executed[i >> 3] & mask)) || (is_read && !(previous.read[i >> 3] & mask))) {
+      heat[i] = 255;
+    } else {
+      heat[i] = heat[i] > 4 ? heat[i] - 4 : 0;
+    }
+    executed += is_executed;
+    read += is_read;
+    // executed in green, only read in blue, new bytes towards white
+    Colori color{24, 24, 24, 255};
+    if (is_executed) {
+      color = {32, 200, 64, 255};
+    } else if (is_read) {
+      color = {48, 96, 224, 255};
+    }
+    color.r += (255 - color.r) * heat[i] / 255;
+    color.g += (255 - color.g) * heat[i] / 255;
+    color.b += (255 - color.b) * heat[i] / 255;
+    coverage_output_wrapper_->SetPixel(i % kCoverageWidth, i / kCoverageWidth, color);
+  }
+  previous = current;
+  coverage_output_wrapper_->Update();
+
+  ImGui::Text("executed %.2f%%, read %.2f%%, %u new bytes last frame", 100.0f * executed / CARTRIDGE_ROM_SIZE,
+              100.0f * read / CARTRIDGE_ROM_SIZE, Coverage::last_frame_delta());
+
+  // fit the image to the window
+  ImVec2 avail = ImGui::GetContentRegionAvail();
+  float size = std::min(avail.x, avail.y);
+  coverage_output_->DrawImGui(size, size);
+
+  ImGui::End();
+}
+#endif
+
 #endif
@@ -7,18 +7,25 @@
 #include "window.h"
 #include "renderer.h"
 #include "debug.h"
+#include "perf.h"
+#include "recompiled.h"
+#include <deque>
 #include <thread>
 
 
 class Emulator {
  public:
   using clock = std::chrono::high_resolution_clock;
+  using scheduler_ticks = std::chrono::duration<s64, std::ratio<1, SCHEDULER_CLOCK_SPEED>>;
 
   Emulator();
 
   void Start();
 
   bool LoadCartridge(const std::string& file_path);
+  // power cycles the loaded cartridge in place, the emulation thread does it
+  // between two steps and keeps running
+  void Restart();
 
  private:
   bool running_ = false;
@@ -30,24 +37,72 @@ class Emulator {
   std::unique_ptr<Texture> vram_output_;
   std::unique_ptr<TextureWrapper> output_wrapper_;
   std::unique_ptr<TextureWrapper> vram_output_wrapper_;
+#if defined(ENABLE_DEBUGGER) && defined(ENABLE_COVERAGE)
+  // a pixel per byte of a ROM bank
+  static constexpr s32 kCoverageWidth = 128;
+  std::unique_ptr<Texture> coverage_output_;
+  std::unique_ptr<TextureWrapper> coverage_output_wrapper_;
+#endif
   bool update_image_ = false;
 
   std::unique_ptr<MemoryBus> bus_;
-  std::unique_ptr<CPU> cpu_;
-  std::unique_ptr<PPU> ppu_;
+  // in the bus's arena, next to the devices and memory they use
+  ArenaPtr<CPU> cpu_;
+  ArenaPtr<PPU> ppu_;
+#ifndef STEP_EVERY_INSTRUCTION
+  // blocks from laneboy-recompile, the debugger and the tracer need every instruction to go through Step
+  std::unique_ptr<RecompiledCode> recompiled_;
+#endif
 
 
   std::chrono::time_point<clock> next_cpu_cycle_;
+  // pacing is measured from the sync point so rounding errors don't accumulate
+  std::chrono::time_point<clock> sync_point_;
+  scheduler_ticks ticks_since_sync_{0};
   std::chrono::time_point<clock> next_window_cycle_;
 
   std::unique_ptr<std::thread> emulator_thread_;
+  std::atomic<bool> reset_requested_ = false;
+  // read once, mapped again by every load
+  std::vector<u8> boot_rom_;
+
+  // emulation thread side of perf_, see PerfCounters
+  std::unique_ptr<PerfCounters> perf_;
+  u32 perf_steps_ = 0;
+  u32 perf_ic_ = 0;
+  u64 perf_instructions_ = 0;
+  u64 perf_ticks_ = 0;
+  u64 perf_cpu_ns_ = 0;
+  u64 perf_ppu_ns_ = 0;
+  u64 perf_next_publish_ = 0;
+  // frames and cycles of the runs before the last restart, the published totals go on from them
+  u64 perf_frame_base_ = 0;
+  u64 perf_cycle_base_ = 0;
+
+  // UI side, the samples of the last second and the smoothed time per UI frame
+  struct PerfSample {
+    clock::time_point time;
+    u64 frames;
+    u64 instructions;
+    u64 cycles;
+    u64 ticks;
+    u64 cpu_ns;
+    u64 ppu_ns;
+  };
+  std::deque<PerfSample> perf_samples_;
+  float ui_ms_ = 0;
+  float upload_ms_ = 0;
+  bool show_perf_hud_ = true;
 
  private:
   void StepEmulation();
+  void ResetMachine();
+  void PublishPerf();
   void Run();
 
   void Update();
   void Render();
+  void RenderPerfHud();
 
 #ifdef ENABLE_DEBUGGER
   void RenderDebugger();
@@ -55,6 +110,9 @@ class Emulator {
   void RenderMemoryViewer();
   void RenderCallStack();
   void RenderVRAM();
+#ifdef ENABLE_COVERAGE
+  void RenderCoverage();
+#endif
 
   std::vector<std::string> GetRegisters();
 #endif
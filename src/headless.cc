@@ -0,0 +1,260 @@
+#include "headless.h"
+
+const char* ExecutionModeToString(ExecutionMode mode) {
+  switch (mode) {
+    case ExecutionMode::Interpreter: return "interpreter";
+    case ExecutionMode::Threaded: return "threaded";
+    case ExecutionMode::Recompiled: return "recompiled";
+  }
+  return "";
+}
+
+std::optional<ExecutionMode> ExecutionModeFromString(std::string_view text) {
+  for (ExecutionMode mode : {ExecutionMode::Interpreter, ExecutionMode::Threaded, ExecutionMode::Recompiled}) {
+    if (text == ExecutionModeToString(mode)) {
+      return mode;
+    }
+  }
+  return std::nullopt;
+}
+
+bool IsExecutionModeAvailable(ExecutionMode mode) {
+  switch (mode) {
+    case ExecutionMode::Interpreter:
+      return true;
+    case ExecutionMode::Threaded:
+#ifdef HAVE_THREADED_INTERPRETER
+      return true;
+#else
+      return false;
+#endif
+    case ExecutionMode::Recompiled:
+#ifndef STEP_EVERY_INSTRUCTION
+      return true;
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+static constexpr std::pair<std::string_view, u8> kButtonNames[] = {
+    {"right", kJoypadRight}, {"left", kJoypadLeft}, {"up", kJoypadUp}, {"down", kJoypadDown},
+    {"a", kJoypadA}, {"b", kJoypadB}, {"select", kJoypadSelect}, {"start", kJoypadStart},
+};
+
+std::optional<InputScript> InputScript::Parse(std::string_view text, std::string* error) {
+  InputScript script;
+  u32 line_number = 0;
+  while (!text.empty()) {
+    size_t end = text.find('\n');
+    std::string_view line = text.substr(0, end);
+    text = end == std::string_view::npos ? std::string_view() : text.substr(end + 1);
+    line_number++;
+    line = line.substr(0, line.find('#'));
+    std::istringstream stream{std::string(line)};
+    std::string frame_text;
+    std::string buttons_text;
+    if (!(stream >> frame_text)) {
+      continue; // blank or only a comment
+    }
+    auto fail = [&](const std::string& message) -> std::optional<InputScript> {
+      if (error) {
+        *error = "line " + std::to_string(line_number) + ": " + message;
+      }
+      return std::nullopt;
+    };
+    char* frame_end;
+    u64 frame = std::strtoull(frame_text.c_str(), &frame_end, 10);
+    if (*frame_end != '\0' || !(stream >> buttons_text)) {
+      return fail("expected <frame> <buttons>");
+    }
+    if (!script.changes_.empty() && frame <= script.changes_.back().frame) {
+      return fail("frames have to increase");
+    }
+    u8 buttons = 0;
+    if (buttons_text != "-") {
+      std::istringstream names(buttons_text);
+      std::string name;
+      while (std::getline(names, name, '+')) {
+        auto button = std::find_if(std::begin(kButtonNames), std::end(kButtonNames),
+                                   [&name](const auto& entry) { return entry.first == name; });
+        if (button == std::end(kButtonNames)) {
+          return fail("unknown button '" + name + "'");
+        }
+        buttons |= button->second;
+      }
+    }
+    script.changes_.push_back({frame, buttons});
+  }
+  return script;
+}
+
+std::optional<InputScript> InputScript::Load(const std::string& path, std::string* error) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    if (error) {
+      *error = "unable to open " + path;
+    }
+    return std::nullopt;
+  }
+  std::stringstream text;
+  text << file.rdbuf();
+  return Parse(text.str(), error);
+}
+
+u8 InputScript::ButtonsAt(u64 frame) const {
+  auto next = std::upper_bound(changes_.begin(), changes_.end(), frame,
+                               [](u64 frame, const Change& change) { return frame < change.frame; });
+  return next == changes_.begin() ? 0 : std::prev(next)->buttons;
+}
+
+Headless::Headless(std::unique_ptr<Cartridge> cartridge, ExecutionMode mode)
+    : output_(CreateMemoryTexture(160, 144)), output_wrapper_(*output_), cpu_(bus_.arena().New<CPU>(event_bus_, bus_)),
+      ppu_(bus_.arena().New<PPU>(event_bus_, *cpu_, bus_, output_wrapper_)), mode_(mode) {
+#ifdef ENABLE_COVERAGE
+  // started before the cartridge maps its banks, like in Emulator::LoadCartridge
+  if (!cartridge->path().empty() && !Coverage::running()) {
+    START_COVERAGE(cartridge->path(), cartridge->rom_bank_count());
+    records_coverage_ = true;
+  }
+#endif
+  cpu_->LoadCartridge(std::move(cartridge));
+#ifndef STEP_EVERY_INSTRUCTION
+  if (mode_ == ExecutionMode::Recompiled) {
+    recompiled_ = RecompiledCode::Load("recompiled", cpu_->cartridge_->data());
+  }
+#endif
+  INIT_DEBUGGER(bus_, cpu_->registers_);
+  FastBoot();
+  cpu_->running_ = true;
+}
+
+Headless::~Headless() {
+#ifdef ENABLE_COVERAGE
+  if (records_coverage_) {
+    STOP_COVERAGE();
+  }
+#endif
+}
+
+void Headless::FastBoot() {
+  cpu_->registers_.Set(ArithmeticTarget::SP, 0xFFFE);
+  bus_.Write(LCD_CONTROL_ADDRESS, (u8) 0x80);
+  cpu_->registers_.pc = 0x0100;
+}
+
+void Headless::Reset() {
+  cpu_->Reset();
+  ppu_->Reset();
+  FastBoot();
+  cpu_->running_ = true;
+  instructions_ = 0;
+  ic_ = 0;
+}
+
+template<typename Archive>
+void Headless::Serialize(Archive& archive) {
+  cpu_->Serialize(archive);
+  cpu_->cartridge_->Serialize(archive);
+  ppu_->Serialize(archive);
+  archive.Bytes(output_wrapper_.pixels());
+  archive(instructions_, ic_);
+}
+
+Snapshot Headless::Save(BankMode mode) {
+  INSTRUMENT_ZONE("Headless::Save");
+  StateWriter writer(mode);
+  Serialize(writer);
+  Snapshot snapshot;
+  snapshot.bank_mode_ = mode;
+  snapshot.bytes_ = writer.TakeBytes();
+  snapshot.banks_ = writer.TakeBanks();
+  snapshot.cartridge_ = cpu_->cartridge_->Share();
+  snapshot.mode_ = mode_;
+#ifndef STEP_EVERY_INSTRUCTION
+  snapshot.recompiled_ = recompiled_;
+#endif
+  return snapshot;
+}
+
+void Headless::Load(const Snapshot& snapshot) {
+  INSTRUMENT_ZONE("Headless::Load");
+  StateReader reader(snapshot.bank_mode_, snapshot.bytes_, snapshot.banks_);
+  Serialize(reader);
+  assert(reader.done());
+}
+
+std::unique_ptr<Headless> Snapshot::Fork() const {
+  INSTRUMENT_ZONE("Snapshot::Fork");
+  // made as an interpreter so the recompiled module isn't loaded again, it is shared
+  auto machine = std::make_unique<Headless>(cartridge_->Share());
+  machine->mode_ = mode_;
+#ifndef STEP_EVERY_INSTRUCTION
+  machine->recompiled_ = recompiled_;
+#endif
+  machine->Load(*this);
+  return machine;
+}
+
+u32 Headless::Step() {
+  if (!cpu_->halted_) {
+    bool recompiled = false;
+#ifndef STEP_EVERY_INSTRUCTION
+    recompiled = recompiled_ && recompiled_->Step(*cpu_);
+#endif
+    if (!recompiled) {
+#ifdef HAVE_THREADED_INTERPRETER
+      if (mode_ == ExecutionMode::Threaded) {
+        cpu_->StepThreaded(CPU::kThreadedSliceCycles);
+      } else {
+        cpu_->Step();
+      }
+#else
+      cpu_->Step();
+#endif
+    }
+    cpu_->ProcessDMA();
+    cpu_->HandleInterrupts();
+  } else {
+    cpu_->cycles_consumed_ = 4;
+    cpu_->HandleInterrupts();
+  }
+  cpu_->UpdateTimers(cpu_->cycles_consumed_);
+  u32 dots = cpu_->ticks_consumed() >> 1;
+  for (u32 i = 0; i < dots; i++) {
+    ppu_->Step();
+  }
+  return dots;
+}
+
+bool Headless::RunFrame() {
+  u64 frame = ppu_->frame_count_;
+  u32 dots = 0;
+  bool complete = false;
+  while (cpu_->running_) {
+    dots += Step();
+    if (ppu_->frame_count_ != frame) {
+      complete = true;
+      break;
+    }
+    if (!cpu_->lcdc_.bits.lcd_enable && dots >= kFrameDots) {
+      break;
+    }
+  }
+  instructions_ += cpu_->ic_ - ic_; // ic_ wraps
+  ic_ = cpu_->ic_;
+  return complete;
+}
+
+u64 Headless::HashOutput() {
+  return Recompiled::HashRom(output_->data());
+}
+
+bool Headless::recompiled_loaded() const {
+#ifndef STEP_EVERY_INSTRUCTION
+  return recompiled_ != nullptr;
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "coverage.h"
+#include "cpu.h"
+#include "ppu.h"
+#include "recompiled.h"
+#include "renderer.h"
+#include "state.h"
+#include <optional>
+#include <string_view>
+
+// How the CPU runs instructions. Threaded needs a release build with GCC or Clang,
+// recompiled needs the ROM's module from laneboy-recompile, see recompiled.h, and
+// falls back to the interpreter for code the blocks don't cover.
+enum class ExecutionMode {
+  Interpreter,
+  Threaded,
+  Recompiled,
+};
+
+const char* ExecutionModeToString(ExecutionMode mode);
+std::optional<ExecutionMode> ExecutionModeFromString(std::string_view text);
+// false if this build left the mode out
+bool IsExecutionModeAvailable(ExecutionMode mode);
+
+// Buttons held per frame, one "<frame> <buttons>" line each, e.g. "120 start" or
+// "300 a+right". The buttons are held from that frame until the next line, "-"
+// releases all of them and # starts a comment.
+class InputScript {
+ public:
+  // nullopt if the text isn't a valid script, error says why
+  static std::optional<InputScript> Parse(std::string_view text, std::string* error = nullptr);
+  static std::optional<InputScript> Load(const std::string& path, std::string* error = nullptr);
+
+  // JoypadButton bits held during frame
+  u8 ButtonsAt(u64 frame) const;
+
+ private:
+  struct Change {
+    u64 frame;
+    u8 buttons;
+  };
+  std::vector<Change> changes_; // by frame
+};
+
+class Snapshot;
+
+// The emulator's machine without a window and without pacing, it runs as fast as
+// the host allows, for tools and benchmarks.
+class Headless {
+ public:
+  // Built with COVERAGE, a machine of a ROM file starts recording coverage unless another
+  // one already is, and writes it when it is destroyed. Machines made meanwhile, forks
+  // included, add to that run.
+  explicit Headless(std::unique_ptr<Cartridge> cartridge, ExecutionMode mode = ExecutionMode::Interpreter);
+  Headless(const Headless&) = delete;
+  ~Headless();
+
+  // 154 lines of 456 dots
+  static constexpr u32 kFrameDots = 70224;
+
+  // one instruction and the dots that go with it, same order as Emulator::StepEmulation,
+  // returns the dots
+  u32 Step();
+  // until the PPU finishes a frame, or a frame's worth of dots with the LCD off,
+  // returns false in the second case
+  bool RunFrame();
+
+  // power cycles the machine in place, the cartridge and the recompiled code stay
+  // loaded, cheap enough to run thousands of times a second
+  void Reset();
+
+  // the state as it is now, see Snapshot. In Share mode the RAM banks are frozen and
+  // shared with the snapshot, the machine copies a bank back when it next writes to it
+  Snapshot Save(BankMode mode = BankMode::Share);
+  // back to where the snapshot was taken, it has to be of a machine with the same ROM
+  void Load(const Snapshot& snapshot);
+
+  // of the output image, equal across modes if they emulate the same
+  u64 HashOutput();
+
+  // false in recompiled mode when there was no matching module
+  bool recompiled_loaded() const;
+
+  // instructions since power on, unlike cpu_.ic_ this one doesn't wrap, updated by RunFrame
+  u64 instructions() const { return instructions_; }
+
+ private:
+  friend class Snapshot;
+
+  // what rom/fast_boot.bin does, without needing the file
+  void FastBoot();
+  template<typename Archive>
+  void Serialize(Archive& archive);
+
+ public:
+  EventBus event_bus_;
+  MemoryBus bus_;
+  std::unique_ptr<Texture> output_;
+  TextureWrapper output_wrapper_;
+  // in the bus's arena, next to the devices and memory they use
+  ArenaPtr<CPU> cpu_;
+  ArenaPtr<PPU> ppu_;
+  ExecutionMode mode_;
+
+ private:
+#ifndef STEP_EVERY_INSTRUCTION
+  std::shared_ptr<RecompiledCode> recompiled_; // shared with the machines forked from this one
+#endif
+  u64 instructions_ = 0;
+  u32 ic_ = 0;
+#ifdef ENABLE_COVERAGE
+  bool records_coverage_ = false;
+#endif
+};
+
+// A Headless machine at one point in time, for exploring what different inputs do
+// from there. It never changes after Save, so any number of threads can fork from it
+// or load it at once. In Share mode it holds frozen copies of the RAM banks, which
+// the machines made from it read until they write to a bank, and the ROM is shared
+// too, so a fork costs a new machine, the registers and I/O and the output image.
+class Snapshot {
+ public:
+  // a new machine that goes on from here, with the same ROM, mode and recompiled code
+  std::unique_ptr<Headless> Fork() const;
+
+  BankMode bank_mode() const { return bank_mode_; }
+  // of the bytes, frozen banks not included
+  size_t size() const { return bytes_.size(); }
+
+ private:
+  friend class Headless;
+
+  BankMode bank_mode_ = BankMode::Share;
+  std::vector<u8> bytes_;
+  std::vector<std::shared_ptr<const void>> banks_;
+  std::unique_ptr<Cartridge> cartridge_; // never mapped, only shares its ROM with forks
+  ExecutionMode mode_ = ExecutionMode::Interpreter;
+#ifndef STEP_EVERY_INSTRUCTION
+  std::shared_ptr<RecompiledCode> recompiled_;
+#endif
+};
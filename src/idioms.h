@@ -0,0 +1,53 @@
+#pragma once
+
+#include "util.h"
+#include <array>
+
+// Copy and fill loops that games use for level loads and VRAM uploads, they are
+// recognized by their bytes at the loop head and run natively by CPU::RunIdiom.
+
+enum class LoopIdiom : u8 {
+  None,
+  CopyHLToDE, // ld a,[hl+]; ld [de],a; inc de; dec bc; ld a,b; or c; jr nz
+  CopyDEToHL, // ld a,[de]; ld [hl+],a; inc de; dec bc; ld a,b; or c; jr nz
+  FillIncrementB, // ld [hl+],a; dec b; jr nz
+  FillIncrementC, // ld [hl+],a; dec c; jr nz
+  FillDecrementB, // ld [hl-],a; dec b; jr nz
+  FillDecrementC, // ld [hl-],a; dec c; jr nz
+};
+
+struct LoopPattern {
+  LoopIdiom idiom;
+  u8 length;
+  std::array<u8, 8> bytes;
+  u8 instructions; // per iteration, with the jump
+  u8 cycles; // per iteration when the jump is taken, the last one takes 4 less
+};
+
+inline constexpr LoopPattern kLoopPatterns[] = {
+    {LoopIdiom::CopyHLToDE, 8, {0x2A, 0x12, 0x13, 0x0B, 0x78, 0xB1, 0x20, 0xF8}, 7, 52},
+    {LoopIdiom::CopyHLToDE, 8, {0x2A, 0x12, 0x13, 0x0B, 0x79, 0xB0, 0x20, 0xF8}, 7, 52},
+    {LoopIdiom::CopyDEToHL, 8, {0x1A, 0x22, 0x13, 0x0B, 0x78, 0xB1, 0x20, 0xF8}, 7, 52},
+    {LoopIdiom::CopyDEToHL, 8, {0x1A, 0x22, 0x13, 0x0B, 0x79, 0xB0, 0x20, 0xF8}, 7, 52},
+    {LoopIdiom::FillIncrementB, 4, {0x22, 0x05, 0x20, 0xFC}, 3, 24},
+    {LoopIdiom::FillIncrementC, 4, {0x22, 0x0D, 0x20, 0xFC}, 3, 24},
+    {LoopIdiom::FillDecrementB, 4, {0x32, 0x05, 0x20, 0xFC}, 3, 24},
+    {LoopIdiom::FillDecrementC, 4, {0x32, 0x0D, 0x20, 0xFC}, 3, 24},
+};
+
+// pattern of the loop starting at code, available is the number of readable bytes
+inline const LoopPattern* MatchLoopIdiom(const u8* code, size_t available) {
+  for (const LoopPattern& pattern : kLoopPatterns) {
+    if (pattern.length > available) {
+      continue;
+    }
+    bool match = true;
+    for (u8 i = 0; i < pattern.length && match; i++) {
+      match = code[i] == pattern.bytes[i];
+    }
+    if (match) {
+      return &pattern;
+    }
+  }
+  return nullptr;
+}
@@ -1,9 +1,12 @@
 #pragma once
 
+#include "alu_tables.h"
 #include "cpu.h"
 #include "memory.h"
 #include "register.h"
 #include "debug.h"
+#include <new>
+#include <type_traits>
 
 enum class InstructionType {
   NOP,
@@ -62,7 +65,6 @@ struct Instruction {
   InstructionType type_;
 
   Instruction(InstructionType type) : type_(type) {}
-  virtual ~Instruction() = default;
 
   virtual int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) = 0;
 };
@@ -135,17 +137,15 @@ struct InstructionLoad : Instruction {
   }
 };
 
+template<ArithmeticTarget To, ArithmeticTarget From>
 struct InstructionLoadRegisterToRegister : Instruction {
-  ArithmeticTarget to_;
-  ArithmeticTarget from_;
-
   int cycles_;
 
-  InstructionLoadRegisterToRegister(ArithmeticTarget to, ArithmeticTarget from, int cycles)
-      : Instruction(InstructionType::LD), to_(to), from_(from), cycles_(cycles) {}
+  InstructionLoadRegisterToRegister(int cycles)
+      : Instruction(InstructionType::LD), cycles_(cycles) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    registers.Set(to_, registers.Get(from_));
+    registers.Set<To>(registers.Get<From>());
     return cycles_;
   }
 };
@@ -157,11 +157,11 @@ struct InstructionLoadHLSPImmediate : Instruction {
       : Instruction(InstructionType::LD), value_(value) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    u16 sp = registers.Get(ArithmeticTarget::SP);
+    u16 sp = registers.sp();
     u16 result = sp + value_;
-    registers.flags.v = 0;
-    registers.flags.f.half_carry = ((sp ^ value_ ^ result) & 0x10) == 0x10;
-    registers.flags.f.carry = ((sp ^ value_ ^ result) & 0x100) == 0x100;
+    registers.flags.FromByte(0);
+    registers.flags.half_carry(((sp ^ value_ ^ result) & 0x10) == 0x10);
+    registers.flags.carry(((sp ^ value_ ^ result) & 0x100) == 0x100);
     registers.Set(ArithmeticTarget::HL, result);
     return 12;
   }
@@ -215,7 +215,7 @@ struct InstructionLDH4 : Instruction {
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
     registers.Set(ArithmeticTarget::A, bus.Read(0xFF00 + offset_));
-    return 12;
+    return 8;
   }
 };
 
@@ -280,371 +280,104 @@ struct InstructionLoadToAddress : Instruction {
   }
 };
 
-struct InstructionRotateLeftCircular : Instruction {
-  ArithmeticTarget to_;
-  bool to_memory_;
-  bool set_zero_;
-
-  int cycles_;
-
-  InstructionRotateLeftCircular() : Instruction(InstructionType::RLCA), to_(ArithmeticTarget::A), set_zero_(false), to_memory_(false), cycles_(4) {}
-
-  InstructionRotateLeftCircular(ArithmeticTarget to, int cycles) : Instruction(InstructionType::RLC), to_(to), set_zero_(true), to_memory_(false), cycles_(cycles) {}
-
-  InstructionRotateLeftCircular(ArithmeticTarget to, bool to_memory, int cycles) : Instruction(InstructionType::RLC), to_(to), set_zero_(true), to_memory_(to_memory), cycles_(cycles) {}
-
-  int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    u16 rr = registers.Get(to_);
-    u8 value;
-    if (to_memory_) {
-      value = bus.Read(rr);
-    } else {
-      assert(!is_16bit_register(to_));
-      value = rr;
-    }
-    u16 t = (value << 1) + (value >> 7);
-    registers.flags.f.carry = t > 0xFF;
-    t &= 0xFF;
-    registers.flags.f.zero = set_zero_ && t == 0;
-    registers.flags.f.half_carry = false;
-    registers.flags.f.subtract = false;
-    if (to_memory_) {
-      bus.Write(rr, (u8)t);
-    } else {
-      registers.Set(to_, t);
-    }
-    return cycles_;
-  }
-};
-
-struct InstructionRotateRightCircular : Instruction {
-  ArithmeticTarget to_;
-  bool to_memory_;
-  bool set_zero_;
-
-  int cycles_;
-
-  InstructionRotateRightCircular() : Instruction(InstructionType::RRCA), to_(ArithmeticTarget::A), set_zero_(false), to_memory_(false), cycles_(4) {}
-
-  InstructionRotateRightCircular(ArithmeticTarget to, int cycles) : Instruction(InstructionType::RRC), to_(to), set_zero_(true), to_memory_(false), cycles_(cycles) {}
-
-  InstructionRotateRightCircular(ArithmeticTarget to, bool to_memory, int cycles) : Instruction(InstructionType::RRC), to_(to), set_zero_(true), to_memory_(to_memory), cycles_(cycles) {}
-
-  int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    u16 rr = registers.Get(to_);
-    u8 value;
-    if (to_memory_) {
-      value = bus.Read(rr);
-    } else {
-      assert(!is_16bit_register(to_));
-      value = rr;
-    }
-    u16 t = (value >> 1) + ((value & 1) << 7) + ((value & 1) << 8);
-    registers.flags.f.carry = t > 0xFF;
-    t &= 0xFF;
-    registers.flags.f.zero = set_zero_ && t == 0;
-    registers.flags.f.half_carry = false;
-    registers.flags.f.subtract = false;
-    if (to_memory_) {
-      bus.Write(rr, (u8)t);
-    } else {
-      registers.Set(to_, t);
-    }
-    return cycles_;
+constexpr InstructionType ShiftInstructionType(ShiftOp op) {
+  switch (op) {
+    case ShiftOp::RLC: return InstructionType::RLC;
+    case ShiftOp::RRC: return InstructionType::RRC;
+    case ShiftOp::RL: return InstructionType::RL;
+    case ShiftOp::RR: return InstructionType::RR;
+    case ShiftOp::SLA: return InstructionType::SLA;
+    case ShiftOp::SRA: return InstructionType::SRA;
+    case ShiftOp::SWAP: return InstructionType::SWAP;
+    case ShiftOp::SRL: return InstructionType::SRL;
   }
-};
-
-struct InstructionRotateLeft : Instruction {
-  ArithmeticTarget to_;
-  bool to_memory_;
-  bool set_zero_;
-
-  int cycles_;
+  return InstructionType::NOP;
+}
 
-  InstructionRotateLeft() : Instruction(InstructionType::RLA), to_(ArithmeticTarget::A), set_zero_(false), to_memory_(false), cycles_(4) {}
-
-  InstructionRotateLeft(ArithmeticTarget to, int cycles) : Instruction(InstructionType::RL), to_(to), set_zero_(true), to_memory_(false), cycles_(cycles) {}
-
-  InstructionRotateLeft(ArithmeticTarget to, bool to_memory, int cycles) : Instruction(InstructionType::RL), to_(to), set_zero_(true), to_memory_(to_memory), cycles_(cycles) {}
-
-  int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    u16 rr = registers.Get(to_);
-    u8 value;
-    if (to_memory_) {
-      value = bus.Read(rr);
-    } else {
-      assert(!is_16bit_register(to_));
-      value = rr;
-    }
-    u16 t = ((value << 1) + registers.flags.f.carry);
-    registers.flags.f.carry = t > 0xFF;
-    t &= 0xFF;
-    registers.flags.f.zero = set_zero_ && t == 0;
-    registers.flags.f.half_carry = false;
-    registers.flags.f.subtract = false;
-    if (to_memory_) {
-      bus.Write(rr, (u8)t);
-    } else {
-      registers.Set(to_, t);
-    }
-    return cycles_;
+// operand of the $CB page, a register or the byte at [HL]
+template<ArithmeticTarget Target, bool Memory>
+u8 ReadOperand(Registers& registers, MemoryBus& bus) {
+  if constexpr (Memory) {
+    return bus.Read(registers.Get<Target>());
+  } else {
+    static_assert(!is_16bit_register(Target));
+    return registers.Get<Target>();
   }
-};
-
-struct InstructionRotateRight : Instruction {
-  ArithmeticTarget to_;
-  bool to_memory_;
-  bool set_zero_;
-
-  int cycles_;
-
-  InstructionRotateRight() : Instruction(InstructionType::RRA), to_(ArithmeticTarget::A), set_zero_(false), to_memory_(false), cycles_(4) {}
-
-  InstructionRotateRight(ArithmeticTarget to, int cycles) : Instruction(InstructionType::RR), to_(to), set_zero_(true), to_memory_(false), cycles_(cycles) {}
-
-  InstructionRotateRight(ArithmeticTarget to, bool to_memory, int cycles) : Instruction(InstructionType::RR), to_(to), set_zero_(true), to_memory_(to_memory), cycles_(cycles) {}
-
-  int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    u16 rr = registers.Get(to_);
-    u8 value;
-    if (to_memory_) {
-      value = bus.Read(rr);
-    } else {
-      assert(!is_16bit_register(to_));
-      value = rr;
-    }
+}
 
-    u8 t = (value >> 1) + (registers.flags.f.carry << 7);
-    registers.flags.f.carry = value & 0x1;
-    registers.flags.f.zero = set_zero_ && t == 0;
-    registers.flags.f.half_carry = false;
-    registers.flags.f.subtract = false;
-    if (to_memory_) {
-      bus.Write(rr, (u8)t);
-    } else {
-      registers.Set(to_, t);
-    }
-    return cycles_;
+template<ArithmeticTarget Target, bool Memory>
+void WriteOperand(Registers& registers, MemoryBus& bus, u8 value) {
+  if constexpr (Memory) {
+    bus.Write(registers.Get<Target>(), value);
+  } else {
+    registers.Set<Target>(value);
   }
-};
+}
 
-struct InstructionShiftLeftArithmetic : Instruction {
-  ArithmeticTarget to_;
-  bool to_memory_;
-
-  int cycles_;
-
-  InstructionShiftLeftArithmetic(ArithmeticTarget to, int cycles) : Instruction(InstructionType::SLA), to_(to), to_memory_(false), cycles_(cycles) {}
-
-  InstructionShiftLeftArithmetic(ArithmeticTarget to, bool to_memory, int cycles) : Instruction(InstructionType::SLA), to_(to), to_memory_(to_memory), cycles_(cycles) {}
+// RLC, RRC, RL, RR, SLA, SRA, SWAP, SRL
+template<ShiftOp Op, ArithmeticTarget Target, bool Memory>
+struct InstructionShift : Instruction {
+  InstructionShift() : Instruction(ShiftInstructionType(Op)) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    u16 rr = registers.Get(to_);
-    u8 value;
-    if (to_memory_) {
-      value = bus.Read(rr);
-    } else {
-      assert(!is_16bit_register(to_));
-      value = rr;
-    }
-    registers.flags.f.carry = value >> 7;
-    value = value << 1;
-    registers.flags.f.zero = value == 0;
-    registers.flags.f.half_carry = false;
-    registers.flags.f.subtract = false;
-    if (to_memory_) {
-      bus.Write(rr, value);
-    } else {
-      registers.Set(to_, value);
-    }
-    return cycles_;
+    u8 value = ReadOperand<Target, Memory>(registers, bus);
+    u16 entry = kShiftTable<Op>[(registers.flags.carry() << 8) | value];
+    registers.flags.FromByte(entry & 0xFF);
+    WriteOperand<Target, Memory>(registers, bus, entry >> 8);
+    return Memory ? 16 : 8;
   }
 };
 
-struct InstructionShiftRightArithmetic : Instruction {
-  ArithmeticTarget to_;
-  bool to_memory_;
-
-  int cycles_;
-
-  InstructionShiftRightArithmetic(ArithmeticTarget to, int cycles) : Instruction(InstructionType::SRA), to_(to), to_memory_(false), cycles_(cycles) {}
+// RLCA, RRCA, RLA, RRA always clear the zero flag
+template<ShiftOp Op>
+struct InstructionRotateAccumulator : Instruction {
+  static_assert(Op == ShiftOp::RLC || Op == ShiftOp::RRC || Op == ShiftOp::RL || Op == ShiftOp::RR);
 
-  InstructionShiftRightArithmetic(ArithmeticTarget to, bool to_memory, int cycles) : Instruction(InstructionType::SRA), to_(to), to_memory_(to_memory), cycles_(cycles) {}
+  InstructionRotateAccumulator()
+      : Instruction(Op == ShiftOp::RLC ? InstructionType::RLCA : Op == ShiftOp::RRC ? InstructionType::RRCA :
+                    Op == ShiftOp::RL ? InstructionType::RLA : InstructionType::RRA) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    u16 rr = registers.Get(to_);
-    u8 value;
-    if (to_memory_) {
-      value = bus.Read(rr);
-    } else {
-      assert(!is_16bit_register(to_));
-      value = rr;
-    }
-    registers.flags.f.carry = value & 0x1;
-    value = (value >> 1) | (value & (1 << 7));
-    registers.flags.f.zero = value == 0;
-    registers.flags.f.half_carry = false;
-    registers.flags.f.subtract = false;
-    if (to_memory_) {
-      bus.Write(rr, value);
-    } else {
-      registers.Set(to_, value);
-    }
-    return cycles_;
-  }
-};
-
-struct InstructionShiftRightLogical : Instruction {
-  ArithmeticTarget to_;
-  bool to_memory_;
-
-  int cycles_;
-
-  InstructionShiftRightLogical(ArithmeticTarget to, int cycles) : Instruction(InstructionType::SRL), to_(to), to_memory_(false), cycles_(cycles) {}
-
-  InstructionShiftRightLogical(ArithmeticTarget to, bool to_memory, int cycles) : Instruction(InstructionType::SRL), to_(to), to_memory_(to_memory), cycles_(cycles) {}
-
-  int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    u16 rr = registers.Get(to_);
-    u8 value;
-    if (to_memory_) {
-      value = bus.Read(rr);
-    } else {
-      assert(!is_16bit_register(to_));
-      value = rr;
-    }
-    registers.flags.f.carry = value & 0x1;
-    value = value >> 1;
-    registers.flags.f.zero = value == 0;
-    registers.flags.f.half_carry = false;
-    registers.flags.f.subtract = false;
-    if (to_memory_) {
-      bus.Write(rr, value);
-    } else {
-      registers.Set(to_, value);
-    }
-    return cycles_;
-  }
-};
-
-struct InstructionSwap : Instruction {
-  ArithmeticTarget to_;
-  bool to_memory_;
-
-  int cycles_;
-
-  InstructionSwap(ArithmeticTarget to, int cycles) : Instruction(InstructionType::SWAP), to_(to), to_memory_(false), cycles_(cycles) {}
-
-  InstructionSwap(ArithmeticTarget to, bool to_memory, int cycles) : Instruction(InstructionType::SWAP), to_(to), to_memory_(to_memory), cycles_(cycles) {}
-
-  int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    u16 rr = registers.Get(to_);
-    u8 value;
-    if (to_memory_) {
-      value = bus.Read(rr);
-    } else {
-      assert(!is_16bit_register(to_));
-      value = rr;
-    }
-    u8 upper = value >> 4;
-    u8 lower = value & 0x0F;
-    value = (lower << 4) | upper;
-    registers.flags.f.zero = value == 0;
-    registers.flags.f.carry = false;
-    registers.flags.f.half_carry = false;
-    registers.flags.f.subtract = false;
-    if (to_memory_) {
-      bus.Write(rr, value);
-    } else {
-      registers.Set(to_, value);
-    }
-    return cycles_;
+    u8 value = registers.Get<ArithmeticTarget::A>();
+    u16 entry = kShiftTable<Op>[(registers.flags.carry() << 8) | value];
+    registers.flags.FromByte(entry & kFlagCarry);
+    registers.Set<ArithmeticTarget::A>(entry >> 8);
+    return 4;
   }
 };
 
+template<u8 Bit, ArithmeticTarget Target, bool Memory>
 struct InstructionBit : Instruction {
-  ArithmeticTarget to_;
-  bool to_memory_;
-  u8 bit_;
-
-  int cycles_;
-
-  InstructionBit(u8 bit, ArithmeticTarget to, int cycles) : Instruction(InstructionType::BIT), bit_(bit), to_(to), to_memory_(false), cycles_(cycles) {}
-
-  InstructionBit(u8 bit, ArithmeticTarget to, bool to_memory, int cycles) : Instruction(InstructionType::BIT), bit_(bit), to_(to), to_memory_(to_memory), cycles_(cycles) {}
+  InstructionBit() : Instruction(InstructionType::BIT) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    u8 value;
-    if (to_memory_) {
-      value = bus.Read(registers.Get(to_));
-    } else {
-      assert(!is_16bit_register(to_));
-      value = registers.Get(to_);
-    }
-    registers.flags.f.zero = (value & (1 << bit_)) == 0;
-    registers.flags.f.half_carry = true;
-    registers.flags.f.subtract = false;
-    return cycles_;
+    u8 value = ReadOperand<Target, Memory>(registers, bus);
+    registers.flags.zero((value & (1 << Bit)) == 0);
+    registers.flags.half_carry(true);
+    registers.flags.subtract(false);
+    return Memory ? 12 : 8;
   }
 };
 
+template<u8 Bit, ArithmeticTarget Target, bool Memory>
 struct InstructionSet : Instruction {
-  ArithmeticTarget to_;
-  bool to_memory_;
-  u8 bit_;
-  
-  int cycles_;
-
-  InstructionSet(u8 bit, ArithmeticTarget to, int cycles) : Instruction(InstructionType::SET), bit_(bit), to_(to), to_memory_(false), cycles_(cycles) {}
-
-  InstructionSet(u8 bit, ArithmeticTarget to, bool to_memory, int cycles) : Instruction(InstructionType::SET), bit_(bit), to_(to), to_memory_(to_memory), cycles_(cycles) {}
+  InstructionSet() : Instruction(InstructionType::SET) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    u16 rr = registers.Get(to_);
-    u8 value;
-    if (to_memory_) {
-      value = bus.Read(rr);
-    } else {
-      assert(!is_16bit_register(to_));
-      value = rr;
-    }
-    value |= (1 << bit_);
-    if (to_memory_) {
-      bus.Write(rr, value);
-    } else {
-      registers.Set(to_, value);
-    }
-    return cycles_;
+    u8 value = ReadOperand<Target, Memory>(registers, bus);
+    WriteOperand<Target, Memory>(registers, bus, value | (1 << Bit));
+    return Memory ? 16 : 8;
   }
 };
 
+template<u8 Bit, ArithmeticTarget Target, bool Memory>
 struct InstructionRes : Instruction {
-  ArithmeticTarget to_;
-  bool to_memory_;
-  u8 bit_;
-  
-  int cycles_;
-  
-  InstructionRes(u8 bit, ArithmeticTarget to, int cycles) : Instruction(InstructionType::RES), bit_(bit), to_(to), to_memory_(false), cycles_(cycles) {}
-
-  InstructionRes(u8 bit, ArithmeticTarget to, bool to_memory, int cycles) : Instruction(InstructionType::RES), bit_(bit), to_(to), to_memory_(to_memory), cycles_(cycles) {}
+  InstructionRes() : Instruction(InstructionType::RES) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    u16 rr = registers.Get(to_);
-    u8 value;
-    if (to_memory_) {
-      value = bus.Read(rr);
-    } else {
-      assert(!is_16bit_register(to_));
-      value = rr;
-    }
-    value &= ~(1 << bit_);
-    if (to_memory_) {
-      bus.Write(rr, value);
-    } else {
-      registers.Set(to_, value);
-    }
-    return cycles_;
+    u8 value = ReadOperand<Target, Memory>(registers, bus);
+    WriteOperand<Target, Memory>(registers, bus, value & ~(1 << Bit));
+    return Memory ? 16 : 8;
   }
 };
 
@@ -692,7 +425,7 @@ struct InstructionDec : Instruction {
   IncDecOperandType to_type_;
   int cycles_;
 
-  InstructionDec(ArithmeticTarget to, int cycles) : Instruction(InstructionType::DEC), to_(to), cycles_(cycles) {}
+  InstructionDec(ArithmeticTarget to, int cycles) : Instruction(InstructionType::DEC), to_(to), to_type_(IncDecOperandType::REGISTER), cycles_(cycles) {}
 
   InstructionDec(ArithmeticTarget to, IncDecOperandType to_type, int cycles) : Instruction(InstructionType::DEC), to_(to), to_type_(to_type), cycles_(cycles) {}
 
@@ -714,34 +447,31 @@ struct InstructionDec : Instruction {
   }
 };
 
+template<ArithmeticTarget To, ArithmeticTarget From, bool FromMemory>
 struct InstructionAdd : Instruction {
-  ArithmeticTarget to_;
-  ArithmeticTarget from_;
-  bool from_memory_;
-
   int cycles_;
 
-  InstructionAdd(ArithmeticTarget to, ArithmeticTarget from, bool from_memory, int cycles) : Instruction(InstructionType::ADD), to_(to), from_(from), from_memory_(from_memory), cycles_(cycles) {}
+  InstructionAdd(int cycles) : Instruction(InstructionType::ADD), cycles_(cycles) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
     u16 value;
-    if (from_memory_) {
-      value = bus.Read(registers.Get(from_));
+    if constexpr (FromMemory) {
+      value = bus.Read(registers.Get<From>());
     } else {
-      value = registers.Get(from_);
+      value = registers.Get<From>();
     }
-    if (is_16bit_register(to_)) {
-      u16 first = registers.Get(to_);
+    if constexpr (is_16bit_register(To)) {
+      u16 first = registers.Get<To>();
       u16 second = value;
       u32 temp_result = (u32)first + (u32)second;
       u16 result = temp_result & 0xFFFF;
-      registers.flags.f.subtract = false;
-      registers.flags.f.carry = temp_result > 0xFFFF;
-      registers.flags.f.half_carry = ((first & 0xfff) + (second & 0xfff)) & 0x1000;
-      registers.Set(to_, result);
+      registers.flags.subtract(false);
+      registers.flags.carry(temp_result > 0xFFFF);
+      registers.flags.half_carry(((first & 0xfff) + (second & 0xfff)) & 0x1000);
+      registers.Set<To>(result);
     } else {
-      u8 result = alu.Add(registers.Get(to_), value);
-      registers.Set(to_, result);
+      u8 result = alu.Add(registers.Get<To>(), value);
+      registers.Set<To>(result);
     }
     return cycles_;
   }
@@ -769,12 +499,12 @@ struct InstructionAddSPImmediate : Instruction {
   InstructionAddSPImmediate(s8 value) : Instruction(InstructionType::ADD), offset_(value) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    u32 rr = registers.Get(ArithmeticTarget::SP);
+    u32 rr = registers.sp();
     u32 result = rr + offset_;
-    registers.flags.f.zero = false;
-    registers.flags.f.subtract = false;
-    registers.flags.f.half_carry = ((rr & 0x0F) + (offset_ & 0x0F)) > 0x0F;
-    registers.flags.f.carry = ((rr & 0xFF) + (offset_ & 0xFF)) > 0xFF;
+    registers.flags.zero(false);
+    registers.flags.subtract(false);
+    registers.flags.half_carry(((rr & 0x0F) + (offset_ & 0x0F)) > 0x0F);
+    registers.flags.carry(((rr & 0xFF) + (offset_ & 0xFF)) > 0xFF);
     registers.Set(ArithmeticTarget::SP, result);
     return 16;
   }
@@ -793,32 +523,31 @@ struct InstructionRestart : Instruction {
     }
     //std::cout << "restart: " << ToHex(Debugger::GetCurrentInstruction()) << std::endl;
 #endif
+    EMIT_CALL(registers.pc, registers.sp(), value_, false);
+    PROFILE_CALL(cpu, registers.pc, value_);
     cpu.Push(registers.pc);
     registers.pc = value_;
     return 16;
   }
 };
 
+template<ArithmeticTarget To, ArithmeticTarget From, bool FromMemory>
 struct InstructionAddCarry : Instruction {
-  ArithmeticTarget to_;
-  ArithmeticTarget from_;
-  bool from_memory_;
-
   int cycles_;
 
-  InstructionAddCarry(ArithmeticTarget to, ArithmeticTarget from, bool from_memory, int cycles) : Instruction(InstructionType::ADC), to_(to), from_(from), from_memory_(from_memory), cycles_(cycles) {}
+  InstructionAddCarry(int cycles) : Instruction(InstructionType::ADC), cycles_(cycles) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
     u8 value;
-    if (from_memory_) {
-      value = bus.Read(registers.Get(from_));
+    if constexpr (FromMemory) {
+      value = bus.Read(registers.Get<From>());
     } else {
-      assert(!is_16bit_register(from_));
-      value = registers.Get(from_);
+      assert(!is_16bit_register(From));
+      value = registers.Get<From>();
     }
-    assert(!is_16bit_register(to_));
-    u8 result = alu.AddWithCarry((u8) registers.Get(to_), value);
-    registers.Set(to_, result);
+    assert(!is_16bit_register(To));
+    u8 result = alu.AddWithCarry((u8) registers.Get<To>(), value);
+    registers.Set<To>(result);
     return cycles_;
   }
 };
@@ -839,26 +568,23 @@ struct InstructionAddCarryImmediate : Instruction {
   }
 };
 
+template<ArithmeticTarget To, ArithmeticTarget From, bool FromMemory>
 struct InstructionSub : Instruction {
-  ArithmeticTarget to_;
-  ArithmeticTarget from_;
-  bool from_memory_;
-
   int cycles_;
 
-  InstructionSub(ArithmeticTarget to, ArithmeticTarget from, bool from_memory, int cycles) : Instruction(InstructionType::SUB), to_(to), from_(from), from_memory_(from_memory), cycles_(cycles) {}
+  InstructionSub(int cycles) : Instruction(InstructionType::SUB), cycles_(cycles) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    assert(!is_16bit_register(to_));
+    assert(!is_16bit_register(To));
     u8 value;
-    if (from_memory_) {
-      value = bus.Read(registers.Get(from_));
+    if constexpr (FromMemory) {
+      value = bus.Read(registers.Get<From>());
     } else {
-      assert(!is_16bit_register(from_));
-      value = registers.Get(from_);
+      assert(!is_16bit_register(From));
+      value = registers.Get<From>();
     }
-    u8 result = alu.Sub(registers.Get(to_), value);
-    registers.Set(to_, result);
+    u8 result = alu.Sub(registers.Get<To>(), value);
+    registers.Set<To>(result);
     return cycles_;
   }
 };
@@ -879,25 +605,22 @@ struct InstructionSubImmediate : Instruction {
   }
 };
 
+template<ArithmeticTarget To, ArithmeticTarget From, bool FromMemory>
 struct InstructionSubCarry : Instruction {
-  ArithmeticTarget to_;
-  ArithmeticTarget from_;
-  bool from_memory_;
-
   int cycles_;
 
-  InstructionSubCarry(ArithmeticTarget to, ArithmeticTarget from, bool from_memory, int cycles) : Instruction(InstructionType::SBC), to_(to), from_(from), from_memory_(from_memory), cycles_(cycles) {}
+  InstructionSubCarry(int cycles) : Instruction(InstructionType::SBC), cycles_(cycles) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
     u16 value;
-    if (from_memory_) {
-      value = bus.Read(registers.Get(from_));
+    if constexpr (FromMemory) {
+      value = bus.Read(registers.Get<From>());
     } else {
-      value = registers.Get(from_);
+      value = registers.Get<From>();
     }
-    assert(!is_16bit_register(to_));
-    u8 result = alu.SubWithCarry((u8) registers.Get(to_), value);
-    registers.Set(to_, result);
+    assert(!is_16bit_register(To));
+    u8 result = alu.SubWithCarry((u8) registers.Get<To>(), value);
+    registers.Set<To>(result);
     return cycles_;
   }
 };
@@ -918,28 +641,25 @@ struct InstructionSubCarryImmediate : Instruction {
   }
 };
 
+template<ArithmeticTarget To, ArithmeticTarget From, bool FromMemory>
 struct InstructionAnd : Instruction {
-  ArithmeticTarget to_;
-  ArithmeticTarget from_;
-  bool from_memory_;
-
   int cycles_;
 
-  InstructionAnd(ArithmeticTarget to, ArithmeticTarget from, bool from_memory, int cycles) : Instruction(InstructionType::AND), to_(to), from_(from), from_memory_(from_memory), cycles_(cycles) {}
+  InstructionAnd(int cycles) : Instruction(InstructionType::AND), cycles_(cycles) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
     u16 value;
-    if (from_memory_) {
-      value = bus.Read(registers.Get(from_));
+    if constexpr (FromMemory) {
+      value = bus.Read(registers.Get<From>());
     } else {
-      value = registers.Get(from_);
+      value = registers.Get<From>();
     }
-    u16 result = registers.Get(to_) & value;
-    registers.Set(to_, result);
-    registers.flags.f.zero = result == 0;
-    registers.flags.f.subtract = false;
-    registers.flags.f.half_carry = true;
-    registers.flags.f.carry = false;
+    u16 result = registers.Get<To>() & value;
+    registers.Set<To>(result);
+    registers.flags.zero(result == 0);
+    registers.flags.subtract(false);
+    registers.flags.half_carry(true);
+    registers.flags.carry(false);
     return cycles_;
   }
 };
@@ -955,38 +675,35 @@ struct InstructionAndImmediate : Instruction {
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
     u16 result = registers.Get(to_) & value_;
     registers.Set(to_, result);
-    registers.flags.f.zero = result == 0;
-    registers.flags.f.subtract = false;
-    registers.flags.f.half_carry = true;
-    registers.flags.f.carry = false;
+    registers.flags.zero(result == 0);
+    registers.flags.subtract(false);
+    registers.flags.half_carry(true);
+    registers.flags.carry(false);
     return cycles_;
   }
 };
 
+template<ArithmeticTarget To, ArithmeticTarget From, bool FromMemory>
 struct InstructionXOR : Instruction {
-  ArithmeticTarget to_;
-  ArithmeticTarget from_;
-  bool from_memory_;
-
   int cycles_;
 
-  InstructionXOR(ArithmeticTarget to, ArithmeticTarget from, bool from_memory, int cycles) : Instruction(InstructionType::XOR), to_(to), from_(from), from_memory_(from_memory), cycles_(cycles) {}
+  InstructionXOR(int cycles) : Instruction(InstructionType::XOR), cycles_(cycles) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    assert(!is_16bit_register(to_));
+    assert(!is_16bit_register(To));
     u8 value;
-    if (from_memory_) {
-      value = bus.Read(registers.Get(from_));
+    if constexpr (FromMemory) {
+      value = bus.Read(registers.Get<From>());
     } else {
-      assert(!is_16bit_register(from_));
-      value = registers.Get(from_);
+      assert(!is_16bit_register(From));
+      value = registers.Get<From>();
     }
-    u8 result = registers.Get(to_) ^ value;
-    registers.Set(to_, result);
-    registers.flags.f.zero = result == 0;
-    registers.flags.f.subtract = false;
-    registers.flags.f.half_carry = false;
-    registers.flags.f.carry = false;
+    u8 result = registers.Get<To>() ^ value;
+    registers.Set<To>(result);
+    registers.flags.zero(result == 0);
+    registers.flags.subtract(false);
+    registers.flags.half_carry(false);
+    registers.flags.carry(false);
     return cycles_;
   }
 };
@@ -1003,38 +720,35 @@ struct InstructionXORImmediate : Instruction {
     assert(!is_16bit_register(to_));
     u8 result = registers.Get(to_) ^ value_;
     registers.Set(to_, result);
-    registers.flags.f.zero = result == 0;
-    registers.flags.f.subtract = false;
-    registers.flags.f.half_carry = false;
-    registers.flags.f.carry = false;
+    registers.flags.zero(result == 0);
+    registers.flags.subtract(false);
+    registers.flags.half_carry(false);
+    registers.flags.carry(false);
     return cycles_;
   }
 };
 
+template<ArithmeticTarget To, ArithmeticTarget From, bool FromMemory>
 struct InstructionOr : Instruction {
-  ArithmeticTarget to_;
-  ArithmeticTarget from_;
-  bool from_memory_;
-
   int cycles_;
 
-  InstructionOr(ArithmeticTarget to, ArithmeticTarget from, bool from_memory, int cycles) : Instruction(InstructionType::OR), to_(to), from_(from), from_memory_(from_memory), cycles_(cycles) {}
+  InstructionOr(int cycles) : Instruction(InstructionType::OR), cycles_(cycles) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    assert(!is_16bit_register(to_));
+    assert(!is_16bit_register(To));
     u8 value;
-    if (from_memory_) {
-      value = bus.Read(registers.Get(from_));
+    if constexpr (FromMemory) {
+      value = bus.Read(registers.Get<From>());
     } else {
-      assert(!is_16bit_register(from_));
-      value = registers.Get(from_);
+      assert(!is_16bit_register(From));
+      value = registers.Get<From>();
     }
-    u8 result = registers.Get(to_) | value;
-    registers.Set(to_, result);
-    registers.flags.f.zero = result == 0;
-    registers.flags.f.subtract = false;
-    registers.flags.f.half_carry = false;
-    registers.flags.f.carry = false;
+    u8 result = registers.Get<To>() | value;
+    registers.Set<To>(result);
+    registers.flags.zero(result == 0);
+    registers.flags.subtract(false);
+    registers.flags.half_carry(false);
+    registers.flags.carry(false);
     return cycles_;
   }
 };
@@ -1051,33 +765,30 @@ struct InstructionOrImmediate : Instruction {
     assert(!is_16bit_register(to_));
     u16 result = registers.Get(to_) | value_;
     registers.Set(to_, result);
-    registers.flags.f.zero = result == 0;
-    registers.flags.f.subtract = false;
-    registers.flags.f.half_carry = false;
-    registers.flags.f.carry = false;
+    registers.flags.zero(result == 0);
+    registers.flags.subtract(false);
+    registers.flags.half_carry(false);
+    registers.flags.carry(false);
     return cycles_;
   }
 };
 
+template<ArithmeticTarget To, ArithmeticTarget From, bool FromMemory>
 struct InstructionCompare : Instruction {
-  ArithmeticTarget to_;
-  ArithmeticTarget from_;
-  bool from_memory_;
-
   int cycles_;
 
-  InstructionCompare(ArithmeticTarget to, ArithmeticTarget from, bool from_memory, int cycles) : Instruction(InstructionType::CP), to_(to), from_(from), from_memory_(from_memory), cycles_(cycles) {}
+  InstructionCompare(int cycles) : Instruction(InstructionType::CP), cycles_(cycles) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    assert(!is_16bit_register(to_));
+    assert(!is_16bit_register(To));
     u8 value;
-    if (from_memory_) {
-      value = bus.Read(registers.Get(from_));
+    if constexpr (FromMemory) {
+      value = bus.Read(registers.Get<From>());
     } else {
-      assert(!is_16bit_register(from_));
-      value = registers.Get(from_);
+      assert(!is_16bit_register(From));
+      value = registers.Get<From>();
     }
-    u8 original = registers.Get(to_);
+    u8 original = registers.Get<To>();
     alu.Sub(original, value);
     return cycles_;
   }
@@ -1094,10 +805,10 @@ struct InstructionCompareImmediate : Instruction {
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
     assert(!is_16bit_register(to_));
     u8 original = registers.Get(to_);
-    registers.flags.f.zero = original == value_;
-    registers.flags.f.subtract = true;
-    registers.flags.f.half_carry = (original & 0xF) < (value_ & 0xF);
-    registers.flags.f.carry = original < value_;
+    registers.flags.zero(original == value_);
+    registers.flags.subtract(true);
+    registers.flags.half_carry((original & 0xF) < (value_ & 0xF));
+    registers.flags.carry(original < value_);
     return cycles_;
   }
 };
@@ -1108,7 +819,7 @@ struct InstructionJumpRelative : Instruction {
   InstructionJumpRelative(s8 value) : Instruction(InstructionType::JR), value_(value) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    EMIT_JUMP_RELATIVE(registers.pc, registers.sp, value_);
+    EMIT_JUMP_RELATIVE(registers.pc, registers.sp(), value_);
     registers.pc = (registers.pc + value_) & 0xFFFF;
     return 12;
   }
@@ -1121,8 +832,8 @@ struct InstructionJumpRelativeIfZero : Instruction {
   InstructionJumpRelativeIfZero(s8 value, bool is_not) : Instruction(InstructionType::JR), value_(value), is_not_(is_not) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    if (registers.flags.f.zero != is_not_) {
-      EMIT_JUMP_RELATIVE(registers.pc, registers.sp, value_);
+    if (registers.flags.zero() != is_not_) {
+      EMIT_JUMP_RELATIVE(registers.pc, registers.sp(), value_);
       registers.pc = (registers.pc + value_) & 0xFFFF;
       return 12;
     }
@@ -1137,8 +848,8 @@ struct InstructionJumpRelativeIfCarry : Instruction {
   InstructionJumpRelativeIfCarry(s8 value, bool is_not) : Instruction(InstructionType::JR), value_(value), is_not_(is_not) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    if (registers.flags.f.carry != is_not_) {
-      EMIT_JUMP_RELATIVE(registers.pc, registers.sp, value_);
+    if (registers.flags.carry() != is_not_) {
+      EMIT_JUMP_RELATIVE(registers.pc, registers.sp(), value_);
       registers.pc = (registers.pc + value_) & 0xFFFF;
       return 12;
     }
@@ -1152,12 +863,24 @@ struct InstructionJump : Instruction {
   InstructionJump(u16 value) : Instruction(InstructionType::JP), value_(value) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    EMIT_JUMP(registers.pc, registers.sp, value_);
+    EMIT_JUMP(registers.pc, registers.sp(), value_);
     registers.pc = value_;
     return 16;
   }
 };
 
+struct InstructionJumpHL : Instruction {
+
+  InstructionJumpHL() : Instruction(InstructionType::JP) {}
+
+  int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
+    u16 value = registers.Get<ArithmeticTarget::HL>();
+    EMIT_JUMP(registers.pc, registers.sp(), value);
+    registers.pc = value;
+    return 4;
+  }
+};
+
 struct InstructionJumpIfZero : Instruction {
   u16 value_;
   bool is_not_;
@@ -1165,8 +888,8 @@ struct InstructionJumpIfZero : Instruction {
   InstructionJumpIfZero(u16 value, bool is_not) : Instruction(InstructionType::JP), value_(value), is_not_(is_not) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    if (registers.flags.f.zero != is_not_) {
-      EMIT_JUMP(registers.pc, registers.sp, value_);
+    if (registers.flags.zero() != is_not_) {
+      EMIT_JUMP(registers.pc, registers.sp(), value_);
       registers.pc = value_;
       return 16;
     }
@@ -1181,8 +904,8 @@ struct InstructionJumpIfCarry : Instruction {
   InstructionJumpIfCarry(u16 value, bool is_not) : Instruction(InstructionType::JP), value_(value), is_not_(is_not) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    if (registers.flags.f.carry != is_not_) {
-      EMIT_JUMP(registers.pc, registers.sp, value_);
+    if (registers.flags.carry() != is_not_) {
+      EMIT_JUMP(registers.pc, registers.sp(), value_);
       registers.pc = value_;
       return 16;
     }
@@ -1196,7 +919,8 @@ struct InstructionCall : Instruction {
   explicit InstructionCall(u16 value) : Instruction(InstructionType::CALL), value_(value) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    EMIT_CALL(registers.pc, registers.sp, value_, false);
+    EMIT_CALL(registers.pc, registers.sp(), value_, false);
+    PROFILE_CALL(cpu, registers.pc, value_);
     cpu.Push(registers.pc);
     registers.pc = value_;
     return 24;
@@ -1210,8 +934,9 @@ struct InstructionCallIfZero : Instruction {
   InstructionCallIfZero(u16 value, bool is_not) : Instruction(InstructionType::CALL), value_(value), is_not_(is_not) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    if (registers.flags.f.zero != is_not_) {
-      EMIT_CALL(registers.pc, registers.sp, value_, false);
+    if (registers.flags.zero() != is_not_) {
+      EMIT_CALL(registers.pc, registers.sp(), value_, false);
+      PROFILE_CALL(cpu, registers.pc, value_);
       cpu.Push(registers.pc);
       registers.pc = value_;
       return 24;
@@ -1227,8 +952,9 @@ struct InstructionCallIfCarry : Instruction {
   InstructionCallIfCarry(u16 value, bool is_not) : Instruction(InstructionType::CALL), value_(value), is_not_(is_not) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    if (registers.flags.f.carry != is_not_) {
-      EMIT_CALL(registers.pc, registers.sp, value_, false);
+    if (registers.flags.carry() != is_not_) {
+      EMIT_CALL(registers.pc, registers.sp(), value_, false);
+      PROFILE_CALL(cpu, registers.pc, value_);
       cpu.Push(registers.pc);
       registers.pc = value_;
       return 24;
@@ -1243,19 +969,11 @@ struct InstructionDAA : Instruction {
   InstructionDAA() : Instruction(InstructionType::DAA) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    u16 a = registers.a;
-    s8 add = 0;
-    if ((!registers.flags.f.subtract && (a & 0xf) > 0x9) || registers.flags.f.half_carry){
-      add |= 0x6;
-    }
-    if ((!registers.flags.f.subtract && a > 0x99) || registers.flags.f.carry) {
-      add |= 0x60;
-      registers.flags.f.carry = true;
-    }
-    a += registers.flags.f.subtract ? -add : add;
-    registers.flags.f.zero = a == 0;
-    registers.flags.f.half_carry = false;
-    registers.a = a;
+    u16 index = (registers.flags.subtract() << 10) | (registers.flags.half_carry() << 9) |
+                (registers.flags.carry() << 8) | registers.Get<ArithmeticTarget::A>();
+    u16 entry = kDAATable[index];
+    registers.flags.FromByte(entry & 0xFF);
+    registers.Set<ArithmeticTarget::A>(entry >> 8);
     return 4;
   }
 };
@@ -1266,9 +984,9 @@ struct InstructionComplement : Instruction {
   InstructionComplement() : Instruction(InstructionType::CPL) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    registers.a = 0xFF ^ registers.a;
-    registers.flags.f.subtract = true;
-    registers.flags.f.half_carry = true;
+    registers.Set<ArithmeticTarget::A>(0xFF ^ registers.Get<ArithmeticTarget::A>());
+    registers.flags.subtract(true);
+    registers.flags.half_carry(true);
     return 4;
   }
 };
@@ -1278,9 +996,9 @@ struct InstructionComplementCarryFlag : Instruction {
   InstructionComplementCarryFlag() : Instruction(InstructionType::CCF) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    registers.flags.f.carry = !registers.flags.f.carry;
-    registers.flags.f.subtract = false;
-    registers.flags.f.half_carry = false;
+    registers.flags.carry(!registers.flags.carry());
+    registers.flags.subtract(false);
+    registers.flags.half_carry(false);
     return 4;
   }
 };
@@ -1290,9 +1008,9 @@ struct InstructionSetCarryFlag : Instruction {
   InstructionSetCarryFlag() : Instruction(InstructionType::SCF) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    registers.flags.f.carry = true;
-    registers.flags.f.subtract = false;
-    registers.flags.f.half_carry = false;
+    registers.flags.carry(true);
+    registers.flags.subtract(false);
+    registers.flags.half_carry(false);
     return 4;
   }
 };
@@ -1314,12 +1032,13 @@ struct InstructionReturn : Instruction {
   InstructionReturn(bool from_interrupt) : Instruction(from_interrupt ? InstructionType::RETI : InstructionType::RET), from_interrupt_(from_interrupt) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    u16 sp = registers.sp;
+    u16 sp = registers.sp();
     u16 return_address = cpu.Pop();
     EMIT_RET(registers.pc, sp, return_address, from_interrupt_);
+    PROFILE_RET(return_address);
     registers.pc = return_address;
     if (from_interrupt_) {
-      cpu.SetInterruptMasterEnable(true);
+      cpu.SetInterruptMasterEnable(true, true);
     }
     return 16;
   }
@@ -1332,9 +1051,10 @@ struct InstructionReturnIfZero : Instruction {
   InstructionReturnIfZero(bool is_not) : Instruction(InstructionType::RET), is_not_(is_not) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    if (registers.flags.f.zero != is_not_) {
+    if (registers.flags.zero() != is_not_) {
       u16 return_address = cpu.Pop();
-      EMIT_RET(registers.pc, registers.sp, return_address, false);
+      EMIT_RET(registers.pc, registers.sp(), return_address, false);
+      PROFILE_RET(return_address);
       registers.pc = return_address;
       return 20;
     }
@@ -1349,9 +1069,10 @@ struct InstructionReturnIfCarry : Instruction {
   InstructionReturnIfCarry(bool is_not) : Instruction(InstructionType::RET), is_not_(is_not) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    if (registers.flags.f.carry != is_not_) {
+    if (registers.flags.carry() != is_not_) {
       u16 return_address = cpu.Pop();
-      EMIT_RET(registers.pc, registers.sp, return_address, false);
+      EMIT_RET(registers.pc, registers.sp(), return_address, false);
+      PROFILE_RET(return_address);
       registers.pc = return_address;
       return 20;
     }
@@ -1379,8 +1100,8 @@ struct InstructionPopAF : Instruction {
     u16 value = cpu.Pop();
     // A        F
     // 00000000 00000000
-    registers.a = value >> 8;
-    registers.flags.v = value & 0xF0;
+    registers.Set<ArithmeticTarget::A>(value >> 8);
+    registers.flags.FromByte(value & 0xF0);
     return 12;
   }
 };
@@ -1402,7 +1123,7 @@ struct InstructionPushAF : Instruction {
   InstructionPushAF() : Instruction(InstructionType::PUSH) {}
 
   int Execute(CPU& cpu, ALU& alu, Registers& registers, MemoryBus& bus) override {
-    u16 af = ((u16)registers.a << 8) | registers.flags.v;
+    u16 af = ((u16)registers.Get<ArithmeticTarget::A>() << 8) | registers.flags.ToByte();
     cpu.Push(af);
     return 16;
   }
@@ -1428,7 +1149,16 @@ struct InstructionEnableInterrupt : Instruction {
   }
 };
 
+template<typename T, typename... Args>
+Instruction* InstructionBuffer::Emplace(Args&&... args) {
+  static_assert(sizeof(T) <= kSize && alignof(T) <= alignof(std::max_align_t), "InstructionBuffer::kSize is too small");
+  // the previous instruction is overwritten without running its destructor
+  static_assert(std::is_trivially_destructible_v<T>);
+  return new (storage_) T(std::forward<Args>(args)...);
+}
+
 // Extended ($CB prefixed)
-std::unique_ptr<Instruction> FetchPrefixed(ALU& alu, Registers& registers, MemoryBus& bus);
+Instruction* FetchPrefixed(InstructionBuffer& buffer, ALU& alu, Registers& registers, MemoryBus& bus);
 
-std::unique_ptr<Instruction> Fetch(ALU& alu, Registers& registers, MemoryBus& bus);
\ No newline at end of file
+// decodes the instruction at the PC into buffer, valid until the next fetch into it
+Instruction* Fetch(InstructionBuffer& buffer, ALU& alu, Registers& registers, MemoryBus& bus, bool halt_bug = false);
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "instrument.h"
+#include <fstream>
+#include <mutex>
+
+#ifdef ENABLE_INSTRUMENTATION
+
+namespace Instrument {
+
+// events each thread keeps per capture, the rest are counted as dropped
+static constexpr size_t kCapacity = 1 << 21; // 64MiB
+
+struct Event {
+  const char* name;
+  u64 time;
+  s64 value; // the duration of zones in ns
+  bool counter;
+};
+
+// the owning thread appends and publishes size, the writer only reads what was
+// published, the storage is allocated by the first capture and never moves
+struct ThreadBuffer {
+  u32 id;
+  std::string name;
+  std::atomic<u32> generation = 0;
+  std::unique_ptr<Event[]> events;
+  std::atomic<size_t> size = 0;
+  std::atomic<u64> dropped = 0;
+  std::vector<Counter*> counters;
+};
+
+std::atomic<bool> capturing_ = false;
+// bumped by Start, a thread empties its buffer when it sees a new one
+static std::atomic<u32> generation_ = 0;
+static u64 start_time_ = 0;
+
+// buffers outlive their threads so a capture can still be written after they exit
+static std::mutex mutex_;
+static std::vector<std::unique_ptr<ThreadBuffer>> buffers_;
+static thread_local ThreadBuffer* buffer_ = nullptr;
+
+static ThreadBuffer& Buffer() {
+  if (!buffer_) {
+    std::scoped_lock lock{mutex_};
+    auto buffer = std::make_unique<ThreadBuffer>();
+    buffer->id = buffers_.size() + 1;
+    buffer->name = "thread " + std::to_string(buffer->id);
+    buffer_ = buffer.get();
+    buffers_.push_back(std::move(buffer));
+  }
+  return *buffer_;
+}
+
+static void Append(const Event& event) {
+  ThreadBuffer& buffer = Buffer();
+  u32 generation = generation_.load(std::memory_order_acquire);
+  if (buffer.generation.load(std::memory_order_relaxed) != generation) {
+    buffer.size.store(0, std::memory_order_relaxed);
+    buffer.dropped.store(0, std::memory_order_relaxed);
+    buffer.generation.store(generation, std::memory_order_release);
+  }
+  size_t size = buffer.size.load(std::memory_order_relaxed);
+  if (size == kCapacity) {
+    buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  if (!buffer.events) {
+    buffer.events = std::make_unique<Event[]>(kCapacity);
+  }
+  buffer.events[size] = event;
+  buffer.size.store(size + 1, std::memory_order_release);
+}
+
+void Start() {
+  start_time_ = Now();
+  generation_.fetch_add(1, std::memory_order_release);
+  capturing_.store(true, std::memory_order_release);
+}
+
+bool capturing() {
+  return capturing_.load(std::memory_order_relaxed);
+}
+
+void SetThreadName(const char* name) {
+  ThreadBuffer& buffer = Buffer();
+  std::scoped_lock lock{mutex_};
+  buffer.name = name;
+}
+
+void RecordZone(const char* name, u64 begin, u64 end) {
+  Append({name, begin, (s64) (end - begin), false});
+}
+
+Counter::Counter(const char* name) : name_(name) {
+  Buffer().counters.push_back(this);
+}
+
+void FlushCounters() {
+  if (!capturing()) {
+    return;
+  }
+  ThreadBuffer& buffer = Buffer();
+  u64 now = Now();
+  for (Counter* counter : buffer.counters) {
+    Append({counter->name_, now, counter->value_, true});
+    counter->value_ = 0;
+  }
+}
+
+// names are string literals, only quotes and backslashes need escaping
+static std::string Escape(const char* text) {
+  std::string out;
+  for (const char* c = text; *c; c++) {
+    if (*c == '"' || *c == '\\') {
+      out += '\\';
+    }
+    out += *c;
+  }
+  return out;
+}
+
+bool Stop(const std::string& path) {
+  capturing_.store(false, std::memory_order_release);
+  u32 generation = generation_.load(std::memory_order_acquire);
+
+  std::ofstream output(path);
+  if (!output.is_open()) {
+    return false;
+  }
+  auto microseconds = [](u64 time) { return time < start_time_ ? 0.0 : (time - start_time_) / 1000.0; };
+  u64 dropped = 0;
+  bool first = true;
+  output << "{\"traceEvents\":[\n";
+  std::scoped_lock lock{mutex_};
+  for (const auto& buffer : buffers_) {
+    output << (first ? "" : ",\n")
+           << fmt::format(R"({{"name":"thread_name","ph":"M","pid":1,"tid":{},"args":{{"name":"{}"}}}})", buffer->id,
+                          Escape(buffer->name.c_str()));
+    first = false;
+    if (buffer->generation.load(std::memory_order_acquire) != generation) {
+      continue; // nothing recorded in this capture
+    }
+    size_t size = buffer->size.load(std::memory_order_acquire);
+    dropped += buffer->dropped.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < size; i++) {
+      const Event& event = buffer->events[i];
+      std::string name = Escape(event.name);
+      if (event.counter) {
+        output << fmt::format(",\n{{\"name\":\"{}\",\"ph\":\"C\",\"ts\":{:.3f},\"pid\":1,\"tid\":{},\"args\":{{\"value\":{}}}}}",
+                              name, microseconds(event.time), buffer->id, event.value);
+      } else {
+        output << fmt::format(",\n{{\"name\":\"{}\",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":1,\"tid\":{}}}", name,
+                              microseconds(event.time), event.value / 1000.0, buffer->id);
+      }
+    }
+  }
+  output << fmt::format("\n],\"displayTimeUnit\":\"ns\",\"otherData\":{{\"dropped\":{}}}}}\n", dropped);
+  std::cout << "wrote the host trace to " << path;
+  if (dropped != 0) {
+    std::cout << ", " << dropped << " events didn't fit";
+  }
+  std::cout << std::endl;
+  return true;
+}
+
+}
+
+#endif
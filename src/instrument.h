@@ -0,0 +1,93 @@
+#pragma once
+
+#include "util.h"
+#include <atomic>
+#include <chrono>
+
+// Host side instrumentation, built with -DINSTRUMENT=1 or -DINSTRUMENT=2.
+//
+// Zones time a scope, counters add up per thread and are sampled once a frame.
+// Both are only recorded during a capture, into a fixed buffer per thread that
+// only its own thread writes, and Stop writes them out as Chrome trace JSON for
+// chrome://tracing or Perfetto.
+//
+// Level 1 has the per-step, per-frame and UI zones, level 2 adds the ones inside
+// an instruction (CPU::Step, PPU::Step and every bus access) which cost about as
+// much as what they measure.
+
+#ifdef INSTRUMENT
+#define ENABLE_INSTRUMENTATION
+#endif
+
+namespace Instrument {
+
+extern std::atomic<bool> capturing_;
+
+inline u64 Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Start();
+// writes the capture to path
+bool Stop(const std::string& path);
+bool capturing();
+
+// name shown for the calling thread
+void SetThreadName(const char* name);
+
+void RecordZone(const char* name, u64 begin, u64 end);
+// records the values of the calling thread's counters and zeroes them
+void FlushCounters();
+
+class Zone {
+ public:
+  explicit Zone(const char* name) : name_(name), begin_(capturing_.load(std::memory_order_relaxed) ? Now() : 0) {}
+  ~Zone() {
+    if (begin_ != 0) {
+      RecordZone(name_, begin_, Now());
+    }
+  }
+
+ private:
+  const char* name_;
+  u64 begin_;
+};
+
+// lives in a static thread_local, see INSTRUMENT_COUNT
+class Counter {
+ public:
+  explicit Counter(const char* name);
+
+  void Add(s64 value) { value_ += value; }
+
+ private:
+  friend void FlushCounters();
+
+  const char* name_;
+  s64 value_ = 0;
+};
+
+}
+
+#define INSTRUMENT_CONCAT_(a, b) a##b
+#define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT_(a, b)
+
+#ifdef ENABLE_INSTRUMENTATION
+#define INSTRUMENT_ZONE(name) Instrument::Zone INSTRUMENT_CONCAT(instrument_zone_, __LINE__)(name)
+#define INSTRUMENT_COUNT(name, value) \
+  static thread_local Instrument::Counter INSTRUMENT_CONCAT(instrument_counter_, __LINE__)(name); \
+  INSTRUMENT_CONCAT(instrument_counter_, __LINE__).Add(value)
+#define INSTRUMENT_FLUSH_COUNTERS() Instrument::FlushCounters()
+#define INSTRUMENT_THREAD(name) Instrument::SetThreadName(name)
+#else
+#define INSTRUMENT_ZONE(name)
+#define INSTRUMENT_COUNT(name, value)
+#define INSTRUMENT_FLUSH_COUNTERS()
+#define INSTRUMENT_THREAD(name)
+#endif
+
+#if defined(ENABLE_INSTRUMENTATION) && INSTRUMENT >= 2
+#define INSTRUMENT_FINE_ZONE(name) INSTRUMENT_ZONE(name)
+#else
+#define INSTRUMENT_FINE_ZONE(name)
+#endif
@@ -1,16 +1,22 @@
 #include "memory.h"
+#include "coverage.h"
 #include "debug.h"
+#include "instrument.h"
 
-MemoryBus::MemoryBus() {
-  lock_map_.fill(false);
-}
+MemoryBus::MemoryBus(size_t arena_size) : arena_(arena_size) {}
 
 void MemoryBus::Reset() {
-  lock_map_ = {};
+  devices_ = {};
+  device_count_ = 1;
   map_ = {};
 }
 
 u8 MemoryBus::Read(u16 address) {
+  INSTRUMENT_FINE_ZONE("MemoryBus::Read");
+  INSTRUMENT_COUNT("bus reads", 1);
+#ifdef ENABLE_BUS_COUNTERS
+  read_counts_[BusRegionOf(address)]++;
+#endif
   MemoryDevice* device = SelectDevice(address);
   if (!device) {
     if (!panic_on_invalid_access_) {
@@ -25,7 +31,14 @@ u8 MemoryBus::Read(u16 address) {
   if (!device->CheckAccess(address, kMemoryAccessRead)) {
     return 0xFF;
   }
+  COVERAGE_READ(address);
+#ifdef ENABLE_DEBUGGER
+  u8 value = device->Read(address);
+  EMIT_MEM_READ(address, value);
+  return value;
+#else
   return device->Read(address);
+#endif
 }
 
 u16 MemoryBus::ReadWord(u16 address) {
@@ -33,6 +46,11 @@ u16 MemoryBus::ReadWord(u16 address) {
 }
 
 void MemoryBus::Write(u16 address, u8 value) {
+  INSTRUMENT_FINE_ZONE("MemoryBus::Write");
+  INSTRUMENT_COUNT("bus writes", 1);
+#ifdef ENABLE_BUS_COUNTERS
+  write_counts_[BusRegionOf(address)]++;
+#endif
   MemoryDevice* device = SelectDevice(address);
   if (!device) {
     if (!panic_on_invalid_access_) {
@@ -65,6 +83,17 @@ void MemoryBus::WriteWord(u16 address, u16 value) {
   Write(address + 1, (u8)((value & 0xFF00) >> 8));
 }
 
+u8 MemoryBus::Peek(u16 address) {
+  MemoryDevice* device = SelectDevice(address);
+  if (!device || !device->CheckAccess(address, kMemoryAccessRead)) {
+    return 0xFF;
+  }
+  if (const u8* data = device->DirectPointer(address)) {
+    return *data;
+  }
+  return device->Read(address);
+}
+
 bool MemoryBus::CheckAccess(u16 address, MemoryAccess access) {
   MemoryDevice* device = SelectDevice(address);
   if (!device || !device->CheckAccess(address, access)) {
@@ -73,44 +102,121 @@ bool MemoryBus::CheckAccess(u16 address, MemoryAccess access) {
   return true;
 }
 
-void MemoryBus::AddDevice(u16 address, MemoryDevice* device, bool lock) {
-  if (lock_map_[address]) {
-    abort(); // cannot push to a locked memory location
+const u8* MemoryBus::ReadPagePointer(u16 address) {
+  u16 first = address & 0xFF00;
+  u16 last = first | 0x00FF;
+  MemoryDevice* device = SelectDevice(first);
+  if (!device || device != SelectDevice(last) || !device->CheckAccess(first, kMemoryAccessRead) ||
+      !device->CheckAccess(last, kMemoryAccessRead)) {
+    return nullptr;
+  }
+  const u8* page = device->DirectPointer(first);
+  if (!page || device->DirectPointer(last) != page + 0xFF) {
+    return nullptr;
+  }
+  return page;
+}
+
+u8* MemoryBus::WritePagePointer(u16 address) {
+  u16 first = address & 0xFF00;
+  u16 last = first | 0x00FF;
+  MemoryDevice* device = SelectDevice(first);
+  if (!device || device != SelectDevice(last) || !device->CheckAccess(first, kMemoryAccessWrite) ||
+      !device->CheckAccess(last, kMemoryAccessWrite)) {
+    return nullptr;
   }
-  map_[address].push_back(device);
-  if (lock) {
-    lock_map_[address] = true;
+  u8* page = device->DirectWritePointer(first);
+  if (!page || device->DirectWritePointer(last) != page + 0xFF) {
+    return nullptr;
   }
+  return page;
+}
+
+u8 MemoryBus::DeviceIndex(MemoryDevice* device) {
+  for (u32 index = 1; index < device_count_; index++) {
+    if (devices_[index] == device) {
+      return index;
+    }
+  }
+  if (device_count_ > kMaxDevices) {
+    abort(); // too many devices
+  }
+  devices_[device_count_] = device;
+  return device_count_++;
+}
+
+void MemoryBus::AddDevice(u16 address, MemoryDevice* device, bool lock) {
+  AddDevice(address, address, device, lock);
 }
 
 void MemoryBus::AddDevice(u16 start_address, u16 end_address, MemoryDevice* device, bool lock) {
+  u8 index = DeviceIndex(device);
   for (u32 address = start_address; address <= end_address; address++) {
-    AddDevice(address, device, lock);
+    Slot& slot = map_[address];
+    if (slot.locked || slot.count == kMaxStackedDevices) {
+      abort(); // cannot push to a locked or full memory location
+    }
+    // goes behind the ones already there
+    slot.devices[slot.count++] = index;
+    slot.locked |= lock;
   }
 }
 
-void MemoryBus::PopFrontDevice(u16 address) {
-  if (lock_map_[address]) {
-    abort(); // cannot pop a locked memory location
-  }
-  std::deque<MemoryDevice*>& q = map_[address];
-  if (q.empty()) {
-    return; // maybe error here?
+void MemoryBus::PushFrontDevice(u16 start_address, u16 end_address, MemoryDevice* device) {
+  u8 index = DeviceIndex(device);
+  for (u32 address = start_address; address <= end_address; address++) {
+    Slot& slot = map_[address];
+    if (slot.locked || slot.count == kMaxStackedDevices) {
+      abort(); // cannot push to a locked or full memory location
+    }
+    std::copy_backward(slot.devices.begin(), slot.devices.begin() + slot.count, slot.devices.begin() + slot.count + 1);
+    slot.devices[0] = index;
+    slot.count++;
   }
-  q.pop_front();
+}
+
+void MemoryBus::PopFrontDevice(u16 address) {
+  PopFrontDevice(address, address);
 }
 
 void MemoryBus::PopFrontDevice(u16 start_address, u16 end_address) {
-  for (u16 address = start_address; address <= end_address; address++) {
-    PopFrontDevice(address);
+  for (u32 address = start_address; address <= end_address; address++) {
+    Slot& slot = map_[address];
+    if (slot.locked) {
+      abort(); // cannot pop a locked memory location
+    }
+    if (slot.count == 0) {
+      continue; // maybe error here?
+    }
+    std::copy(slot.devices.begin() + 1, slot.devices.end(), slot.devices.begin());
+    slot.devices.back() = 0;
+    slot.count--;
   }
 }
 
-MemoryDevice* MemoryBus::SelectDevice(u16 address) {
-  // select the first one in the deque
-  const std::deque<MemoryDevice*>& q = map_[address];
-  if (q.empty()) {
-    return nullptr;
+void MemoryBus::RemoveDevice(MemoryDevice* device) {
+  u32 index = 1;
+  while (index < device_count_ && devices_[index] != device) {
+    index++;
+  }
+  if (index == device_count_) {
+    return; // never mapped
+  }
+  for (Slot& slot : map_) {
+    auto end = slot.devices.begin() + slot.count;
+    auto removed = std::remove(slot.devices.begin(), end, index);
+    if (removed == end) {
+      continue;
+    }
+    if (slot.locked) {
+      abort(); // cannot remove from a locked memory location
+    }
+    std::fill(removed, end, 0);
+    slot.count = removed - slot.devices.begin();
+  }
+  devices_[index] = nullptr;
+  // the last devices added are usually the first removed, their indices are reused
+  while (device_count_ > 1 && !devices_[device_count_ - 1]) {
+    device_count_--;
   }
-  return q.front();
 }
\ No newline at end of file
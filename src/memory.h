@@ -1,6 +1,10 @@
 #pragma once
 
 #include "util.h"
+#include "arena.h"
+#include <array>
+#include <memory>
+#include <span>
 #include <stack>
 #include <utility>
 
@@ -29,6 +33,7 @@ class MemoryDevice {
  public:
   MemoryDevice(MemoryAccess access) : access_(access) {}
   MemoryDevice(const MemoryDevice&) = delete;
+  virtual ~MemoryDevice() = default;
 
   virtual u8 Read(u16 address) = 0;
 
@@ -48,6 +53,18 @@ class MemoryDevice {
 
   virtual void OnFailedWrite(u16 address, u8 value) {
   }
+
+  MemoryAccess access() const { return access_; }
+
+  // backing storage of the address if reads have no side effects, nullptr otherwise
+  virtual const u8* DirectPointer(u16 address) {
+    return nullptr;
+  }
+
+  // backing storage of the address if writes are plain stores, nullptr otherwise
+  virtual u8* DirectWritePointer(u16 address) {
+    return nullptr;
+  }
  protected:
   MemoryAccess access_;
 };
@@ -82,6 +99,14 @@ class FixedArrayMemoryDevice : public MemoryDevice {
     return (access_ & type) == type;
   }
 
+  const u8* DirectPointer(u16 address) override {
+    return &(*original_)[address - start_address_];
+  }
+
+  u8* DirectWritePointer(u16 address) override {
+    return &(*original_)[address - start_address_];
+  }
+
  protected:
   u16 start_address_;
   std::array<u8, size>* original_;
@@ -99,6 +124,10 @@ class FixedArrayWithHandlerMemoryDevice : public FixedArrayMemoryDevice<size> {
     (*super::original_)[relative_address] = handler_(address, old_value, value);
   }
 
+  u8* DirectWritePointer(u16 address) override {
+    return nullptr;
+  }
+
  private:
   using super = FixedArrayMemoryDevice<size>;
   std::function<u8(u16, u8, u8)> handler_;
@@ -117,6 +146,131 @@ class SwitchingArrayMemoryDevice : public FixedArrayMemoryDevice<size> {
   using super = FixedArrayMemoryDevice<size>;
 };
 
+// Banks of RAM that machines forked from one snapshot share until they write to
+// them, see Snapshot. Each bank has an array of the machine's own, a shared bank is
+// read from the snapshot's frozen copy instead and the first write to it copies it
+// into the own array. Reads cost the same as for a SwitchingArrayMemoryDevice.
+template<size_t size>
+class CopyOnWriteArrayMemoryDevice : public MemoryDevice {
+ public:
+  using Bank = std::array<u8, size>;
+  using SharedBank = std::shared_ptr<const Bank>;
+  // cartridge RAM has the most, 16
+  static constexpr u32 kMaxBanks = 16;
+
+  CopyOnWriteArrayMemoryDevice(u16 start_address, std::span<Bank* const> banks, MemoryAccess access)
+      : MemoryDevice(access), start_address_(start_address), bank_count_(banks.size()) {
+    assert(bank_count_ > 0 && bank_count_ <= kMaxBanks);
+    std::copy(banks.begin(), banks.end(), banks_.begin());
+    Switch(0);
+  }
+
+  CopyOnWriteArrayMemoryDevice(u16 start_address, std::span<Bank> banks, MemoryAccess access)
+      : MemoryDevice(access), start_address_(start_address), bank_count_(banks.size()) {
+    assert(bank_count_ > 0 && bank_count_ <= kMaxBanks);
+    for (u32 bank = 0; bank < bank_count_; bank++) {
+      banks_[bank] = &banks[bank];
+    }
+    Switch(0);
+  }
+
+  u8 Read(u16 address) override {
+    return (*read_)[address - start_address_];
+  }
+
+  void Write(u16 address, u8 value) override {
+    if (!write_) [[unlikely]] {
+      Unshare();
+    }
+    (*write_)[address - start_address_] = value;
+  }
+
+  bool CheckAccess(u16 address, MemoryAccess type) override {
+    u16 relative_address = address - start_address_;
+    if (relative_address >= size) {
+      return false;
+    }
+    return (access_ & type) == type;
+  }
+
+  const u8* DirectPointer(u16 address) override {
+    return &(*read_)[address - start_address_];
+  }
+
+  // the caller is about to write, so a shared bank is copied first
+  u8* DirectWritePointer(u16 address) override {
+    if (!write_) {
+      Unshare();
+    }
+    return &(*write_)[address - start_address_];
+  }
+
+  void Switch(u32 bank) {
+    current_ = bank;
+    const SharedBank& shared = shared_[bank];
+    read_ = shared ? shared.get() : banks_[bank];
+    write_ = shared ? nullptr : banks_[bank];
+  }
+
+  u32 current() const { return current_; }
+  u32 bank_count() const { return bank_count_; }
+
+  // what reads of bank see
+  const Bank& Data(u32 bank) const {
+    return shared_[bank] ? *shared_[bank] : *banks_[bank];
+  }
+
+  // an unchanging copy of bank for a snapshot, the bank is shared from then on here
+  // too, so freezing it again before the next write to it copies nothing
+  SharedBank Freeze(u32 bank) {
+    if (!shared_[bank]) {
+      shared_[bank] = std::make_shared<const Bank>(*banks_[bank]);
+      if (bank == current_) {
+        Switch(bank);
+      }
+    }
+    return shared_[bank];
+  }
+
+  // reads of bank see data until the next write to it
+  void Share(u32 bank, SharedBank data) {
+    shared_[bank] = std::move(data);
+    if (bank == current_) {
+      Switch(bank);
+    }
+  }
+
+  // the own array of bank for replacing all of it, a shared copy is dropped unread
+  Bank& Overwrite(u32 bank) {
+    shared_[bank].reset();
+    if (bank == current_) {
+      Switch(bank);
+    }
+    return *banks_[bank];
+  }
+
+  void Fill(u8 value) {
+    for (u32 bank = 0; bank < bank_count_; bank++) {
+      Overwrite(bank).fill(value);
+    }
+  }
+
+ private:
+  void Unshare() {
+    *banks_[current_] = *shared_[current_];
+    shared_[current_].reset();
+    Switch(current_);
+  }
+
+  u16 start_address_;
+  const Bank* read_;
+  Bank* write_; // nullptr while the current bank is shared
+  u32 current_ = 0;
+  u32 bank_count_;
+  std::array<Bank*, kMaxBanks> banks_{};
+  std::array<SharedBank, kMaxBanks> shared_{};
+};
+
 template<size_t size>
 class SwitchingArrayWithHandlerMemoryDevice : public SwitchingArrayMemoryDevice<size> {
  public:
@@ -135,6 +289,10 @@ class SwitchingArrayWithHandlerMemoryDevice : public SwitchingArrayMemoryDevice<
     handler_(address, old_value, value, true);
   }
 
+  u8* DirectWritePointer(u16 address) override {
+    return nullptr;
+  }
+
  private:
   using super = SwitchingArrayMemoryDevice<size>;
   std::function<u8(u16, u8, u8, bool)> handler_;
@@ -306,11 +464,76 @@ class TesterMemoryDevice : public MemoryDevice {
   std::function<u8(u16, u8, bool, MemoryAccess)> callback_;
 };
 
+// Bus accesses per region for the performance HUD, built with -DCOUNT_BUS_ACCESSES=1,
+// other builds leave Read and Write without the increment and the counts at 0.
+#ifdef COUNT_BUS_ACCESSES
+#define ENABLE_BUS_COUNTERS
+#endif
+
+// parts of the address space, each served by one kind of device
+enum BusRegion : u8 {
+  kBusRegionROM,
+  kBusRegionVRAM,
+  kBusRegionCartridgeRAM,
+  kBusRegionWRAM, // echo RAM included
+  kBusRegionOAM, // the unusable area after it included
+  kBusRegionIO, // IE included
+  kBusRegionHRAM,
+  kBusRegionCount
+};
+
+inline const char* BusRegionToString(BusRegion region) {
+  switch (region) {
+    case kBusRegionROM: return "ROM";
+    case kBusRegionVRAM: return "VRAM";
+    case kBusRegionCartridgeRAM: return "Cart RAM";
+    case kBusRegionWRAM: return "WRAM";
+    case kBusRegionOAM: return "OAM";
+    case kBusRegionIO: return "I/O";
+    case kBusRegionHRAM: return "HRAM";
+    case kBusRegionCount: break;
+  }
+  return "";
+}
+
+inline BusRegion BusRegionOf(u16 address) {
+  static constexpr auto kPages = [] {
+    std::array<BusRegion, 0x100> pages{};
+    for (u32 page = 0; page < 0x100; page++) {
+      u16 address = page << 8;
+      pages[page] = address < VRAM_START_ADDRESS ? kBusRegionROM
+          : address <= VRAM_END_ADDRESS ? kBusRegionVRAM
+          : address < 0xC000 ? kBusRegionCartridgeRAM
+          : address < 0xFE00 ? kBusRegionWRAM
+          : address < 0xFF00 ? kBusRegionOAM
+          : kBusRegionIO;
+    }
+    return pages;
+  }();
+  if (address >= 0xFF80 && address != 0xFFFF) {
+    return kBusRegionHRAM;
+  }
+  return kPages[address >> 8];
+}
+
 class MemoryBus {
  public:
-  MemoryBus();
+  using AccessCounts = std::array<u32, kBusRegionCount>;
+
+  // fits the CPU, the PPU, their devices and 16 banks of cartridge RAM
+  static constexpr size_t kArenaSize = 512 * 1024;
+  // devices stacked at one address, e.g. the boot ROM over the cartridge
+  static constexpr u32 kMaxStackedDevices = 3;
+  // different devices mapped at once, index 0 means none
+  static constexpr u32 kMaxDevices = 255;
+
+  explicit MemoryBus(size_t arena_size = kArenaSize);
   MemoryBus(const MemoryBus&) = delete;
 
+  // the machine's state, whatever is mapped into the bus is allocated from it so it
+  // lives next to the rest and goes away after everything that uses it
+  Arena& arena() { return arena_; }
+
   void Reset();
 
   void WriteWord(u16 address, u16 value);
@@ -319,22 +542,59 @@ class MemoryBus {
 
   u8 Read(u16 address);
   u16 ReadWord(u16 address);
+  // what Read would return, for tools looking at memory: it isn't counted, recorded
+  // by coverage or shown to the debugger, and unmapped addresses read as 0xFF
+  u8 Peek(u16 address);
 
   bool CheckAccess(u16 address, MemoryAccess access);
 
+  // pointer to the readable bytes of the page at address, nullptr unless
+  // the whole 256-byte page is backed by one plain memory device
+  const u8* ReadPagePointer(u16 address);
+  // same for writes, nullptr if any write to the page would have side effects
+  u8* WritePagePointer(u16 address);
+
   void panic_on_invalid_access(bool enabled) { panic_on_invalid_access_ = enabled; }
   bool panic_on_invalid_access() const { return panic_on_invalid_access_; }
 
   void AddDevice(u16 address, MemoryDevice* device, bool lock = false);
   void AddDevice(u16 start_address, u16 end_address, MemoryDevice* device, bool lock = false);
+  // in front of the devices already there, e.g. the boot ROM mapped back over the cartridge
+  void PushFrontDevice(u16 start_address, u16 end_address, MemoryDevice* device);
   void PopFrontDevice(u16 address);
   void PopFrontDevice(u16 start_address, u16 end_address);
+  // unmaps device wherever it is, in front of or behind others
+  void RemoveDevice(MemoryDevice* device);
 
-  MemoryDevice* SelectDevice(u16 address);
+  MemoryDevice* SelectDevice(u16 address) {
+    return devices_[map_[address].devices[0]];
+  }
+
+  // reads and writes per region since the last ResetAccessCounts, only counted with
+  // ENABLE_BUS_COUNTERS, by the thread emulating the machine
+  const AccessCounts& read_counts() const { return read_counts_; }
+  const AccessCounts& write_counts() const { return write_counts_; }
+  void ResetAccessCounts() {
+    read_counts_ = {};
+    write_counts_ = {};
+  }
 
  private:
+  AccessCounts read_counts_{};
+  AccessCounts write_counts_{};
   bool panic_on_invalid_access_ = false;
 
-  std::array<std::deque<MemoryDevice*>, 0x10000> map_;
-  std::array<bool, 0x10000> lock_map_;
+  struct Slot {
+    std::array<u8, kMaxStackedDevices> devices; // indices into devices_, the first one serves the address
+    u8 count : 7;
+    u8 locked : 1;
+  };
+  static_assert(sizeof(Slot) == 4);
+
+  u8 DeviceIndex(MemoryDevice* device);
+
+  Arena arena_;
+  std::array<MemoryDevice*, kMaxDevices + 1> devices_{};
+  u32 device_count_ = 1;
+  std::array<Slot, 0x10000> map_{};
 };
\ No newline at end of file
@@ -0,0 +1,318 @@
+#pragma once
+
+#include "util.h"
+#include <array>
+
+// Decode metadata of every opcode, the decoder, the recompiler and the debugger
+// all read lengths, cycles and mnemonics from here so they can't disagree.
+
+enum class OperandKind : u8 {
+  None,
+  Imm8, // n8
+  Imm16, // n16 or a16
+  HighPage, // a8, the address is $FF00 + n8
+  Relative, // e8 of JR, relative to the next instruction
+  Signed, // e8 added to SP
+};
+
+struct OpcodeInfo {
+  const char* format; // {} stands for the operand, nullptr if the CPU doesn't have the opcode
+  u8 length; // in bytes, $CB opcodes include the prefix
+  u8 cycles; // T-cycles, when a conditional branch is not taken
+  u8 cycles_taken; // same as cycles unless the instruction is a conditional branch
+  OperandKind operand;
+
+  constexpr bool valid() const { return format != nullptr; }
+};
+
+// the eight operands of a $CB row, [HL] is the slower one
+#define PREFIXED_ROW(name, cycles, memory_cycles)                                                         \
+  {name " B", 2, cycles, cycles, OperandKind::None}, {name " C", 2, cycles, cycles, OperandKind::None},     \
+  {name " D", 2, cycles, cycles, OperandKind::None}, {name " E", 2, cycles, cycles, OperandKind::None},     \
+  {name " H", 2, cycles, cycles, OperandKind::None}, {name " L", 2, cycles, cycles, OperandKind::None},     \
+  {name " [HL]", 2, memory_cycles, memory_cycles, OperandKind::None}, {name " A", 2, cycles, cycles, OperandKind::None}
+#define PREFIXED_BIT_ROWS(name, memory_cycles)                                                            \
+  PREFIXED_ROW(name " 0,", 8, memory_cycles), PREFIXED_ROW(name " 1,", 8, memory_cycles),               \
+  PREFIXED_ROW(name " 2,", 8, memory_cycles), PREFIXED_ROW(name " 3,", 8, memory_cycles),               \
+  PREFIXED_ROW(name " 4,", 8, memory_cycles), PREFIXED_ROW(name " 5,", 8, memory_cycles),               \
+  PREFIXED_ROW(name " 6,", 8, memory_cycles), PREFIXED_ROW(name " 7,", 8, memory_cycles)
+
+// unprefixed opcodes followed by the $CB page, use Opcode and PrefixedOpcode to index it
+inline constexpr std::array<OpcodeInfo, 512> kOpcodes = {{
+    {"NOP", 1, 4, 4, OperandKind::None},  // 00
+    {"LD BC, {}", 3, 12, 12, OperandKind::Imm16},  // 01
+    {"LD [BC], A", 1, 8, 8, OperandKind::None},  // 02
+    {"INC BC", 1, 8, 8, OperandKind::None},  // 03
+    {"INC B", 1, 4, 4, OperandKind::None},  // 04
+    {"DEC B", 1, 4, 4, OperandKind::None},  // 05
+    {"LD B, {}", 2, 8, 8, OperandKind::Imm8},  // 06
+    {"RLCA", 1, 4, 4, OperandKind::None},  // 07
+    {"LD [{}], SP", 3, 20, 20, OperandKind::Imm16},  // 08
+    {"ADD HL, BC", 1, 8, 8, OperandKind::None},  // 09
+    {"LD A, [BC]", 1, 8, 8, OperandKind::None},  // 0A
+    {"DEC BC", 1, 8, 8, OperandKind::None},  // 0B
+    {"INC C", 1, 4, 4, OperandKind::None},  // 0C
+    {"DEC C", 1, 4, 4, OperandKind::None},  // 0D
+    {"LD C, {}", 2, 8, 8, OperandKind::Imm8},  // 0E
+    {"RRCA", 1, 4, 4, OperandKind::None},  // 0F
+    {"STOP", 1, 4, 4, OperandKind::None},  // 10
+    {"LD DE, {}", 3, 12, 12, OperandKind::Imm16},  // 11
+    {"LD [DE], A", 1, 8, 8, OperandKind::None},  // 12
+    {"INC DE", 1, 8, 8, OperandKind::None},  // 13
+    {"INC D", 1, 4, 4, OperandKind::None},  // 14
+    {"DEC D", 1, 4, 4, OperandKind::None},  // 15
+    {"LD D, {}", 2, 8, 8, OperandKind::Imm8},  // 16
+    {"RLA", 1, 4, 4, OperandKind::None},  // 17
+    {"JR {}", 2, 12, 12, OperandKind::Relative},  // 18
+    {"ADD HL, DE", 1, 8, 8, OperandKind::None},  // 19
+    {"LD A, [DE]", 1, 8, 8, OperandKind::None},  // 1A
+    {"DEC DE", 1, 8, 8, OperandKind::None},  // 1B
+    {"INC E", 1, 4, 4, OperandKind::None},  // 1C
+    {"DEC E", 1, 4, 4, OperandKind::None},  // 1D
+    {"LD E, {}", 2, 8, 8, OperandKind::Imm8},  // 1E
+    {"RRA", 1, 4, 4, OperandKind::None},  // 1F
+    {"JR NZ, {}", 2, 8, 12, OperandKind::Relative},  // 20
+    {"LD HL, {}", 3, 12, 12, OperandKind::Imm16},  // 21
+    {"LD [HL+], A", 1, 8, 8, OperandKind::None},  // 22
+    {"INC HL", 1, 8, 8, OperandKind::None},  // 23
+    {"INC H", 1, 4, 4, OperandKind::None},  // 24
+    {"DEC H", 1, 4, 4, OperandKind::None},  // 25
+    {"LD H, {}", 2, 8, 8, OperandKind::Imm8},  // 26
+    {"DAA", 1, 4, 4, OperandKind::None},  // 27
+    {"JR Z, {}", 2, 8, 12, OperandKind::Relative},  // 28
+    {"ADD HL, HL", 1, 8, 8, OperandKind::None},  // 29
+    {"LD A, [HL+]", 1, 8, 8, OperandKind::None},  // 2A
+    {"DEC HL", 1, 8, 8, OperandKind::None},  // 2B
+    {"INC L", 1, 4, 4, OperandKind::None},  // 2C
+    {"DEC L", 1, 4, 4, OperandKind::None},  // 2D
+    {"LD L, {}", 2, 8, 8, OperandKind::Imm8},  // 2E
+    {"CPL", 1, 4, 4, OperandKind::None},  // 2F
+    {"JR NC, {}", 2, 8, 12, OperandKind::Relative},  // 30
+    {"LD SP, {}", 3, 12, 12, OperandKind::Imm16},  // 31
+    {"LD [HL-], A", 1, 8, 8, OperandKind::None},  // 32
+    {"INC SP", 1, 8, 8, OperandKind::None},  // 33
+    {"INC [HL]", 1, 12, 12, OperandKind::None},  // 34
+    {"DEC [HL]", 1, 12, 12, OperandKind::None},  // 35
+    {"LD [HL], {}", 2, 12, 12, OperandKind::Imm8},  // 36
+    {"SCF", 1, 4, 4, OperandKind::None},  // 37
+    {"JR C, {}", 2, 8, 12, OperandKind::Relative},  // 38
+    {"ADD HL, SP", 1, 8, 8, OperandKind::None},  // 39
+    {"LD A, [HL-]", 1, 8, 8, OperandKind::None},  // 3A
+    {"DEC SP", 1, 8, 8, OperandKind::None},  // 3B
+    {"INC A", 1, 4, 4, OperandKind::None},  // 3C
+    {"DEC A", 1, 4, 4, OperandKind::None},  // 3D
+    {"LD A, {}", 2, 8, 8, OperandKind::Imm8},  // 3E
+    {"CCF", 1, 4, 4, OperandKind::None},  // 3F
+    {"LD B, B", 1, 4, 4, OperandKind::None},  // 40
+    {"LD B, C", 1, 4, 4, OperandKind::None},  // 41
+    {"LD B, D", 1, 4, 4, OperandKind::None},  // 42
+    {"LD B, E", 1, 4, 4, OperandKind::None},  // 43
+    {"LD B, H", 1, 4, 4, OperandKind::None},  // 44
+    {"LD B, L", 1, 4, 4, OperandKind::None},  // 45
+    {"LD B, [HL]", 1, 8, 8, OperandKind::None},  // 46
+    {"LD B, A", 1, 4, 4, OperandKind::None},  // 47
+    {"LD C, B", 1, 4, 4, OperandKind::None},  // 48
+    {"LD C, C", 1, 4, 4, OperandKind::None},  // 49
+    {"LD C, D", 1, 4, 4, OperandKind::None},  // 4A
+    {"LD C, E", 1, 4, 4, OperandKind::None},  // 4B
+    {"LD C, H", 1, 4, 4, OperandKind::None},  // 4C
+    {"LD C, L", 1, 4, 4, OperandKind::None},  // 4D
+    {"LD C, [HL]", 1, 8, 8, OperandKind::None},  // 4E
+    {"LD C, A", 1, 4, 4, OperandKind::None},  // 4F
+    {"LD D, B", 1, 4, 4, OperandKind::None},  // 50
+    {"LD D, C", 1, 4, 4, OperandKind::None},  // 51
+    {"LD D, D", 1, 4, 4, OperandKind::None},  // 52
+    {"LD D, E", 1, 4, 4, OperandKind::None},  // 53
+    {"LD D, H", 1, 4, 4, OperandKind::None},  // 54
+    {"LD D, L", 1, 4, 4, OperandKind::None},  // 55
+    {"LD D, [HL]", 1, 8, 8, OperandKind::None},  // 56
+    {"LD D, A", 1, 4, 4, OperandKind::None},  // 57
+    {"LD E, B", 1, 4, 4, OperandKind::None},  // 58
+    {"LD E, C", 1, 4, 4, OperandKind::None},  // 59
+    {"LD E, D", 1, 4, 4, OperandKind::None},  // 5A
+    {"LD E, E", 1, 4, 4, OperandKind::None},  // 5B
+    {"LD E, H", 1, 4, 4, OperandKind::None},  // 5C
+    {"LD E, L", 1, 4, 4, OperandKind::None},  // 5D
+    {"LD E, [HL]", 1, 8, 8, OperandKind::None},  // 5E
+    {"LD E, A", 1, 4, 4, OperandKind::None},  // 5F
+    {"LD H, B", 1, 4, 4, OperandKind::None},  // 60
+    {"LD H, C", 1, 4, 4, OperandKind::None},  // 61
+    {"LD H, D", 1, 4, 4, OperandKind::None},  // 62
+    {"LD H, E", 1, 4, 4, OperandKind::None},  // 63
+    {"LD H, H", 1, 4, 4, OperandKind::None},  // 64
+    {"LD H, L", 1, 4, 4, OperandKind::None},  // 65
+    {"LD H, [HL]", 1, 8, 8, OperandKind::None},  // 66
+    {"LD H, A", 1, 4, 4, OperandKind::None},  // 67
+    {"LD L, B", 1, 4, 4, OperandKind::None},  // 68
+    {"LD L, C", 1, 4, 4, OperandKind::None},  // 69
+    {"LD L, D", 1, 4, 4, OperandKind::None},  // 6A
+    {"LD L, E", 1, 4, 4, OperandKind::None},  // 6B
+    {"LD L, H", 1, 4, 4, OperandKind::None},  // 6C
+    {"LD L, L", 1, 4, 4, OperandKind::None},  // 6D
+    {"LD L, [HL]", 1, 8, 8, OperandKind::None},  // 6E
+    {"LD L, A", 1, 4, 4, OperandKind::None},  // 6F
+    {"LD [HL], B", 1, 8, 8, OperandKind::None},  // 70
+    {"LD [HL], C", 1, 8, 8, OperandKind::None},  // 71
+    {"LD [HL], D", 1, 8, 8, OperandKind::None},  // 72
+    {"LD [HL], E", 1, 8, 8, OperandKind::None},  // 73
+    {"LD [HL], H", 1, 8, 8, OperandKind::None},  // 74
+    {"LD [HL], L", 1, 8, 8, OperandKind::None},  // 75
+    {"HALT", 1, 4, 4, OperandKind::None},  // 76
+    {"LD [HL], A", 1, 8, 8, OperandKind::None},  // 77
+    {"LD A, B", 1, 4, 4, OperandKind::None},  // 78
+    {"LD A, C", 1, 4, 4, OperandKind::None},  // 79
+    {"LD A, D", 1, 4, 4, OperandKind::None},  // 7A
+    {"LD A, E", 1, 4, 4, OperandKind::None},  // 7B
+    {"LD A, H", 1, 4, 4, OperandKind::None},  // 7C
+    {"LD A, L", 1, 4, 4, OperandKind::None},  // 7D
+    {"LD A, [HL]", 1, 8, 8, OperandKind::None},  // 7E
+    {"LD A, A", 1, 4, 4, OperandKind::None},  // 7F
+    {"ADD A, B", 1, 4, 4, OperandKind::None},  // 80
+    {"ADD A, C", 1, 4, 4, OperandKind::None},  // 81
+    {"ADD A, D", 1, 4, 4, OperandKind::None},  // 82
+    {"ADD A, E", 1, 4, 4, OperandKind::None},  // 83
+    {"ADD A, H", 1, 4, 4, OperandKind::None},  // 84
+    {"ADD A, L", 1, 4, 4, OperandKind::None},  // 85
+    {"ADD A, [HL]", 1, 8, 8, OperandKind::None},  // 86
+    {"ADD A, A", 1, 4, 4, OperandKind::None},  // 87
+    {"ADC A, B", 1, 4, 4, OperandKind::None},  // 88
+    {"ADC A, C", 1, 4, 4, OperandKind::None},  // 89
+    {"ADC A, D", 1, 4, 4, OperandKind::None},  // 8A
+    {"ADC A, E", 1, 4, 4, OperandKind::None},  // 8B
+    {"ADC A, H", 1, 4, 4, OperandKind::None},  // 8C
+    {"ADC A, L", 1, 4, 4, OperandKind::None},  // 8D
+    {"ADC A, [HL]", 1, 8, 8, OperandKind::None},  // 8E
+    {"ADC A, A", 1, 4, 4, OperandKind::None},  // 8F
+    {"SUB A, B", 1, 4, 4, OperandKind::None},  // 90
+    {"SUB A, C", 1, 4, 4, OperandKind::None},  // 91
+    {"SUB A, D", 1, 4, 4, OperandKind::None},  // 92
+    {"SUB A, E", 1, 4, 4, OperandKind::None},  // 93
+    {"SUB A, H", 1, 4, 4, OperandKind::None},  // 94
+    {"SUB A, L", 1, 4, 4, OperandKind::None},  // 95
+    {"SUB A, [HL]", 1, 8, 8, OperandKind::None},  // 96
+    {"SUB A, A", 1, 4, 4, OperandKind::None},  // 97
+    {"SBC A, B", 1, 4, 4, OperandKind::None},  // 98
+    {"SBC A, C", 1, 4, 4, OperandKind::None},  // 99
+    {"SBC A, D", 1, 4, 4, OperandKind::None},  // 9A
+    {"SBC A, E", 1, 4, 4, OperandKind::None},  // 9B
+    {"SBC A, H", 1, 4, 4, OperandKind::None},  // 9C
+    {"SBC A, L", 1, 4, 4, OperandKind::None},  // 9D
+    {"SBC A, [HL]", 1, 8, 8, OperandKind::None},  // 9E
+    {"SBC A, A", 1, 4, 4, OperandKind::None},  // 9F
+    {"AND A, B", 1, 4, 4, OperandKind::None},  // A0
+    {"AND A, C", 1, 4, 4, OperandKind::None},  // A1
+    {"AND A, D", 1, 4, 4, OperandKind::None},  // A2
+    {"AND A, E", 1, 4, 4, OperandKind::None},  // A3
+    {"AND A, H", 1, 4, 4, OperandKind::None},  // A4
+    {"AND A, L", 1, 4, 4, OperandKind::None},  // A5
+    {"AND A, [HL]", 1, 8, 8, OperandKind::None},  // A6
+    {"AND A, A", 1, 4, 4, OperandKind::None},  // A7
+    {"XOR A, B", 1, 4, 4, OperandKind::None},  // A8
+    {"XOR A, C", 1, 4, 4, OperandKind::None},  // A9
+    {"XOR A, D", 1, 4, 4, OperandKind::None},  // AA
+    {"XOR A, E", 1, 4, 4, OperandKind::None},  // AB
+    {"XOR A, H", 1, 4, 4, OperandKind::None},  // AC
+    {"XOR A, L", 1, 4, 4, OperandKind::None},  // AD
+    {"XOR A, [HL]", 1, 8, 8, OperandKind::None},  // AE
+    {"XOR A, A", 1, 4, 4, OperandKind::None},  // AF
+    {"OR A, B", 1, 4, 4, OperandKind::None},  // B0
+    {"OR A, C", 1, 4, 4, OperandKind::None},  // B1
+    {"OR A, D", 1, 4, 4, OperandKind::None},  // B2
+    {"OR A, E", 1, 4, 4, OperandKind::None},  // B3
+    {"OR A, H", 1, 4, 4, OperandKind::None},  // B4
+    {"OR A, L", 1, 4, 4, OperandKind::None},  // B5
+    {"OR A, [HL]", 1, 8, 8, OperandKind::None},  // B6
+    {"OR A, A", 1, 4, 4, OperandKind::None},  // B7
+    {"CP A, B", 1, 4, 4, OperandKind::None},  // B8
+    {"CP A, C", 1, 4, 4, OperandKind::None},  // B9
+    {"CP A, D", 1, 4, 4, OperandKind::None},  // BA
+    {"CP A, E", 1, 4, 4, OperandKind::None},  // BB
+    {"CP A, H", 1, 4, 4, OperandKind::None},  // BC
+    {"CP A, L", 1, 4, 4, OperandKind::None},  // BD
+    {"CP A, [HL]", 1, 8, 8, OperandKind::None},  // BE
+    {"CP A, A", 1, 4, 4, OperandKind::None},  // BF
+    {"RET NZ", 1, 8, 20, OperandKind::None},  // C0
+    {"POP BC", 1, 12, 12, OperandKind::None},  // C1
+    {"JP NZ, {}", 3, 12, 16, OperandKind::Imm16},  // C2
+    {"JP {}", 3, 16, 16, OperandKind::Imm16},  // C3
+    {"CALL NZ, {}", 3, 12, 24, OperandKind::Imm16},  // C4
+    {"PUSH BC", 1, 16, 16, OperandKind::None},  // C5
+    {"ADD A, {}", 2, 8, 8, OperandKind::Imm8},  // C6
+    {"RST $00", 1, 16, 16, OperandKind::None},  // C7
+    {"RET Z", 1, 8, 20, OperandKind::None},  // C8
+    {"RET", 1, 16, 16, OperandKind::None},  // C9
+    {"JP Z, {}", 3, 12, 16, OperandKind::Imm16},  // CA
+    {"PREFIX", 2, 4, 4, OperandKind::None},  // CB, the instruction is in the $CB page
+    {"CALL Z, {}", 3, 12, 24, OperandKind::Imm16},  // CC
+    {"CALL {}", 3, 24, 24, OperandKind::Imm16},  // CD
+    {"ADC A, {}", 2, 8, 8, OperandKind::Imm8},  // CE
+    {"RST $08", 1, 16, 16, OperandKind::None},  // CF
+    {"RET NC", 1, 8, 20, OperandKind::None},  // D0
+    {"POP DE", 1, 12, 12, OperandKind::None},  // D1
+    {"JP NC, {}", 3, 12, 16, OperandKind::Imm16},  // D2
+    {nullptr, 1, 4, 4, OperandKind::None},  // D3
+    {"CALL NC, {}", 3, 12, 24, OperandKind::Imm16},  // D4
+    {"PUSH DE", 1, 16, 16, OperandKind::None},  // D5
+    {"SUB A, {}", 2, 8, 8, OperandKind::Imm8},  // D6
+    {"RST $10", 1, 16, 16, OperandKind::None},  // D7
+    {"RET C", 1, 8, 20, OperandKind::None},  // D8
+    {"RETI", 1, 16, 16, OperandKind::None},  // D9
+    {"JP C, {}", 3, 12, 16, OperandKind::Imm16},  // DA
+    {nullptr, 1, 4, 4, OperandKind::None},  // DB
+    {"CALL C, {}", 3, 12, 24, OperandKind::Imm16},  // DC
+    {nullptr, 1, 4, 4, OperandKind::None},  // DD
+    {"SBC A, {}", 2, 8, 8, OperandKind::Imm8},  // DE
+    {"RST $18", 1, 16, 16, OperandKind::None},  // DF
+    {"LDH [{}], A", 2, 12, 12, OperandKind::HighPage},  // E0
+    {"POP HL", 1, 12, 12, OperandKind::None},  // E1
+    {"LDH [C], A", 1, 8, 8, OperandKind::None},  // E2
+    {nullptr, 1, 4, 4, OperandKind::None},  // E3
+    {nullptr, 1, 4, 4, OperandKind::None},  // E4
+    {"PUSH HL", 1, 16, 16, OperandKind::None},  // E5
+    {"AND A, {}", 2, 8, 8, OperandKind::Imm8},  // E6
+    {"RST $20", 1, 16, 16, OperandKind::None},  // E7
+    {"ADD SP, {}", 2, 16, 16, OperandKind::Signed},  // E8
+    {"JP HL", 1, 4, 4, OperandKind::None},  // E9
+    {"LD [{}], A", 3, 16, 16, OperandKind::Imm16},  // EA
+    {nullptr, 1, 4, 4, OperandKind::None},  // EB
+    {nullptr, 1, 4, 4, OperandKind::None},  // EC
+    {nullptr, 1, 4, 4, OperandKind::None},  // ED
+    {"XOR A, {}", 2, 8, 8, OperandKind::Imm8},  // EE
+    {"RST $28", 1, 16, 16, OperandKind::None},  // EF
+    {"LDH A, [{}]", 2, 12, 12, OperandKind::HighPage},  // F0
+    {"POP AF", 1, 12, 12, OperandKind::None},  // F1
+    {"LDH A, [C]", 1, 8, 8, OperandKind::None},  // F2
+    {"DI", 1, 4, 4, OperandKind::None},  // F3
+    {nullptr, 1, 4, 4, OperandKind::None},  // F4
+    {"PUSH AF", 1, 16, 16, OperandKind::None},  // F5
+    {"OR A, {}", 2, 8, 8, OperandKind::Imm8},  // F6
+    {"RST $30", 1, 16, 16, OperandKind::None},  // F7
+    {"LD HL, SP + {}", 2, 12, 12, OperandKind::Signed},  // F8
+    {"LD SP, HL", 1, 8, 8, OperandKind::None},  // F9
+    {"LD A, [{}]", 3, 16, 16, OperandKind::Imm16},  // FA
+    {"EI", 1, 4, 4, OperandKind::None},  // FB
+    {nullptr, 1, 4, 4, OperandKind::None},  // FC
+    {nullptr, 1, 4, 4, OperandKind::None},  // FD
+    {"CP A, {}", 2, 8, 8, OperandKind::Imm8},  // FE
+    {"RST $38", 1, 16, 16, OperandKind::None},  // FF
+    // $CB
+    PREFIXED_ROW("RLC", 8, 16), PREFIXED_ROW("RRC", 8, 16), PREFIXED_ROW("RL", 8, 16), PREFIXED_ROW("RR", 8, 16),
+    PREFIXED_ROW("SLA", 8, 16), PREFIXED_ROW("SRA", 8, 16), PREFIXED_ROW("SWAP", 8, 16), PREFIXED_ROW("SRL", 8, 16),
+    PREFIXED_BIT_ROWS("BIT", 12),
+    PREFIXED_BIT_ROWS("RES", 16),
+    PREFIXED_BIT_ROWS("SET", 16),
+}};
+
+#undef PREFIXED_BIT_ROWS
+#undef PREFIXED_ROW
+
+constexpr const OpcodeInfo& Opcode(u8 opcode) {
+  return kOpcodes[opcode];
+}
+
+constexpr const OpcodeInfo& PrefixedOpcode(u8 opcode) {
+  return kOpcodes[0x100 | opcode];
+}
+
+static_assert(Opcode(0xCD).length == 3 && Opcode(0xCD).cycles == 24);
+static_assert(PrefixedOpcode(0x46).cycles == 12 && PrefixedOpcode(0xFF).length == 2);
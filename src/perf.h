@@ -0,0 +1,27 @@
+#pragma once
+
+#include "memory.h"
+#include <atomic>
+
+// Numbers behind the performance HUD.
+//
+// The emulation thread adds them up in plain members of the emulator and publishes
+// them here once per emulated frame, the UI only reads these and turns the
+// differences between its own samples into rates.
+struct PerfCounters {
+  // every kSampledSteps-th step is timed, its CPU and PPU time stand for the others
+  static constexpr u32 kSampledSteps = 64;
+  // emulated time between two publishes, a frame at 59.73Hz
+  static constexpr u64 kPublishTicks = SCHEDULER_CLOCK_SPEED / 59.73;
+
+  // totals since the cartridge was loaded
+  std::atomic<u64> frames = 0;
+  std::atomic<u64> instructions = 0;
+  std::atomic<u64> cycles = 0;
+  std::atomic<u64> ticks = 0;
+  std::atomic<u64> cpu_ns = 0;
+  std::atomic<u64> ppu_ns = 0;
+  // accesses during the last published frame, built with COUNT_BUS_ACCESSES
+  std::array<std::atomic<u32>, kBusRegionCount> reads{};
+  std::array<std::atomic<u32>, kBusRegionCount> writes{};
+};
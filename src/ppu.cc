@@ -1,20 +1,56 @@
 #include "ppu.h"
+#include "state.h"
 
 PPU::PPU(EventBus& event_bus, CPU& cpu, MemoryBus& bus, TextureWrapper& output_wrapper) : event_bus_(event_bus), cpu_(cpu), bus_(bus), output_wrapper_(output_wrapper) {
-  SetClockSpeed(BASE_PPU_CLOCK_SPEED);
   event_bus_.Subscribe(BIND_FN(OnEvent));
+  Reset();
 }
 
+void PPU::Reset() {
+  SetClockSpeed(BASE_PPU_CLOCK_SPEED);
+  vblank_lines_ = 0;
+  hblank_wait_ = 0;
+  draw_took_ = 0;
+  draw_done_ = false;
+  frame_complete_ = false;
+  frames_rendered_ = 0;
+  frame_count_ = 0;
+  std::fill(std::begin(current_line_objects_), std::end(current_line_objects_), 0);
+  current_line_object_num_ = 0;
+  oam_scan_index_ = 0;
+  lx_ = 0;
+  mod_scx_ = 0;
+  bg_fifo_.Reset();
+  oam_fifo_.Reset();
+  was_enabled_ = true;
+  output_wrapper_.Fill({255, 255, 255, 255});
+}
+
+template<typename Archive>
+void PPU::Serialize(Archive& archive) {
+  archive(clock_speed_, vblank_lines_, hblank_wait_, draw_took_, draw_done_, frame_complete_, frames_rendered_,
+          frame_count_);
+  archive(current_line_objects_, current_line_object_num_, oam_scan_index_, lx_, mod_scx_, bg_fifo_, oam_fifo_,
+          was_enabled_);
+}
+
+template void PPU::Serialize(StateWriter& archive);
+template void PPU::Serialize(StateReader& archive);
+
 PPU::~PPU() {
   // todo unsub from event bus
 }
 
+// zone names by the mode a dot starts in
+static constexpr const char* kModeZones[] = {"PPU::Step HBlank", "PPU::Step VBlank", "PPU::Step OAM scan", "PPU::Step draw"};
+
 void PPU::Step() {
+  INSTRUMENT_FINE_ZONE(kModeZones[cpu_.lcds_.bits.ppu_mode]);
   if (was_enabled_ != cpu_.lcdc_.bits.lcd_enable) {
     was_enabled_ = cpu_.lcdc_.bits.lcd_enable;
     frames_rendered_ = 0;
     output_wrapper_.Fill({255, 255, 255, 255});
-    std::cout << "display enable changed: " << BoolToStr(was_enabled_) << std::endl;
+    //std::cout << "display enable changed: " << BoolToStr(was_enabled_) << std::endl;
   }
   if (!cpu_.lcdc_.bits.lcd_enable) {
     vblank_lines_ = 0;
@@ -61,6 +97,10 @@ void PPU::Step() {
       vblank_lines_ = 10;
       hblank_wait_ = 456;
       frame_complete_ = true;
+      frame_count_++;
+      EMIT_FRAME(bus_);
+      COVERAGE_FRAME();
+      INSTRUMENT_FLUSH_COUNTERS();
     } else {
       SetMode(kPPUModeOAMScan);
       oam_scan_index_ = 0;
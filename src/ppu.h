@@ -52,6 +52,11 @@ class PPU {
   bool OnLCDControlChange(LCDControlChangeEvent& event);
 
   void ResetFrame();
+  // back to the state after power on, clears the output
+  void Reset();
+  // the state between dots, both ways, see state.h, the output image isn't part of it
+  template<typename Archive>
+  void Serialize(Archive& archive);
 
   // for final rendering
   void FillImage(Colori color);
@@ -78,6 +83,7 @@ class PPU {
   bool draw_done_ = false;
   bool frame_complete_ = false;
   u32 frames_rendered_ = 0;
+  u64 frame_count_ = 0; // frames since power on, only counted while the LCD is on
   u16 current_line_objects_[10];
   u8 current_line_object_num_ = 0;
   u8 oam_scan_index_;
@@ -0,0 +1,225 @@
+#include "profiler.h"
+#include "cpu.h"
+#include "symbols.h"
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+#ifdef ENABLE_PROFILER
+
+namespace Profiler {
+
+// a node per distinct call path, node 0 is the code outside of any call
+struct Node {
+  u32 parent;
+  u32 function; // Key of the call target
+  u64 cycles; // charged while this was the innermost call
+  u64 halted_cycles;
+};
+
+struct Frame {
+  u16 return_address;
+  u32 node; // the caller's
+};
+
+// games that never return (and pop the address instead) would grow the stack
+// forever, past this it starts over from the top
+static constexpr size_t kMaxDepth = 256;
+// keys that aren't addresses
+static constexpr u32 kHalted = 0xFFFFFFFF;
+static constexpr u32 kTop = 0xFFFFFFFE;
+
+u64 next_sample_ = UINT64_MAX;
+
+static bool running_ = false;
+static std::string rom_path_;
+static u32 period_ = 1;
+
+static std::vector<Node> nodes_;
+static std::unordered_map<u64, u32> children_; // (parent << 32) | function
+static std::vector<Frame> frames_;
+static u32 node_ = 0;
+
+static std::unordered_map<u32, u64> hot_spots_; // Key of the PC, or kHalted
+static std::unordered_map<u32, u64> calls_;
+
+// what the previous sample saw, it gets the cycles up to the next one
+static bool sampled_ = false;
+static u64 sample_cycles_ = 0;
+static u32 sample_key_ = 0;
+static u32 sample_node_ = 0;
+
+static u32 Key(u16 bank, u16 address) { return (bank << 16) | address; }
+
+void Start(const std::string& rom_path, u32 period) {
+  Stop();
+  running_ = true;
+  rom_path_ = rom_path;
+  period_ = std::max<u32>(period, 1);
+  nodes_ = {{0, kTop, 0, 0}};
+  children_.clear();
+  frames_.clear();
+  node_ = 0;
+  hot_spots_.clear();
+  calls_.clear();
+  sampled_ = false;
+  next_sample_ = 0;
+}
+
+void Sample(CPU& cpu) {
+  u64 now = cpu.cycle_count_;
+  if (sampled_) {
+    u64 cycles = now - sample_cycles_;
+    hot_spots_[sample_key_] += cycles;
+    Node& node = nodes_[sample_node_];
+    (sample_key_ == kHalted ? node.halted_cycles : node.cycles) += cycles;
+  }
+  u16 pc = cpu.registers_.pc;
+  sampled_ = true;
+  sample_cycles_ = now;
+  sample_key_ = cpu.halted_ ? kHalted : Key(cpu.CodeBank(pc), pc);
+  sample_node_ = node_;
+  next_sample_ = now + period_;
+}
+
+void OnCall(CPU& cpu, u16 return_address, u16 target) {
+  if (!running_) {
+    return;
+  }
+  if (frames_.size() == kMaxDepth) {
+    frames_.clear();
+    node_ = 0;
+  }
+  u32 function = Key(cpu.CodeBank(target), target);
+  calls_[function]++;
+  frames_.push_back({return_address, node_});
+  auto [it, inserted] = children_.try_emplace(((u64) node_ << 32) | function, nodes_.size());
+  if (inserted) {
+    nodes_.push_back({node_, function, 0, 0});
+  }
+  node_ = it->second;
+}
+
+void OnReturn(u16 return_address) {
+  // returns that don't match a call (jump tables pushing their target) leave the stack
+  // alone, ones that skip frames (popped return addresses) unwind to the matching call
+  for (size_t i = frames_.size(); i-- > 0;) {
+    if (frames_[i].return_address == return_address) {
+      node_ = frames_[i].node;
+      frames_.resize(i);
+      return;
+    }
+  }
+}
+
+static std::string FunctionName(const SymbolTable& symbols, u32 key) {
+  if (key == kHalted) {
+    return "<halted>";
+  }
+  if (key == kTop) {
+    return "<top>";
+  }
+  return symbols.Name(key >> 16, key & 0xFFFF);
+}
+
+static void WriteFolded(const std::string& path, const SymbolTable& symbols) {
+  std::ofstream output(path);
+  std::vector<u32> path_nodes;
+  for (u32 i = 0; i < nodes_.size(); i++) {
+    const Node& node = nodes_[i];
+    if (node.cycles == 0 && node.halted_cycles == 0) {
+      continue;
+    }
+    path_nodes.clear();
+    for (u32 n = i; n != 0; n = nodes_[n].parent) {
+      path_nodes.push_back(n);
+    }
+    std::string stack = "<top>";
+    for (auto it = path_nodes.rbegin(); it != path_nodes.rend(); ++it) {
+      stack += ';';
+      stack += FunctionName(symbols, nodes_[*it].function);
+    }
+    if (node.cycles != 0) {
+      output << stack << ' ' << node.cycles << '\n';
+    }
+    if (node.halted_cycles != 0) {
+      output << stack << ";<halted> " << node.halted_cycles << '\n';
+    }
+  }
+}
+
+static void WriteReport(const std::string& path, const SymbolTable& symbols) {
+  struct Function {
+    u64 self = 0;
+    u64 total = 0; // with everything it called, recursion counted once
+    u64 calls = 0;
+  };
+  std::unordered_map<u32, Function> functions;
+  u64 total = 0;
+  std::vector<u32> seen;
+  for (u32 i = 0; i < nodes_.size(); i++) {
+    u64 cycles = nodes_[i].cycles + nodes_[i].halted_cycles;
+    if (cycles == 0) {
+      continue;
+    }
+    total += cycles;
+    functions[nodes_[i].function].self += cycles;
+    seen.clear();
+    for (u32 n = i;; n = nodes_[n].parent) {
+      u32 key = nodes_[n].function;
+      if (std::find(seen.begin(), seen.end(), key) == seen.end()) {
+        seen.push_back(key);
+        functions[key].total += cycles;
+      }
+      if (n == 0) {
+        break;
+      }
+    }
+  }
+  for (auto [key, calls] : calls_) {
+    functions[key].calls = calls;
+  }
+
+  auto percent = [total](u64 cycles) { return total == 0 ? 0.0 : 100.0 * cycles / total; };
+
+  std::ofstream output(path);
+  output << fmt::format("{}: {} T-cycles, sampled every {}\n\n", rom_path_, total, period_);
+
+  std::vector<std::pair<u32, Function>> by_total(functions.begin(), functions.end());
+  std::sort(by_total.begin(), by_total.end(), [](auto& a, auto& b) { return a.second.total > b.second.total; });
+  output << fmt::format("{:>14} {:>6} {:>14} {:>6} {:>10}  {}\n", "total", "%", "self", "%", "calls", "function");
+  for (auto& [key, function] : by_total) {
+    output << fmt::format("{:>14} {:>6.2f} {:>14} {:>6.2f} {:>10}  {}\n", function.total, percent(function.total),
+                          function.self, percent(function.self), function.calls,
+                          FunctionName(symbols, key));
+  }
+
+  std::vector<std::pair<u32, u64>> hot_spots(hot_spots_.begin(), hot_spots_.end());
+  std::sort(hot_spots.begin(), hot_spots.end(), [](auto& a, auto& b) { return a.second > b.second; });
+  hot_spots.resize(std::min<size_t>(hot_spots.size(), 100));
+  output << fmt::format("\n{:>14} {:>6}  {:<7}  {}\n", "cycles", "%", "address", "location");
+  for (auto [key, cycles] : hot_spots) {
+    std::string address = key == kHalted ? "" : fmt::format("{:02X}:{:04X}", key >> 16, key & 0xFFFF);
+    output << fmt::format("{:>14} {:>6.2f}  {:<7}  {}\n", cycles, percent(cycles), address, FunctionName(symbols, key));
+  }
+}
+
+void Stop() {
+  if (!running_) {
+    return;
+  }
+  running_ = false;
+  next_sample_ = UINT64_MAX;
+
+  SymbolTable symbols;
+  symbols.Load(std::filesystem::path(rom_path_).replace_extension(".sym").string());
+  std::filesystem::create_directories("profile");
+  std::string base = "profile/" + std::filesystem::path(rom_path_).stem().string();
+  WriteFolded(base + ".folded", symbols);
+  WriteReport(base + ".txt", symbols);
+  std::cout << "wrote the profile to " << base << ".folded and " << base << ".txt" << std::endl;
+}
+
+}
+
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "util.h"
+
+// Guest code profiler, built with -DPROFILE=<period>.
+//
+// Every period T-cycles the emulator hands the CPU to Sample, which charges the
+// cycles since the last sample to the (bank, PC) of the instruction seen then and
+// to the call stack it ran under. A period of 1 charges every instruction exactly,
+// larger ones are a sampling profiler whose cost is one compare per step.
+//
+// The call stack is a tree built from the calls, RSTs, interrupts and returns the
+// instructions report, so a sample only adds to a node. Stop writes flamegraph
+// folded stacks and a table of functions and hot spots, named from the ROM's .sym
+// file when there is one.
+
+#ifdef PROFILE
+#define ENABLE_PROFILER
+#endif
+
+class CPU;
+
+namespace Profiler {
+
+// T-cycle count the next sample is due at
+extern u64 next_sample_;
+
+// starts a new profile of the ROM at rom_path, the reports go to
+// profile/<rom>.folded and profile/<rom>.txt
+void Start(const std::string& rom_path, u32 period);
+// writes the reports of the current profile, if any
+void Stop();
+
+void Sample(CPU& cpu);
+
+inline void OnStep(u64 cycle_count, CPU& cpu) {
+  if (cycle_count >= next_sample_) {
+    Sample(cpu);
+  }
+}
+
+// return_address is the PC pushed by the call
+void OnCall(CPU& cpu, u16 return_address, u16 target);
+void OnReturn(u16 return_address);
+
+}
+
+#ifdef ENABLE_PROFILER
+#define START_PROFILER(rom_path) Profiler::Start(rom_path, PROFILE)
+#define STOP_PROFILER() Profiler::Stop()
+#define PROFILE_STEP(cpu) Profiler::OnStep((cpu).cycle_count_, cpu)
+#define PROFILE_CALL(cpu, return_address, target) Profiler::OnCall(cpu, return_address, target)
+#define PROFILE_RET(return_address) Profiler::OnReturn(return_address)
+#else
+#define START_PROFILER(rom_path)
+#define STOP_PROFILER()
+#define PROFILE_STEP(cpu)
+#define PROFILE_CALL(cpu, return_address, target)
+#define PROFILE_RET(return_address)
+#endif
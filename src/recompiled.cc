@@ -0,0 +1,48 @@
+#include "recompiled.h"
+#include <dlfcn.h>
+
+std::unique_ptr<RecompiledCode> RecompiledCode::Load(const std::string& directory, const std::vector<u8>& rom) {
+  u64 hash = Recompiled::HashRom(rom);
+  std::string path = fmt::format("{}/{:016x}.so", directory, hash);
+  void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (!handle) {
+    return nullptr;
+  }
+  auto function = (Recompiled::ModuleFunction) dlsym(handle, RECOMPILED_MODULE_SYMBOL);
+  const Recompiled::Module* module = function ? function() : nullptr;
+  if (!module || module->version != Recompiled::kModuleVersion || module->cpu_size != sizeof(CPU) || module->rom_hash != hash) {
+    std::cout << "ignoring recompiled code in " << path << ", it was built for another rom or build" << std::endl;
+    dlclose(handle);
+    return nullptr;
+  }
+  std::cout << "loaded " << module->block_count << " recompiled blocks from " << path << std::endl;
+  return std::unique_ptr<RecompiledCode>(new RecompiledCode(handle, *module));
+}
+
+RecompiledCode::RecompiledCode(void* handle, const Recompiled::Module& module) : handle_(handle) {
+  blocks_.reserve(module.block_count);
+  for (u32 i = 0; i < module.block_count; i++) {
+    const Recompiled::Block& block = module.blocks[i];
+    blocks_[Key(block.bank, block.address)] = block.function;
+  }
+}
+
+RecompiledCode::~RecompiledCode() {
+  dlclose(handle_);
+}
+
+bool RecompiledCode::Step(CPU& cpu) {
+  u16 pc = cpu.registers_.pc;
+  // the blocks were built from the cartridge, not the boot rom or RAM, pending
+  // interrupts and the halt bug need the interpreter's single steps
+  if (pc > CARTRIDGE_ROM_01_END_ADDRESS || !cpu.boot_unloaded_ || cpu.check_interrupts_ || cpu.halt_bug_) {
+    return false;
+  }
+  u16 bank = pc < CARTRIDGE_ROM_01_START_ADDRESS ? 0 : cpu.cartridge_->rom_bank();
+  auto it = blocks_.find(Key(bank, pc));
+  if (it == blocks_.end()) {
+    return false;
+  }
+  cpu.cycles_consumed_ = it->second(cpu);
+  return true;
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "alu_tables.h"
+#include "cpu.h"
+#include <unordered_map>
+
+// Ahead-of-time recompiled ROM code.
+//
+// laneboy-recompile turns the reachable code of a ROM into one C++ function per
+// block, the result is built as a shared library named after the ROM hash and
+// loaded next to the interpreter. A block runs until it branches, reaches an
+// instruction it doesn't translate or a write that may change the memory map,
+// then leaves the PC on the next instruction for the interpreter or the next block.
+
+namespace Recompiled {
+
+// bump whenever the helpers below or the Block/Module layout change
+constexpr u32 kModuleVersion = 1;
+
+// runs the block starting at the current PC, returns the T-cycles it used
+using BlockFunction = u32 (*)(CPU& cpu);
+
+struct Block {
+  u16 bank; // 0 for addresses below $4000
+  u16 address;
+  BlockFunction function;
+};
+
+struct Module {
+  u32 version;
+  u32 cpu_size; // catches plugins built with other flags, LAZY_FLAGS changes the layout
+  u64 rom_hash;
+  u32 block_count;
+  const Block* blocks;
+};
+
+#define RECOMPILED_MODULE_SYMBOL "laneboy_recompiled_module"
+using ModuleFunction = const Module* (*)();
+
+// FNV-1a over the whole ROM image
+inline u64 HashRom(const std::vector<u8>& data) {
+  u64 hash = 0xCBF29CE484222325ull;
+  for (u8 b : data) {
+    hash ^= b;
+    hash *= 0x100000001B3ull;
+  }
+  return hash;
+}
+
+// Helpers used by the generated code, they mirror the instruction handlers
+
+inline u16 Word(CPU& cpu, u8 offset) {
+  u16 value;
+  std::memcpy(&value, &cpu.registers_.file[offset], sizeof(value));
+  return value;
+}
+
+inline void SetWord(CPU& cpu, u8 offset, u16 value) {
+  std::memcpy(&cpu.registers_.file[offset], &value, sizeof(value));
+}
+
+// leaves the block with the PC on the next instruction to run
+inline u32 Exit(CPU& cpu, u16 pc, u32 count, u32 cycles) {
+  cpu.registers_.pc = pc;
+  cpu.ic_ += count;
+  return cycles;
+}
+
+// returns true when the block has to be left after the write, a write below $8000
+// may switch the ROM bank and IE/IF writes may raise an interrupt
+inline bool Write(CPU& cpu, u16 address, u8 value) {
+  cpu.bus_.Write(address, value);
+  return address < 0x8000 || cpu.check_interrupts_;
+}
+
+// same as Write for the two bytes pushed on the stack
+inline bool Push(CPU& cpu, u16 value) {
+  cpu.Push(value);
+  return Word(cpu, RegisterOffset(ArithmeticTarget::SP)) < 0x8000 || cpu.check_interrupts_;
+}
+
+// ADD, ADC, SUB, SBC, AND, XOR, OR, CP on A
+inline void Arithmetic(CPU& cpu, u8 op, u8 value) {
+  u8& a = cpu.registers_.file[RegisterOffset(ArithmeticTarget::A)];
+  switch (op) {
+    case 0: a = cpu.alu.Add(a, value); break;
+    case 1: a = cpu.alu.AddWithCarry(a, value); break;
+    case 2: a = cpu.alu.Sub(a, value); break;
+    case 3: a = cpu.alu.SubWithCarry(a, value); break;
+    case 4:
+      a &= value;
+      cpu.registers_.flags.FromByte(a == 0 ? 0xA0 : 0x20);
+      break;
+    case 5:
+      a ^= value;
+      cpu.registers_.flags.FromByte(a == 0 ? 0x80 : 0x00);
+      break;
+    case 6:
+      a |= value;
+      cpu.registers_.flags.FromByte(a == 0 ? 0x80 : 0x00);
+      break;
+    case 7: cpu.alu.Sub(a, value); break;
+  }
+}
+
+// ADD HL, rr
+inline void AddHL(CPU& cpu, u16 value) {
+  u16 hl = Word(cpu, RegisterOffset(ArithmeticTarget::HL));
+  u32 result = (u32)hl + value;
+  cpu.registers_.flags.subtract(false);
+  cpu.registers_.flags.carry(result > 0xFFFF);
+  cpu.registers_.flags.half_carry(((hl & 0xFFF) + (value & 0xFFF)) & 0x1000);
+  SetWord(cpu, RegisterOffset(ArithmeticTarget::HL), result);
+}
+
+// RLCA, RRCA, RLA, RRA
+inline void RotateA(CPU& cpu, ShiftOp op) {
+  u8& a = cpu.registers_.file[RegisterOffset(ArithmeticTarget::A)];
+  u16 entry;
+  switch (op) {
+    case ShiftOp::RLC: entry = kShiftTable<ShiftOp::RLC>[a]; break;
+    case ShiftOp::RRC: entry = kShiftTable<ShiftOp::RRC>[a]; break;
+    case ShiftOp::RL: entry = kShiftTable<ShiftOp::RL>[(cpu.registers_.flags.carry() << 8) | a]; break;
+    default: entry = kShiftTable<ShiftOp::RR>[(cpu.registers_.flags.carry() << 8) | a]; break;
+  }
+  cpu.registers_.flags.FromByte(entry & kFlagCarry);
+  a = entry >> 8;
+}
+
+inline void DAA(CPU& cpu) {
+  Flags& flags = cpu.registers_.flags;
+  u8& a = cpu.registers_.file[RegisterOffset(ArithmeticTarget::A)];
+  u16 entry = kDAATable[(flags.subtract() << 10) | (flags.half_carry() << 9) | (flags.carry() << 8) | a];
+  flags.FromByte(entry & 0xFF);
+  a = entry >> 8;
+}
+
+// one $CB opcode, returns true like Write when it wrote to memory
+inline bool Prefixed(CPU& cpu, u8 cb) {
+  constexpr u8 kOffsets[8] = {
+      RegisterOffset(ArithmeticTarget::B), RegisterOffset(ArithmeticTarget::C),
+      RegisterOffset(ArithmeticTarget::D), RegisterOffset(ArithmeticTarget::E),
+      RegisterOffset(ArithmeticTarget::H), RegisterOffset(ArithmeticTarget::L),
+      0, RegisterOffset(ArithmeticTarget::A)};
+  u8 operand = cb & 0x7;
+  u8 bit = (cb >> 3) & 0x7;
+  bool memory = operand == 6;
+  u16 hl = Word(cpu, RegisterOffset(ArithmeticTarget::HL));
+  u8 value = memory ? cpu.bus_.Read(hl) : cpu.registers_.file[kOffsets[operand]];
+  Flags& flags = cpu.registers_.flags;
+  switch (cb >> 6) {
+    case 0: {
+      u16 index = (flags.carry() << 8) | value;
+      u16 entry = 0;
+      switch ((ShiftOp)bit) {
+        case ShiftOp::RLC: entry = kShiftTable<ShiftOp::RLC>[index]; break;
+        case ShiftOp::RRC: entry = kShiftTable<ShiftOp::RRC>[index]; break;
+        case ShiftOp::RL: entry = kShiftTable<ShiftOp::RL>[index]; break;
+        case ShiftOp::RR: entry = kShiftTable<ShiftOp::RR>[index]; break;
+        case ShiftOp::SLA: entry = kShiftTable<ShiftOp::SLA>[index]; break;
+        case ShiftOp::SRA: entry = kShiftTable<ShiftOp::SRA>[index]; break;
+        case ShiftOp::SWAP: entry = kShiftTable<ShiftOp::SWAP>[index]; break;
+        case ShiftOp::SRL: entry = kShiftTable<ShiftOp::SRL>[index]; break;
+      }
+      flags.FromByte(entry & 0xFF);
+      value = entry >> 8;
+      break;
+    }
+    case 1:
+      flags.zero((value & (1 << bit)) == 0);
+      flags.half_carry(true);
+      flags.subtract(false);
+      return false;
+    case 2:
+      value &= ~(1 << bit);
+      break;
+    case 3:
+      value |= 1 << bit;
+      break;
+  }
+  if (memory) {
+    return Write(cpu, hl, value);
+  }
+  cpu.registers_.file[kOffsets[operand]] = value;
+  return false;
+}
+
+}
+
+// A loaded recompiled module for the running ROM
+class RecompiledCode {
+ public:
+  // loads <directory>/<rom hash>.so, returns nullptr if there is none or it doesn't match
+  static std::unique_ptr<RecompiledCode> Load(const std::string& directory, const std::vector<u8>& rom);
+
+  RecompiledCode(const RecompiledCode&) = delete;
+  ~RecompiledCode();
+
+  // runs the block at the current PC if there is one, the interpreter takes over otherwise
+  bool Step(CPU& cpu);
+
+  size_t block_count() const { return blocks_.size(); }
+
+ private:
+  RecompiledCode(void* handle, const Recompiled::Module& module);
+
+  static u32 Key(u16 bank, u16 address) { return ((u32)bank << 16) | address; }
+
+  void* handle_;
+  std::unordered_map<u32, Recompiled::BlockFunction> blocks_;
+};
@@ -0,0 +1,327 @@
+#include "recompiler.h"
+#include "disassembler.h"
+#include "idioms.h"
+#include "opcodes.h"
+#include "recompiled.h"
+#include <fmt/format.h>
+
+// B, C, D, E, H, L, [HL], A as encoded in the operand bits of an opcode
+static constexpr const char* kOperands[8] = {"B", "C", "D", "E", "H", "L", nullptr, "A"};
+static constexpr const char* kPairs[4] = {"BC", "DE", "HL", "SP"};
+static constexpr const char* kConditions[4] = {"!f.zero()", "f.zero()", "!f.carry()", "f.carry()"};
+static constexpr const char* kRotates[4] = {"ShiftOp::RLC", "ShiftOp::RRC", "ShiftOp::RL", "ShiftOp::RR"};
+
+static constexpr u16 kEntryPoint = 0x0100;
+static constexpr u16 kInterruptVectors[] = {0x40, 0x48, 0x50, 0x58, 0x60};
+
+Recompiler::Recompiler(const std::vector<u8>& rom) : rom_(rom) {
+  rom_hash_ = Recompiled::HashRom(rom);
+  // the cartridge keeps the selected bank in a byte
+  bank_count_ = std::min<size_t>(rom.size() / CARTRIDGE_ROM_SIZE, 0x100);
+}
+
+const u8* Recompiler::Code(u16 bank, u16 address) const {
+  size_t offset = address < CARTRIDGE_ROM_01_START_ADDRESS ? address : bank * CARTRIDGE_ROM_SIZE + address - CARTRIDGE_ROM_01_START_ADDRESS;
+  if (address > CARTRIDGE_ROM_01_END_ADDRESS || offset >= rom_.size()) {
+    return nullptr;
+  }
+  return &rom_[offset];
+}
+
+void Recompiler::Seed(u16 bank, u16 target) {
+  if (target < CARTRIDGE_ROM_01_START_ADDRESS) {
+    worklist_.push_back(Key(0, target));
+  } else if (target <= CARTRIDGE_ROM_01_END_ADDRESS) {
+    if (bank != 0) {
+      worklist_.push_back(Key(bank, target));
+      return;
+    }
+    // we don't know which bank the fixed bank switched in, try all of them
+    for (u16 i = 1; i < bank_count_; i++) {
+      worklist_.push_back(Key(i, target));
+    }
+  }
+  // code in RAM can change at any time, it is left to the interpreter
+}
+
+void Recompiler::Analyze() {
+  Seed(0, kEntryPoint);
+  // RST vectors
+  for (u16 address = 0x00; address <= 0x38; address += 0x08) {
+    Seed(0, address);
+  }
+  for (u16 address : kInterruptVectors) {
+    Seed(0, address);
+  }
+  while (!worklist_.empty()) {
+    u32 key = worklist_.back();
+    worklist_.pop_back();
+    if (!visited_.insert(key).second) {
+      continue;
+    }
+    std::string body;
+    if (Translate(key >> 16, key & 0xFFFF, body)) {
+      blocks_[key] = std::move(body);
+    }
+  }
+}
+
+bool Recompiler::Translate(u16 bank, u16 address, std::string& body) {
+  u16 pc = address;
+  u32 count = 0;
+  u32 cycles = 0;
+  // region the block started in, it doesn't run into the next one
+  bool fixed = address < CARTRIDGE_ROM_01_START_ADDRESS;
+  u32 region_end = fixed ? CARTRIDGE_ROM_01_START_ADDRESS : CARTRIDGE_ROM_01_END_ADDRESS + 1;
+
+  auto line = [&](const std::string& text) {
+    body += "  ";
+    body += text;
+    body += '\n';
+  };
+  // leaves in front of the current instruction
+  auto exit = [&](const std::string& target) {
+    return fmt::format("return Exit(cpu, {}, {}, {});", target, count, cycles);
+  };
+  // leaves after the current instruction took extra cycles
+  auto exit_after = [&](const std::string& target, u32 extra) {
+    return fmt::format("return Exit(cpu, {}, {}, {});", target, count + 1, cycles + extra);
+  };
+  auto hex = [](u16 value) { return fmt::format("0x{:04X}", value); };
+
+  // copy and fill loops start at the target of their own jump, the CPU runs them natively
+  if (const u8* code = Code(bank, address)) {
+    if (MatchLoopIdiom(code, region_end - address)) {
+      line("if (u32 used = cpu.RunIdiom(CPU::kIdiomSliceCycles)) return used;");
+    }
+  }
+
+  while (true) {
+    // the instruction has to end in the region and in the ROM
+    const u8* code = pc < region_end ? Code(bank, pc) : nullptr;
+    size_t available = code ? std::min<size_t>(region_end - pc, rom_.data() + rom_.size() - code) : 0;
+    Disassembler::Instruction instruction = Disassembler::Decode({code, available}, pc);
+    bool in_region = instruction.valid();
+    if (!in_region || count == kMaxBlockInstructions) {
+      // the next block or the interpreter continues from here
+      if (count == 0) {
+        return false;
+      }
+      if (in_region) {
+        Seed(bank, pc);
+      }
+      line(exit(hex(pc)));
+      return true;
+    }
+
+    u8 opcode = instruction.bytes[0];
+    const OpcodeInfo& info = instruction.info(); // the $CB page entry for prefixed opcodes
+    u16 next = pc + instruction.length;
+    u16 operand = instruction.operand();
+    const char* dst = kOperands[(opcode >> 3) & 0x7];
+    const char* src = kOperands[opcode & 0x7];
+    const char* pair = kPairs[(opcode >> 4) & 0x3];
+    const char* condition = kConditions[(opcode >> 3) & 0x3];
+    std::string comment = fmt::format("// {:04X}:", pc);
+    for (u8 i = 0; i < instruction.length; i++) {
+      comment += fmt::format(" {:02X}", instruction.bytes[i]);
+    }
+    // the mnemonics line up after the longest instruction's bytes, "// 0000: 00 00 00"
+    comment.resize(18, ' ');
+    Disassembler::Format(instruction, comment);
+
+    // everything below is exactly the same as the instruction handlers, a write may
+    // switch the ROM bank or raise an interrupt so the block is left right after it
+    std::vector<std::string> statements;
+    u32 taken = info.cycles_taken;  // cycles if the block ends with this instruction
+    u32 cost = info.cycles;  // cycles if it continues
+    bool ends = false;
+    std::string write;  // "address, value" of a checked write
+    std::string target;
+
+    if (opcode == 0x00) {
+      // NOP
+    } else if ((opcode & 0xCF) == 0x01) {
+      statements.push_back(fmt::format("SetWord(cpu, {}, {});", pair, hex(operand)));
+    } else if (opcode == 0x02 || opcode == 0x12) {
+      write = fmt::format("Word(cpu, {}), r[A]", pair);
+    } else if (opcode == 0x22 || opcode == 0x32) {
+      statements.push_back("u16 hl = Word(cpu, HL);");
+      statements.push_back(fmt::format("SetWord(cpu, HL, hl {} 1);", opcode == 0x22 ? '+' : '-'));
+      write = "hl, r[A]";
+    } else if (opcode == 0x0A || opcode == 0x1A) {
+      statements.push_back(fmt::format("r[A] = cpu.bus_.Read(Word(cpu, {}));", pair));
+    } else if (opcode == 0x2A || opcode == 0x3A) {
+      statements.push_back("u16 hl = Word(cpu, HL);");
+      statements.push_back("r[A] = cpu.bus_.Read(hl);");
+      statements.push_back(fmt::format("SetWord(cpu, HL, hl {} 1);", opcode == 0x2A ? '+' : '-'));
+    } else if ((opcode & 0xC7) == 0x03) {
+      statements.push_back(fmt::format("SetWord(cpu, {0}, Word(cpu, {0}) {1} 1);", pair, opcode & 0x08 ? '-' : '+'));
+    } else if ((opcode & 0xC6) == 0x04 && dst) {
+      statements.push_back(fmt::format("r[{0}] = cpu.alu.{1}(r[{0}]);", dst, opcode & 1 ? "Dec" : "Inc"));
+    } else if (opcode == 0x34 || opcode == 0x35) {
+      statements.push_back("u16 hl = Word(cpu, HL);");
+      write = fmt::format("hl, cpu.alu.{}(cpu.bus_.Read(hl))", opcode & 1 ? "Dec" : "Inc");
+    } else if ((opcode & 0xC7) == 0x06 && dst) {
+      statements.push_back(fmt::format("r[{}] = 0x{:02X};", dst, operand));
+    } else if (opcode == 0x36) {
+      write = fmt::format("Word(cpu, HL), 0x{:02X}", operand);
+    } else if ((opcode & 0xE7) == 0x07) {
+      statements.push_back(fmt::format("RotateA(cpu, {});", kRotates[opcode >> 3]));
+    } else if ((opcode & 0xCF) == 0x09) {
+      statements.push_back(fmt::format("AddHL(cpu, Word(cpu, {}));", pair));
+    } else if (opcode == 0x27) {
+      statements.push_back("DAA(cpu);");
+    } else if (opcode == 0x2F) {
+      statements.push_back("r[A] = ~r[A];");
+      statements.push_back("f.subtract(true);");
+      statements.push_back("f.half_carry(true);");
+    } else if (opcode == 0x37 || opcode == 0x3F) {
+      statements.push_back(opcode == 0x37 ? "f.carry(true);" : "f.carry(!f.carry());");
+      statements.push_back("f.subtract(false);");
+      statements.push_back("f.half_carry(false);");
+    } else if (opcode == 0x18) {
+      target = hex(operand);
+      Seed(bank, operand);
+      ends = true;
+    } else if ((opcode & 0xE7) == 0x20) {
+      Seed(bank, operand);
+      statements.push_back(fmt::format("if ({}) {}", condition, exit_after(hex(operand), info.cycles_taken)));
+    } else if (opcode >= 0x40 && opcode < 0x80 && opcode != 0x76) {
+      if (dst && src) {
+        statements.push_back(fmt::format("r[{}] = r[{}];", dst, src));
+      } else if (dst) {
+        statements.push_back(fmt::format("r[{}] = cpu.bus_.Read(Word(cpu, HL));", dst));
+      } else {
+        write = fmt::format("Word(cpu, HL), r[{}]", src);
+      }
+    } else if (opcode >= 0x80 && opcode < 0xC0) {
+      u8 op = (opcode >> 3) & 0x7;
+      if (src) {
+        statements.push_back(fmt::format("Arithmetic(cpu, {}, r[{}]);", op, src));
+      } else {
+        statements.push_back(fmt::format("Arithmetic(cpu, {}, cpu.bus_.Read(Word(cpu, HL)));", op));
+      }
+    } else if ((opcode & 0xC7) == 0xC6) {
+      statements.push_back(fmt::format("Arithmetic(cpu, {}, 0x{:02X});", (opcode >> 3) & 0x7, operand));
+    } else if (opcode == 0xC9) {
+      target = "cpu.Pop()";
+      ends = true;
+    } else if ((opcode & 0xE7) == 0xC0) {
+      statements.push_back(fmt::format("if ({}) {}", condition, exit_after("cpu.Pop()", info.cycles_taken)));
+    } else if (opcode == 0xC1 || opcode == 0xD1 || opcode == 0xE1) {
+      statements.push_back(fmt::format("SetWord(cpu, {}, cpu.Pop());", pair));
+    } else if (opcode == 0xF1) {
+      statements.push_back("u16 af = cpu.Pop();");
+      statements.push_back("r[A] = af >> 8;");
+      statements.push_back("f.FromByte(af & 0xF0);");
+    } else if (opcode == 0xC3) {
+      target = hex(operand);
+      Seed(bank, operand);
+      ends = true;
+    } else if ((opcode & 0xE7) == 0xC2) {
+      Seed(bank, operand);
+      statements.push_back(fmt::format("if ({}) {}", condition, exit_after(hex(operand), info.cycles_taken)));
+    } else if (opcode == 0xE9) {
+      target = "Word(cpu, HL)";
+      ends = true;
+    } else if (opcode == 0xCD) {
+      // the return lands on the next instruction
+      Seed(bank, operand);
+      Seed(bank, next);
+      statements.push_back(fmt::format("cpu.Push({});", hex(next)));
+      target = hex(operand);
+      ends = true;
+    } else if ((opcode & 0xE7) == 0xC4) {
+      Seed(bank, operand);
+      Seed(bank, next);
+      statements.push_back(fmt::format("if ({}) {{", condition));
+      statements.push_back(fmt::format("  cpu.Push({});", hex(next)));
+      statements.push_back(fmt::format("  {}", exit_after(hex(operand), info.cycles_taken)));
+      statements.push_back("}");
+    } else if (opcode == 0xC5 || opcode == 0xD5 || opcode == 0xE5 || opcode == 0xF5) {
+      std::string value = opcode == 0xF5 ? "(r[A] << 8) | f.ToByte()" : fmt::format("Word(cpu, {})", pair);
+      statements.push_back(fmt::format("if (Push(cpu, {})) {}", value, exit_after(hex(next), info.cycles_taken)));
+    } else if (opcode == 0xCB) {
+      u8 prefixed = instruction.bytes[1];
+      bool memory = (prefixed & 0x7) == 6;
+      bool bit = (prefixed >> 6) == 1;
+      if (memory && !bit) {
+        write = fmt::format("0x{:02X}", prefixed);
+      } else {
+        statements.push_back(fmt::format("Prefixed(cpu, 0x{:02X});", prefixed));
+      }
+    } else if (opcode == 0xE0) {
+      write = fmt::format("{}, r[A]", hex(operand));
+    } else if (opcode == 0xF0) {
+      statements.push_back(fmt::format("r[A] = cpu.bus_.Read({});", hex(operand)));
+    } else if (opcode == 0xE2) {
+      write = "0xFF00 + r[C], r[A]";
+    } else if (opcode == 0xF2) {
+      statements.push_back("r[A] = cpu.bus_.Read(0xFF00 + r[C]);");
+    } else if (opcode == 0xEA) {
+      write = fmt::format("{}, r[A]", hex(operand));
+    } else if (opcode == 0xFA) {
+      statements.push_back(fmt::format("r[A] = cpu.bus_.Read({});", hex(operand)));
+    } else {
+      // HALT, STOP, EI/DI, RST, RETI and the SP arithmetic are left to the interpreter
+      if (count == 0) {
+        Seed(bank, next);
+        return false;
+      }
+      Seed(bank, pc);
+      line(exit(hex(pc)));
+      return true;
+    }
+
+    bool scoped = !write.empty() || statements.size() > 1;
+    line(comment);
+    if (scoped) {
+      line("{");
+    }
+    for (const std::string& statement : statements) {
+      line((scoped ? "  " : "") + statement);
+    }
+    if (!write.empty()) {
+      const char* function = opcode == 0xCB ? "Prefixed" : "Write";
+      line(fmt::format("  if ({}(cpu, {})) {}", function, write, exit_after(hex(next), cost)));
+    }
+    if (scoped) {
+      line("}");
+    }
+    if (ends) {
+      line(exit_after(target, taken));
+      return true;
+    }
+    count++;
+    cycles += cost;
+    pc = next;
+  }
+}
+
+void Recompiler::Emit(std::ostream& out, const std::string& source_name) const {
+  out << "// generated by laneboy-recompile from " << source_name << ", do not edit\n";
+  out << "#include \"recompiled.h\"\n\n";
+  out << "using namespace Recompiled;\n\n";
+  out << "namespace {\n\n";
+  out << "// offsets in the register file\n";
+  out << "enum : u8 { C = 0, B = 1, E = 2, D = 3, L = 4, H = 5, A = 8 };\n";
+  out << "enum : u8 { BC = 0, DE = 2, HL = 4, SP = 6 };\n\n";
+  for (const auto& [key, body] : blocks_) {
+    out << fmt::format("u32 Block_{:02X}_{:04X}(CPU& cpu) {{\n", key >> 16, key & 0xFFFF);
+    out << "  [[maybe_unused]] auto& r = cpu.registers_.file;\n";
+    out << "  [[maybe_unused]] auto& f = cpu.registers_.flags;\n";
+    out << body;
+    out << "}\n\n";
+  }
+  out << "const Block kBlocks[] = {\n";
+  for (const auto& [key, body] : blocks_) {
+    out << fmt::format("    {{0x{0:02X}, 0x{1:04X}, Block_{0:02X}_{1:04X}}},\n", key >> 16, key & 0xFFFF);
+  }
+  out << "};\n\n";
+  out << fmt::format("const Module kModule = {{kModuleVersion, sizeof(CPU), 0x{:016X}ull, {}, kBlocks}};\n\n", rom_hash_, blocks_.size());
+  out << "}\n\n";
+  out << "extern \"C\" const Module* " RECOMPILED_MODULE_SYMBOL "() {\n";
+  out << "  return &kModule;\n";
+  out << "}\n";
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "util.h"
+#include <map>
+#include <ostream>
+#include <set>
+
+// Static recompiler behind laneboy-recompile.
+//
+// Walks the code reachable from the cartridge entry point and the interrupt vectors
+// and emits a C++ source with one function per block, see recompiled.h for the
+// runtime side. Only the common opcodes are translated, a block ends in front of
+// anything else and the interpreter runs that instruction.
+class Recompiler {
+ public:
+  // longest run of instructions in one block, keeps the timers and the PPU close behind
+  static constexpr u32 kMaxBlockInstructions = 32;
+
+  explicit Recompiler(const std::vector<u8>& rom);
+
+  void Analyze();
+  void Emit(std::ostream& out, const std::string& source_name) const;
+
+  size_t block_count() const { return blocks_.size(); }
+  u64 rom_hash() const { return rom_hash_; }
+
+ private:
+  static u32 Key(u16 bank, u16 address) { return ((u32)bank << 16) | address; }
+
+  // nullptr if the address is not backed by the ROM
+  const u8* Code(u16 bank, u16 address) const;
+
+  // queues a jump target found in the given bank
+  void Seed(u16 bank, u16 target);
+
+  // translates the block at bank:address, returns false if it starts with an instruction
+  // that isn't translated
+  bool Translate(u16 bank, u16 address, std::string& body);
+
+  const std::vector<u8>& rom_;
+  u64 rom_hash_;
+  u16 bank_count_;
+
+  std::vector<u32> worklist_;
+  std::set<u32> visited_;
+  std::map<u32, std::string> blocks_;
+};
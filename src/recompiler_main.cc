@@ -0,0 +1,34 @@
+#include "recompiler.h"
+#include <fstream>
+
+// laneboy-recompile <rom> <output.cc>
+//
+// The output is built into a shared library that the emulator picks up from the
+// recompiled directory, the command is printed at the end.
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    std::cerr << "usage: " << argv[0] << " <rom> <output.cc>" << std::endl;
+    return 1;
+  }
+  std::vector<u8> rom = LoadBin(argv[1]);
+  if (rom.size() < 2 * CARTRIDGE_ROM_SIZE) {
+    std::cerr << argv[1] << " is too small to be a cartridge" << std::endl;
+    return 1;
+  }
+
+  Recompiler recompiler(rom);
+  recompiler.Analyze();
+
+  std::ofstream output(argv[2]);
+  if (!output.is_open()) {
+    std::cerr << "unable to open " << argv[2] << std::endl;
+    return 1;
+  }
+  recompiler.Emit(output, argv[1]);
+  output.close();
+
+  std::cout << "recompiled " << recompiler.block_count() << " blocks into " << argv[2] << std::endl;
+  std::cout << "build it with: c++ -std=c++20 -O2 -shared -fPIC -Isrc " << argv[2]
+            << fmt::format(" -o recompiled/{:016x}.so", recompiler.rom_hash()) << std::endl;
+  return 0;
+}
@@ -1,98 +1,64 @@
 #include "register.h"
 
-bool is_16bit_register(ArithmeticTarget target) {
-  return target == ArithmeticTarget::BC || target == ArithmeticTarget::DE ||
-    target == ArithmeticTarget::HL || target == ArithmeticTarget::SP;
-}
-
+// indexed by ArithmeticTarget, avoids switching on the target for every operand access
+static constexpr std::array<u8, 11> kOffsets = {
+    RegisterOffset(ArithmeticTarget::A),
+    RegisterOffset(ArithmeticTarget::B),
+    RegisterOffset(ArithmeticTarget::C),
+    RegisterOffset(ArithmeticTarget::D),
+    RegisterOffset(ArithmeticTarget::E),
+    RegisterOffset(ArithmeticTarget::H),
+    RegisterOffset(ArithmeticTarget::L),
+    RegisterOffset(ArithmeticTarget::BC),
+    RegisterOffset(ArithmeticTarget::DE),
+    RegisterOffset(ArithmeticTarget::HL),
+    RegisterOffset(ArithmeticTarget::SP),
+};
 
 void Registers::Set(ArithmeticTarget target, u16 v) {
-  switch (target) {
-    case ArithmeticTarget::A:
-      assert(v <= 0xFF);
-      a = v & 0xFF;
-      break;
-    case ArithmeticTarget::B:
-      assert(v <= 0xFF);
-      bc.f.hi = v & 0xFF;
-      break;
-    case ArithmeticTarget::C:
-      assert(v <= 0xFF);
-      bc.f.lo = v & 0xFF;
-      break;
-    case ArithmeticTarget::D:
-      assert(v <= 0xFF);
-      de.f.hi = v & 0xFF;
-      break;
-    case ArithmeticTarget::E:
-      assert(v <= 0xFF);
-      de.f.lo = v & 0xFF;
-      break;
-    case ArithmeticTarget::H:
-      assert(v <= 0xFF);
-      hl.f.hi = v & 0xFF;
-      break;
-    case ArithmeticTarget::L:
-      assert(v <= 0xFF);
-      hl.f.lo = v & 0xFF;
-      break;
-    case ArithmeticTarget::BC:
-      bc.v = v;
-      break;
-    case ArithmeticTarget::DE:
-      de.v = v;
-      break;
-    case ArithmeticTarget::HL:
-      hl.v = v;
-      break;
-    case ArithmeticTarget::SP:
-      sp = v;
-      break;
+  u8 offset = kOffsets[static_cast<int>(target)];
+  if (is_16bit_register(target)) {
+    std::memcpy(&file[offset], &v, sizeof(v));
+  } else {
+    assert(v <= 0xFF);
+    file[offset] = v & 0xFF;
   }
 }
 
 u16 Registers::Get(ArithmeticTarget target) const {
-  switch (target) {
-    case ArithmeticTarget::A:
-      return a;
-    case ArithmeticTarget::B:
-      return bc.f.hi;
-    case ArithmeticTarget::C:
-      return bc.f.lo;
-    case ArithmeticTarget::D:
-      return de.f.hi;
-    case ArithmeticTarget::E:
-      return de.f.lo;
-    case ArithmeticTarget::H:
-      return hl.f.hi;
-    case ArithmeticTarget::L:
-      return hl.f.lo;
-    case ArithmeticTarget::BC:
-      return bc.v;
-    case ArithmeticTarget::DE:
-      return de.v;
-    case ArithmeticTarget::HL:
-      return hl.v;
-    case ArithmeticTarget::SP:
-      return sp;
+  u8 offset = kOffsets[static_cast<int>(target)];
+  if (is_16bit_register(target)) {
+    u16 v;
+    std::memcpy(&v, &file[offset], sizeof(v));
+    return v;
   }
+  return file[offset];
 }
 
 void Registers::Print() {
+  u8 a = Get<ArithmeticTarget::A>();
+  u8 b = Get<ArithmeticTarget::B>();
+  u8 c = Get<ArithmeticTarget::C>();
+  u8 d = Get<ArithmeticTarget::D>();
+  u8 e = Get<ArithmeticTarget::E>();
+  u8 h = Get<ArithmeticTarget::H>();
+  u8 l = Get<ArithmeticTarget::L>();
+  u16 sp = this->sp();
+  u8 f = flags.ToByte();
   std::cout << "a: " << ToBinary(a) << " (" << ToHex(a) << ")" << std::endl;
-  std::cout << "b: " << ToBinary(bc.f.hi) << " (" << ToHex(bc.f.hi) << ")" << std::endl;
-  std::cout << "c: " << ToBinary(bc.f.lo) << " (" << ToHex(bc.f.lo) << ")" << std::endl;
-  std::cout << "d: " << ToBinary(de.f.hi) << " (" << ToHex(de.f.hi) << ")" << std::endl;
-  std::cout << "e: " << ToBinary(de.f.lo) << " (" << ToHex(de.f.lo) << ")" << std::endl;
-  std::cout << "h: " << ToBinary(hl.f.hi) << " (" << ToHex(hl.f.hi) << ")" << std::endl;
-  std::cout << "l: " << ToBinary(hl.f.lo) << " (" << ToHex(hl.f.lo) << ")" << std::endl;
+  std::cout << "b: " << ToBinary(b) << " (" << ToHex(b) << ")" << std::endl;
+  std::cout << "c: " << ToBinary(c) << " (" << ToHex(c) << ")" << std::endl;
+  std::cout << "d: " << ToBinary(d) << " (" << ToHex(d) << ")" << std::endl;
+  std::cout << "e: " << ToBinary(e) << " (" << ToHex(e) << ")" << std::endl;
+  std::cout << "h: " << ToBinary(h) << " (" << ToHex(h) << ")" << std::endl;
+  std::cout << "l: " << ToBinary(l) << " (" << ToHex(l) << ")" << std::endl;
   std::cout << "sp: " << ToBinary(sp) << " (" << ToHex(sp) << ")" << std::endl;
   std::cout << "pc: " << ToBinary(pc) << " (" << ToHex(pc) << ")" << std::endl;
   std::cout << std::endl;
   std::cout << "flags: " << std::endl;
-  std::cout << "f: " << ToBinary(flags.v) << " (" << ToHex(flags.v) << ")" << std::endl;
-  std::cout << "zero: " << BoolToStr(flags.f.zero) << std::endl;
-  std::cout << "subtract: " << BoolToStr(flags.f.subtract) << std::endl;
-  std::cout << "half carry: " << BoolToStr(flags.f.half_carry) << std::endl;
-  std::cout << "carry: " << BoolToStr(flags.f.carry) << std::endl;
-}
\ No newline at end of file
+  std::cout << "f: " << ToBinary(f) << " (" << ToHex(f) << ")" << std::endl;
+  std::cout << "zero: " << BoolToStr(flags.zero()) << std::endl;
+  std::cout << "subtract: " << BoolToStr(flags.subtract()) << std::endl;
+  std::cout << "half carry: " << BoolToStr(flags.half_carry()) << std::endl;
+  std::cout << "carry: " << BoolToStr(flags.carry()) << std::endl;
+}
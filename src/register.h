@@ -1,6 +1,9 @@
 #pragma once
 
 #include "util.h"
+#include <array>
+#include <bit>
+#include <cstring>
 
 enum class ArithmeticTarget {
   A,
@@ -16,56 +19,186 @@ enum class ArithmeticTarget {
   SP
 };
 
-bool is_16bit_register(ArithmeticTarget target);
+constexpr bool is_16bit_register(ArithmeticTarget target) {
+  return target == ArithmeticTarget::BC || target == ArithmeticTarget::DE ||
+    target == ArithmeticTarget::HL || target == ArithmeticTarget::SP;
+}
 
-union Flags {
-  u8 v;
-  struct {
-    u8 padding : 4;
-    bool carry : 1;
-    bool half_carry : 1;
-    bool subtract : 1;
-    bool zero : 1;
-  } f;
-
-  Flags(u8 b) {
-    v = b;
+// Flags are kept unpacked so updating one is a plain byte store,
+// the F register is only built when it is pushed or shown in the debugger.
+// With LAZY_FLAGS the 8-bit add/sub family only records its operands and
+// the flags are derived when something actually reads them
+class Flags {
+ public:
+#ifdef LAZY_FLAGS
+  bool zero() const { return op_ == Op::None ? zero_ : result_ == 0; }
+  bool subtract() const { return op_ == Op::None ? subtract_ : op_ == Op::Sub || op_ == Op::Dec; }
+  bool half_carry() const {
+    switch (op_) {
+      case Op::None: return half_carry_;
+      case Op::Add: case Op::Inc: return (first_ & 0xF) + (second_ & 0xF) + carry_in_ > 0xF;
+      case Op::Sub: case Op::Dec: return (first_ & 0xF) - (second_ & 0xF) - carry_in_ < 0;
+    }
+    return false;
+  }
+  bool carry() const {
+    switch (op_) {
+      case Op::Add: return first_ + second_ + carry_in_ > 0xFF;
+      case Op::Sub: return first_ < second_ + carry_in_;
+      default: return carry_;
+    }
   }
-};
 
-union Register {
-  u16 v;
-  struct {
-    u8 lo;
-    u8 hi;
-  } f;
-};
+  void zero(bool value) { Resolve(); zero_ = value; }
+  void subtract(bool value) { Resolve(); subtract_ = value; }
+  void half_carry(bool value) { Resolve(); half_carry_ = value; }
+  void carry(bool value) { Resolve(); carry_ = value; }
+#else
+  bool zero() const { return zero_; }
+  void zero(bool value) { zero_ = value; }
 
-template<typename T, int DebugId>
-class Var {
- public:
-  Var(T v) : value_(v) {};
+  bool subtract() const { return subtract_; }
+  void subtract(bool value) { subtract_ = value; }
+
+  bool half_carry() const { return half_carry_; }
+  void half_carry(bool value) { half_carry_ = value; }
 
-  operator T() const {
-    return value_;
+  bool carry() const { return carry_; }
+  void carry(bool value) { carry_ = value; }
+#endif
+
+  // result flags of first + second + carry_in, Inc keeps the old carry
+  void FromAdd(u8 first, u8 second, bool carry_in, u8 result, bool keep_carry = false) {
+#ifdef LAZY_FLAGS
+    Record(keep_carry ? Op::Inc : Op::Add, first, second, carry_in, result);
+#else
+    zero_ = result == 0;
+    subtract_ = false;
+    half_carry_ = (first & 0xF) + (second & 0xF) + carry_in > 0xF;
+    if (!keep_carry) {
+      carry_ = first + second + carry_in > 0xFF;
+    }
+#endif
+  }
+
+  // result flags of first - second - carry_in, Dec keeps the old carry
+  void FromSub(u8 first, u8 second, bool carry_in, u8 result, bool keep_carry = false) {
+#ifdef LAZY_FLAGS
+    Record(keep_carry ? Op::Dec : Op::Sub, first, second, carry_in, result);
+#else
+    zero_ = result == 0;
+    subtract_ = true;
+    half_carry_ = (first & 0xF) - (second & 0xF) - carry_in < 0;
+    if (!keep_carry) {
+      carry_ = first < second + carry_in;
+    }
+#endif
   }
 
-  Var& operator =(const T& new_value) {
-    value_ = new_value;
-    return *this;
+  u8 ToByte() const {
+    return (zero() << 7) | (subtract() << 6) | (half_carry() << 5) | (carry() << 4);
   }
+
+  void FromByte(u8 f) {
+#ifdef LAZY_FLAGS
+    op_ = Op::None;
+#endif
+    zero_ = f & 0x80;
+    subtract_ = f & 0x40;
+    half_carry_ = f & 0x20;
+    carry_ = f & 0x10;
+  }
+
  private:
-  T value_;
+#ifdef LAZY_FLAGS
+  enum class Op : u8 { None, Add, Sub, Inc, Dec };
 
+  void Record(Op op, u8 first, u8 second, bool carry_in, u8 result) {
+    if (op == Op::Inc || op == Op::Dec) {
+      carry_ = carry();
+    }
+    op_ = op;
+    first_ = first;
+    second_ = second;
+    carry_in_ = carry_in;
+    result_ = result;
+  }
+
+  // materialize the pending operation before a single flag is overwritten
+  void Resolve() {
+    if (op_ == Op::None) {
+      return;
+    }
+    zero_ = zero();
+    subtract_ = subtract();
+    half_carry_ = half_carry();
+    carry_ = carry();
+    op_ = Op::None;
+  }
+
+  Op op_ = Op::None;
+  u8 first_ = 0;
+  u8 second_ = 0;
+  u8 result_ = 0;
+  bool carry_in_ = false;
+#endif
+  bool zero_ = false;
+  bool subtract_ = false;
+  bool half_carry_ = false;
+  bool carry_ = false;
 };
+
+// byte offsets of each operand in the register file, pairs are stored
+// low byte first so a 16-bit access is a single load on little endian hosts
+constexpr u8 RegisterOffset(ArithmeticTarget target) {
+  switch (target) {
+    case ArithmeticTarget::C: return 0;
+    case ArithmeticTarget::B: return 1;
+    case ArithmeticTarget::E: return 2;
+    case ArithmeticTarget::D: return 3;
+    case ArithmeticTarget::L: return 4;
+    case ArithmeticTarget::H: return 5;
+    case ArithmeticTarget::SP: return 6;
+    case ArithmeticTarget::A: return 8;
+    case ArithmeticTarget::BC: return 0;
+    case ArithmeticTarget::DE: return 2;
+    case ArithmeticTarget::HL: return 4;
+  }
+  return 0;
+}
+
 struct Registers {
-  u8 a = 0; // a
-  Flags flags{0};
-  Register bc{0}; // b, c
-  Register de{0}; // d, e
-  Register hl{0}; // h, l
-  Var<u16, 0> sp = 0;
-  Var<u16, 1> pc = 0;
+  static_assert(std::endian::native == std::endian::little, "register pairs assume a little endian host");
+
+  alignas(2) std::array<u8, 10> file{}; // c, b, e, d, l, h, sp lo, sp hi, a, unused
+  Flags flags;
+  u16 pc = 0;
+
+  template<ArithmeticTarget target>
+  u16 Get() const {
+    constexpr u8 offset = RegisterOffset(target);
+    if constexpr (is_16bit_register(target)) {
+      u16 v;
+      std::memcpy(&v, &file[offset], sizeof(v));
+      return v;
+    } else {
+      return file[offset];
+    }
+  }
+
+  template<ArithmeticTarget target>
+  void Set(u16 v) {
+    constexpr u8 offset = RegisterOffset(target);
+    if constexpr (is_16bit_register(target)) {
+      std::memcpy(&file[offset], &v, sizeof(v));
+    } else {
+      assert(v <= 0xFF);
+      file[offset] = v & 0xFF;
+    }
+  }
+
+  u16 sp() const { return Get<ArithmeticTarget::SP>(); }
+  void set_sp(u16 v) { Set<ArithmeticTarget::SP>(v); }
 
   void Set(ArithmeticTarget target, u16 v);
   u16 Get(ArithmeticTarget target) const;
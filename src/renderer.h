@@ -3,6 +3,7 @@
 
 #include "util.h"
 #include "imgui.h"
+#include <span>
 
 template<typename Number>
 struct Color {
@@ -46,6 +47,9 @@ class TextureWrapper {
   void SetPixel(s32 x, s32 y, Colori color);
   void Fill(Colori color);
 
+  // RGBA, row after row, writing them doesn't mark the texture changed
+  std::span<u8> pixels() { return data_; }
+
   void Update();
 
   bool changed() const { return changed_; }
@@ -66,4 +70,7 @@ class Renderer {
 
 };
 
-std::unique_ptr<Renderer> CreateRenderer();
\ No newline at end of file
+std::unique_ptr<Renderer> CreateRenderer();
+
+// a texture without a renderer behind it, for headless runs and benchmarks
+std::unique_ptr<Texture> CreateMemoryTexture(s32 width, s32 height);
\ No newline at end of file
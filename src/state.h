@@ -0,0 +1,145 @@
+#pragma once
+
+#include "util.h"
+#include "memory.h"
+#include <cstring>
+#include <memory>
+#include <span>
+#include <type_traits>
+
+// A machine's state as bytes, see Snapshot.
+//
+// Every component lists its state once, in a Serialize template that is called with
+// either a StateWriter or a StateReader, so saving and loading can't disagree on the
+// order. Fields go in as their raw bytes, the snapshot is only ever loaded into a
+// machine of the same build. Banks of RAM are either frozen and shared with the
+// machines that load them, see CopyOnWriteArrayMemoryDevice, or copied into the bytes.
+
+enum class BankMode {
+  Share,
+  Copy, // the bytes are the whole state, e.g. to keep it after the machine is gone
+};
+
+class StateWriter {
+ public:
+  static constexpr bool kLoading = false;
+
+  explicit StateWriter(BankMode mode) : mode_(mode) {}
+
+  template<typename... Fields>
+  void operator()(Fields&... fields) {
+    (Field(fields), ...);
+  }
+
+  void Bytes(std::span<const u8> bytes) {
+    bytes_.insert(bytes_.end(), bytes.begin(), bytes.end());
+  }
+
+  void Access(MemoryDevice& device) {
+    MemoryAccess access = device.access();
+    Field(access);
+  }
+
+  // the selected bank and every bank's data, freezing them in Share mode
+  template<size_t size>
+  void Banks(CopyOnWriteArrayMemoryDevice<size>& device) {
+    u32 current = device.current();
+    u32 count = device.bank_count();
+    (*this)(current, count);
+    for (u32 bank = 0; bank < count; bank++) {
+      if (mode_ == BankMode::Share) {
+        banks_.push_back(device.Freeze(bank));
+      } else {
+        Bytes(device.Data(bank));
+      }
+    }
+  }
+
+  std::vector<u8> TakeBytes() { return std::move(bytes_); }
+  std::vector<std::shared_ptr<const void>> TakeBanks() { return std::move(banks_); }
+
+ private:
+  template<typename T>
+  void Field(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    auto bytes = reinterpret_cast<const u8*>(&value);
+    bytes_.insert(bytes_.end(), bytes, bytes + sizeof(T));
+  }
+
+  BankMode mode_;
+  std::vector<u8> bytes_;
+  std::vector<std::shared_ptr<const void>> banks_;
+};
+
+// Reads what a StateWriter with the same mode wrote, running past the end or finding
+// a different bank layout aborts, like loading a snapshot of another ROM would.
+class StateReader {
+ public:
+  static constexpr bool kLoading = true;
+
+  StateReader(BankMode mode, std::span<const u8> bytes, std::span<const std::shared_ptr<const void>> banks)
+      : mode_(mode), bytes_(bytes), banks_(banks) {}
+
+  template<typename... Fields>
+  void operator()(Fields&... fields) {
+    (Field(fields), ...);
+  }
+
+  void Bytes(std::span<u8> bytes) {
+    std::memcpy(bytes.data(), Take(bytes.size()), bytes.size());
+  }
+
+  void Access(MemoryDevice& device) {
+    MemoryAccess access;
+    Field(access);
+    device.DisableAccess(kMemoryAccessBoth);
+    device.EnableAccess(access);
+  }
+
+  template<size_t size>
+  void Banks(CopyOnWriteArrayMemoryDevice<size>& device) {
+    u32 current;
+    u32 count;
+    (*this)(current, count);
+    if (count != device.bank_count()) {
+      std::cerr << "snapshot has " << count << " banks where the machine has " << device.bank_count() << std::endl;
+      abort();
+    }
+    for (u32 bank = 0; bank < count; bank++) {
+      if (mode_ == BankMode::Share) {
+        if (next_bank_ == banks_.size()) {
+          abort(); // fewer banks than fields say
+        }
+        device.Share(bank, std::static_pointer_cast<const std::array<u8, size>>(banks_[next_bank_++]));
+      } else {
+        Bytes(device.Overwrite(bank));
+      }
+    }
+    device.Switch(current);
+  }
+
+  bool done() const { return offset_ == bytes_.size() && next_bank_ == banks_.size(); }
+
+ private:
+  template<typename T>
+  void Field(T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    std::memcpy(&value, Take(sizeof(T)), sizeof(T));
+  }
+
+  const u8* Take(size_t size) {
+    if (offset_ + size > bytes_.size()) {
+      std::cerr << "snapshot of " << bytes_.size() << " bytes ends before its state" << std::endl;
+      abort();
+    }
+    const u8* bytes = bytes_.data() + offset_;
+    offset_ += size;
+    return bytes;
+  }
+
+  BankMode mode_;
+  std::span<const u8> bytes_;
+  std::span<const std::shared_ptr<const void>> banks_;
+  size_t offset_ = 0;
+  size_t next_bank_ = 0;
+};
@@ -0,0 +1,36 @@
+#include "symbols.h"
+#include <fstream>
+
+bool SymbolTable::Load(const std::string& path) {
+  symbols_.clear();
+  std::ifstream input(path);
+  if (!input.is_open()) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(input, line)) {
+    size_t comment = line.find(';');
+    if (comment != std::string::npos) {
+      line.resize(comment);
+    }
+    unsigned bank;
+    unsigned address;
+    char name[256];
+    if (std::sscanf(line.c_str(), "%x:%x %255s", &bank, &address, name) == 3 && bank <= 0xFFFF && address <= 0xFFFF) {
+      symbols_.emplace(Key(bank, address), name);
+    }
+  }
+  return true;
+}
+
+std::string SymbolTable::Name(u16 bank, u16 address) const {
+  auto it = symbols_.upper_bound(Key(bank, address));
+  if (it != symbols_.begin()) {
+    --it;
+    if (it->first >> 16 == bank) {
+      u16 offset = address - (it->first & 0xFFFF);
+      return offset == 0 ? it->second : fmt::format("{}+0x{:X}", it->second, offset);
+    }
+  }
+  return fmt::format("{:02X}:{:04X}", bank, address);
+}
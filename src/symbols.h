@@ -0,0 +1,24 @@
+#pragma once
+
+#include "util.h"
+#include <map>
+
+// Labels from a .sym file as written by rgblink -n, one "BB:AAAA Name" per line,
+// ';' starts a comment.
+
+class SymbolTable {
+ public:
+  // false if the file can't be opened, the table is left empty then
+  bool Load(const std::string& path);
+
+  bool empty() const { return symbols_.empty(); }
+
+  // the label at address, "Label+0x12" inside one, or "BB:AAAA" if the bank has
+  // no label before it
+  std::string Name(u16 bank, u16 address) const;
+
+ private:
+  static u32 Key(u16 bank, u16 address) { return (bank << 16) | address; }
+
+  std::map<u32, std::string> symbols_;
+};
@@ -0,0 +1,267 @@
+#include "synthetic_rom.h"
+#include "cartridge.h"
+#include <cassert>
+
+namespace {
+
+std::vector<u8> EmptyRom(const char* title, CartridgeType type, u8 rom_size) {
+  std::vector<u8> rom((size_t) CARTRIDGE_ROM_SIZE * 2 << rom_size, 0);
+  std::copy(title, title + std::min<size_t>(strlen(title), 15), rom.begin() + 0x134);
+  rom[0x147] = (u8) type;
+  rom[0x148] = rom_size;
+  rom[0x149] = k1Bank;
+  return rom;
+}
+
+// copies code to address, end is where the next piece starts
+void Place(std::vector<u8>& rom, const std::vector<u8>& code, u32 address, u32 end) {
+  assert(address + code.size() <= end);
+  std::copy(code.begin(), code.end(), rom.begin() + address);
+}
+
+// the interrupt vector and the entry point, VBlank goes to $0200 and the entry to $0150
+void PlaceVectors(std::vector<u8>& rom) {
+  std::vector<u8> code;
+  Assembler vector(code, 0x0040);
+  vector.Emit16(0xC3, 0x0200); // JP vblank
+  Place(rom, code, 0x0040, 0x0048);
+
+  code.clear();
+  Assembler entry(code, 0x0100);
+  entry.Emit({0x00}); // NOP
+  entry.Emit16(0xC3, 0x0150); // JP $0150
+  Place(rom, code, 0x0100, 0x0104);
+}
+
+// waits for VBlank, fills the tiles with a pattern using every color and the map with
+// all of them while the LCD is off, then turns it back on with the VBlank interrupt
+void EmitVideoSetup(Assembler& a) {
+  u16 wait = a.here();
+  a.Emit({0xF0, 0x44}); // LDH A, [LY]
+  a.Emit({0xFE, 0x90}); // CP 144
+  a.EmitRelative(0x38, wait); // JR C, wait
+  a.Emit({0xAF}); // XOR A
+  a.Emit({0xE0, 0x40}); // LDH [LCDC], A, LCD off
+  a.Emit16(0x21, 0x8000); // LD HL, $8000
+  u16 tiles = a.here();
+  a.Emit({0x7D}); // LD A, L
+  a.Emit({0xAC}); // XOR H
+  a.Emit({0x07}); // RLCA
+  a.Emit({0x85}); // ADD A, L
+  a.Emit({0x22}); // LD [HL+], A
+  a.Emit({0x7C}); // LD A, H
+  a.Emit({0xFE, 0x90}); // CP $90
+  a.EmitRelative(0x20, tiles); // JR NZ, tiles
+  a.Emit16(0x21, 0x9800); // LD HL, $9800
+  u16 map = a.here();
+  a.Emit({0x7D}); // LD A, L
+  a.Emit({0x22}); // LD [HL+], A
+  a.Emit({0x7C}); // LD A, H
+  a.Emit({0xFE, 0x9C}); // CP $9C
+  a.EmitRelative(0x20, map); // JR NZ, map
+  a.Emit({0x3E, 0xE4}); // LD A, $E4
+  a.Emit({0xE0, 0x47}); // LDH [BGP], A
+  a.Emit({0x3E, 0x91}); // LD A, LCD and background on, tiles at $8000
+  a.Emit({0xE0, 0x40}); // LDH [LCDC], A
+  a.Emit({0x3E, kInterruptTypeVBlank}); // LD A, VBlank
+  a.Emit({0xE0, 0xFF}); // LDH [IE], A
+  a.Emit({0xAF}); // XOR A
+  a.Emit({0xE0, 0x0F}); // LDH [IF], A
+  a.Emit({0xFB}); // EI
+}
+
+// at $0300, returns the JoypadButton bits held in A, trashes B
+void PlaceReadJoypad(std::vector<u8>& rom) {
+  std::vector<u8> code;
+  Assembler a(code, 0x0300);
+  a.Emit({0x3E, 0x20}); // LD A, $20, the d-pad
+  a.Emit({0xE0, 0x00}); // LDH [JOYP], A
+  a.Emit({0xF0, 0x00}); // LDH A, [JOYP]
+  a.Emit({0x2F}); // CPL
+  a.Emit({0xE6, 0x0F}); // AND $0F
+  a.Emit({0x47}); // LD B, A
+  a.Emit({0x3E, 0x10}); // LD A, $10, the buttons
+  a.Emit({0xE0, 0x00}); // LDH [JOYP], A
+  a.Emit({0xF0, 0x00}); // LDH A, [JOYP]
+  a.Emit({0x2F}); // CPL
+  a.Emit({0xE6, 0x0F}); // AND $0F
+  a.Emit({0xCB, 0x37}); // SWAP A
+  a.Emit({0xB0}); // OR B
+  a.Emit({0x47}); // LD B, A
+  a.Emit({0x3E, 0x30}); // LD A, $30, neither
+  a.Emit({0xE0, 0x00}); // LDH [JOYP], A
+  a.Emit({0x78}); // LD A, B
+  a.Emit({0xC9}); // RET
+  Place(rom, code, 0x0300, 0x0400);
+}
+
+// WRAM read-modify-write loop, forever
+void EmitBusyLoop(Assembler& a) {
+  u16 outer = a.here();
+  a.Emit16(0x21, 0xC000); // LD HL, $C000
+  a.Emit({0x06, 0x00}); // LD B, 0
+  u16 inner = a.here();
+  a.Emit({0x7E}); // LD A, [HL]
+  a.Emit({0x80}); // ADD A, B
+  a.Emit({0x22}); // LD [HL+], A
+  a.Emit({0x05}); // DEC B
+  a.EmitRelative(0x20, inner); // JR NZ, inner
+  a.EmitRelative(0x18, outer); // JR outer
+}
+
+// CPU bound, the busy loop with the background scrolling once a frame, A inverts the palette
+std::vector<u8> ScrollRom() {
+  std::vector<u8> rom = EmptyRom("LANEBOY SCROLL", CartridgeType::ROM_ONLY, kRom32KB);
+  PlaceVectors(rom);
+  PlaceReadJoypad(rom);
+
+  std::vector<u8> code;
+  Assembler vblank(code, 0x0200);
+  vblank.Emit({0xF5}); // PUSH AF
+  vblank.Emit({0xC5}); // PUSH BC
+  vblank.Emit({0xF0, 0x43}); // LDH A, [SCX]
+  vblank.Emit({0x3C}); // INC A
+  vblank.Emit({0xE0, 0x43}); // LDH [SCX], A
+  vblank.Emit16(0xCD, 0x0300); // CALL joypad
+  vblank.Emit({0xE6, kJoypadA}); // AND A button
+  size_t released = vblank.EmitForward(0x28); // JR Z, released
+  vblank.Emit({0xF0, 0x47}); // LDH A, [BGP]
+  vblank.Emit({0x2F}); // CPL
+  vblank.Emit({0xE0, 0x47}); // LDH [BGP], A
+  vblank.Land(released);
+  vblank.Emit({0xC1}); // POP BC
+  vblank.Emit({0xF1}); // POP AF
+  vblank.Emit({0xD9}); // RETI
+  Place(rom, code, 0x0200, 0x0300);
+
+  code.clear();
+  Assembler main(code, 0x0150);
+  main.Emit({0xF3}); // DI
+  main.Emit16(0x31, 0xFFFE); // LD SP, $FFFE
+  EmitVideoSetup(main);
+  EmitBusyLoop(main);
+  Place(rom, code, 0x0150, 0x0200);
+  return rom;
+}
+
+// Mostly halted, the d-pad scrolls the background and A and B pick which of ROM banks
+// 1 to 4 the VBlank handler calls into, each sets its own palette and runs a loop of
+// its own length over WRAM.
+std::vector<u8> JoypadRom() {
+  std::vector<u8> rom = EmptyRom("LANEBOY JOYPAD", CartridgeType::MBC1, kRom128KB);
+  PlaceVectors(rom);
+  PlaceReadJoypad(rom);
+
+  std::vector<u8> code;
+  Assembler vblank(code, 0x0200);
+  vblank.Emit({0xF5}); // PUSH AF
+  vblank.Emit({0xC5}); // PUSH BC
+  vblank.Emit({0xE5}); // PUSH HL
+  vblank.Emit16(0xCD, 0x0300); // CALL joypad
+  vblank.Emit({0x4F}); // LD C, A
+  // BIT n, C for right, left, up and down, then the register and the step
+  struct Move {
+    u8 bit;
+    u8 reg;
+    u8 step;
+  };
+  for (Move move : {Move{0x41, 0x43, 0x3C}, Move{0x49, 0x43, 0x3D}, Move{0x51, 0x42, 0x3D}, Move{0x59, 0x42, 0x3C}}) {
+    vblank.Emit({0xCB, move.bit}); // BIT n, C
+    size_t released = vblank.EmitForward(0x28); // JR Z, released
+    vblank.Emit({0xF0, move.reg}); // LDH A, [SCX or SCY]
+    vblank.Emit({move.step}); // INC A or DEC A
+    vblank.Emit({0xE0, move.reg}); // LDH [SCX or SCY], A
+    vblank.Land(released);
+  }
+  vblank.Emit({0x79}); // LD A, C
+  vblank.Emit({0xCB, 0x37}); // SWAP A
+  vblank.Emit({0xE6, 0x03}); // AND A and B
+  vblank.Emit({0x3C}); // INC A
+  vblank.Emit16(0xEA, 0x2000); // LD [$2000], A, the ROM bank
+  vblank.Emit16(0xCD, 0x4000); // CALL $4000
+  vblank.Emit({0xE1}); // POP HL
+  vblank.Emit({0xC1}); // POP BC
+  vblank.Emit({0xF1}); // POP AF
+  vblank.Emit({0xD9}); // RETI
+  Place(rom, code, 0x0200, 0x0300);
+
+  // each an order of the four shades
+  constexpr u8 kPalettes[] = {0xE4, 0x1B, 0x93, 0x6C};
+  for (u8 bank = 1; bank <= 4; bank++) {
+    code.clear();
+    Assembler routine(code, 0x4000);
+    routine.Emit({0x3E, kPalettes[bank - 1]}); // LD A, palette
+    routine.Emit({0xE0, 0x47}); // LDH [BGP], A
+    routine.Emit16(0x21, 0xC000); // LD HL, $C000
+    routine.Emit({0x06, (u8)(bank * 48)}); // LD B, length
+    u16 loop = routine.here();
+    routine.Emit({0x7E}); // LD A, [HL]
+    routine.Emit({0xC6, bank}); // ADD A, bank
+    routine.Emit({0x22}); // LD [HL+], A
+    routine.Emit({0x05}); // DEC B
+    routine.EmitRelative(0x20, loop); // JR NZ, loop
+    routine.Emit({0xC9}); // RET
+    Place(rom, code, bank * CARTRIDGE_ROM_SIZE, (bank + 1) * CARTRIDGE_ROM_SIZE);
+  }
+
+  code.clear();
+  Assembler main(code, 0x0150);
+  main.Emit({0xF3}); // DI
+  main.Emit16(0x31, 0xFFFE); // LD SP, $FFFE
+  EmitVideoSetup(main);
+  u16 idle = main.here();
+  main.Emit({0x76}); // HALT
+  main.Emit({0x00}); // NOP
+  main.EmitRelative(0x18, idle); // JR idle
+  Place(rom, code, 0x0150, 0x0200);
+  return rom;
+}
+
+constexpr CorpusRom kDefaultCorpus[] = {
+  {"scroll", ScrollRom},
+  {"joypad", JoypadRom},
+};
+
+}
+
+std::vector<u8> SyntheticRom() {
+  std::vector<u8> rom = EmptyRom("LANEBOY BENCH", CartridgeType::ROM_ONLY, kRom32KB);
+  PlaceVectors(rom);
+
+  std::vector<u8> code;
+  Assembler vblank(code, 0x0200);
+  vblank.Emit({0xF5}); // PUSH AF
+  vblank.Emit({0xF0, 0x43}); // LDH A, [SCX]
+  vblank.Emit({0x3C}); // INC A
+  vblank.Emit({0xE0, 0x43}); // LDH [SCX], A
+  vblank.Emit({0xF0, 0x40}); // LDH A, [LCDC]
+  vblank.Emit({0xE0, 0x40}); // LDH [LCDC], A, unchanged
+  vblank.Emit({0x3E, 0xC0}); // LD A, $C0
+  vblank.Emit({0xE0, 0x46}); // LDH [DMA], A, OAM from WRAM
+  vblank.Emit({0xAF}); // XOR A
+  vblank.Emit({0xE0, 0x4F}); // LDH [VBK], A
+  vblank.Emit({0x3C}); // INC A
+  vblank.Emit({0xE0, 0x70}); // LDH [SVBK], A
+  vblank.Emit16(0xEA, 0x2000); // LD [$2000], A, ROM bank 1
+  vblank.Emit({0xCB, 0x37}); // SWAP A
+  vblank.Emit({0xF1}); // POP AF
+  vblank.Emit({0xD9}); // RETI
+  Place(rom, code, 0x0200, 0x0300);
+
+  code.clear();
+  Assembler main(code, 0x0150);
+  main.Emit({0xF3}); // DI
+  main.Emit16(0x31, 0xFFFE); // LD SP, $FFFE
+  main.Emit({0x3E, 0x91}); // LD A, LCD and background on, tiles at $8000
+  main.Emit({0xE0, 0x40}); // LDH [LCDC], A
+  main.Emit({0x3E, kInterruptTypeVBlank}); // LD A, VBlank
+  main.Emit({0xE0, 0xFF}); // LDH [IE], A
+  main.Emit({0xFB}); // EI
+  EmitBusyLoop(main);
+  Place(rom, code, 0x0150, 0x0200);
+  return rom;
+}
+
+std::span<const CorpusRom> DefaultCorpus() {
+  return kDefaultCorpus;
+}
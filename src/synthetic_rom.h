@@ -0,0 +1,57 @@
+#pragma once
+
+#include "util.h"
+#include <span>
+#include <vector>
+
+// ROMs assembled in code, for the tools that need a cartridge without shipping one.
+
+// assembles into a vector, labels are plain offsets into it
+class Assembler {
+ public:
+  Assembler(std::vector<u8>& out, u16 origin) : out_(out), origin_(origin) {}
+
+  u16 here() const { return origin_ + out_.size(); }
+
+  void Emit(std::initializer_list<u8> bytes) {
+    out_.insert(out_.end(), bytes);
+  }
+
+  void Emit16(u8 opcode, u16 value) {
+    Emit({opcode, (u8)(value & 0xFF), (u8)(value >> 8)});
+  }
+
+  // JR/JR cc to target, which must already be assembled
+  void EmitRelative(u8 opcode, u16 target) {
+    Emit({opcode, (u8)(s8)(target - (here() + 2))});
+  }
+
+  // JR/JR cc to a target assembled later, returns what to pass to Land once it is
+  size_t EmitForward(u8 opcode) {
+    Emit({opcode, 0});
+    return out_.size();
+  }
+
+  // the forward jump lands here
+  void Land(size_t jump) {
+    out_[jump - 1] = (u8)(s8)(out_.size() - jump);
+  }
+
+ private:
+  std::vector<u8>& out_;
+  u16 origin_;
+};
+
+// A 32KB ROM only cartridge that turns the LCD on, scrolls the background from the
+// VBlank interrupt and otherwise keeps the CPU busy with a read-modify-write loop over WRAM.
+// The VBlank handler also pokes the registers with side effects once a frame, LCDC,
+// OAM DMA, the bank selects and the MBC. It leaves VRAM as it is, laneboy-bench fills it.
+std::vector<u8> SyntheticRom();
+
+// The ROMs laneboy-corpus runs when it isn't given any. Unlike SyntheticRom they draw
+// their own tiles and read the joypad, corpus/<name>.input next to them says what to press.
+struct CorpusRom {
+  const char* name;
+  std::vector<u8> (*build)();
+};
+std::span<const CorpusRom> DefaultCorpus();
@@ -70,13 +70,15 @@ static void mycpu_set_state(struct state *state) {
 
   cpu->halted_ = state->halted;
   cpu->ime_ = state->interrupts_master_enabled;
-  cpu->registers_.sp = state->SP;
+  cpu->registers_.set_sp(state->SP);
   cpu->registers_.pc = state->PC;
-  cpu->registers_.a = state->reg8.A;
-  cpu->registers_.flags.v = state->reg8.F;
-  cpu->registers_.bc.v = state->reg16.BC;
-  cpu->registers_.de.v = state->reg16.DE;
-  cpu->registers_.hl.v = state->reg16.HL;
+  cpu->registers_.Set<ArithmeticTarget::A>(state->reg8.A);
+  cpu->registers_.flags.FromByte(state->reg8.F);
+  cpu->registers_.Set<ArithmeticTarget::BC>(state->reg16.BC);
+  cpu->registers_.Set<ArithmeticTarget::DE>(state->reg16.DE);
+  cpu->registers_.Set<ArithmeticTarget::HL>(state->reg16.HL);
+  // HALT and IME were written behind the CPU's back, like a loaded snapshot
+  cpu->UpdateInterruptState();
 }
 
 /*
@@ -90,13 +92,13 @@ static void mycpu_get_state(struct state *state)
   /* ... Copy your current CPU state into the provided struct ... */
   state->halted = cpu->halted_;
   state->interrupts_master_enabled = cpu->ime_;
-  state->SP = cpu->registers_.sp;
+  state->SP = cpu->registers_.sp();
   state->PC = cpu->registers_.pc;
-  state->reg8.A = cpu->registers_.a;
-  state->reg8.F = cpu->registers_.flags.v;
-  state->reg16.BC = cpu->registers_.bc.v;
-  state->reg16.DE = cpu->registers_.de.v;
-  state->reg16.HL = cpu->registers_.hl.v;
+  state->reg8.A = cpu->registers_.Get<ArithmeticTarget::A>();
+  state->reg8.F = cpu->registers_.flags.ToByte();
+  state->reg16.BC = cpu->registers_.Get<ArithmeticTarget::BC>();
+  state->reg16.DE = cpu->registers_.Get<ArithmeticTarget::DE>();
+  state->reg16.HL = cpu->registers_.Get<ArithmeticTarget::HL>();
 }
 
 /*
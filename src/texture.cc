@@ -0,0 +1,73 @@
+#include "renderer.h"
+#include "instrument.h"
+#include <cstring>
+
+Colori ColorFromHex(u32 value) {
+  return {(u8)((value >> 16) & 0xFF), (u8)((value >> 8) & 0xFF), (u8)(value & 0xFF)};
+}
+
+// pixels that never leave memory, uploading does nothing
+class MemoryTexture : public Texture {
+ public:
+  MemoryTexture(s32 width, s32 height) : width_(width), height_(height), data_(width * height * 4, 0) {}
+
+  s32 width() const override { return width_; }
+  s32 height() const override { return height_; }
+
+  void Draw(s32 x, s32 y, s32 width, s32 height) override {}
+  void DrawImGui(s32 width, s32 height) override {}
+
+ private:
+  std::vector<u8>& data_internal() override {
+    return data_;
+  }
+
+  void UploadData() override {}
+
+  s32 width_;
+  s32 height_;
+  std::vector<u8> data_;
+};
+
+std::unique_ptr<Texture> CreateMemoryTexture(s32 width, s32 height) {
+  return std::make_unique<MemoryTexture>(width, height);
+}
+
+TextureWrapper::TextureWrapper(Texture& texture) : texture_(texture), data_(texture.data_internal()) {
+
+}
+
+void TextureWrapper::SetPixel(s32 x, s32 y, Colori color) {
+  if (color.a == 0) {
+    return;
+  }
+  u64 index = y * texture_.width() * 4 + x * 4; // *4 because every pixel has 4 components
+  data_[index] = color.r;
+  data_[index + 1] = color.g;
+  data_[index + 2] = color.b;
+  data_[index + 3] = color.a;
+  changed_ = true;
+}
+
+void TextureWrapper::Fill(Colori color) {
+  if (color.a == 0) {
+    return;
+  }
+  // rows are stored one after the other, every pixel gets the same 4 bytes, copied
+  // whole through a local pointer so the loop becomes wide stores
+  const u8 pixel[4] = {color.r, color.g, color.b, color.a};
+  u8* data = data_.data();
+  size_t size = data_.size() & ~size_t(3);
+  for (size_t index = 0; index < size; index += 4) {
+    std::memcpy(data + index, pixel, sizeof(pixel));
+  }
+  changed_ = true;
+}
+
+void TextureWrapper::Update() {
+  if (changed_) {
+    INSTRUMENT_ZONE("TextureWrapper::Update");
+    texture_.UploadData();
+    changed_ = false;
+  }
+}
@@ -0,0 +1,117 @@
+#include "trace.h"
+#include "cpu.h"
+#include <atomic>
+#include <thread>
+
+#ifdef ENABLE_TRACE
+
+namespace Trace {
+
+// records in the ring, a power of two so the indices can wrap freely
+static constexpr size_t kRingSize = 1 << 16; // 2MiB
+// records per compressed block
+static constexpr size_t kBlockSize = kTraceMaxBlockRecords;
+
+class Recorder {
+ public:
+  bool Open(const std::string& path) {
+    if (!writer_.Open(path)) {
+      return false;
+    }
+    thread_ = std::thread([this]() { Drain(); });
+    return true;
+  }
+
+  void Close() {
+    stopping_ = true;
+    thread_.join();
+    writer_.Close();
+  }
+
+  void Push(const TraceRecord& record) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    while (head - tail_.load(std::memory_order_acquire) == kRingSize) {
+      std::this_thread::yield(); // full, wait for the writer
+    }
+    ring_[head & (kRingSize - 1)] = record;
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+ private:
+  void Drain() {
+    while (true) {
+      bool stopping = stopping_.load(std::memory_order_acquire);
+      size_t tail = tail_.load(std::memory_order_relaxed);
+      size_t available = head_.load(std::memory_order_acquire) - tail;
+      if (available < kBlockSize && !stopping) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+      if (available == 0) {
+        return; // stopping and drained
+      }
+      // one contiguous run at a time, a block never wraps around the ring
+      size_t start = tail & (kRingSize - 1);
+      size_t count = std::min({available, kBlockSize, kRingSize - start});
+      writer_.WriteBlock({ring_.data() + start, count});
+      tail_.store(tail + count, std::memory_order_release);
+    }
+  }
+
+  std::array<TraceRecord, kRingSize> ring_;
+  // the indices only grow, each on its own cache line
+  alignas(64) std::atomic<size_t> head_ = 0;
+  alignas(64) std::atomic<size_t> tail_ = 0;
+  alignas(64) std::atomic<bool> stopping_ = false;
+  TraceWriter writer_;
+  std::thread thread_;
+};
+
+static std::unique_ptr<Recorder> recorder_;
+
+bool Start(const std::string& path) {
+  Stop();
+  auto recorder = std::make_unique<Recorder>();
+  if (!recorder->Open(path)) {
+    std::cerr << "unable to open trace " << path << std::endl;
+    return false;
+  }
+  recorder_ = std::move(recorder);
+  return true;
+}
+
+void Stop() {
+  if (recorder_) {
+    recorder_->Close();
+    recorder_ = nullptr;
+  }
+}
+
+void OnInstruction(CPU& cpu) {
+  if (!recorder_) {
+    return;
+  }
+  const Registers& registers = cpu.registers_;
+  TraceRecord record{};
+  record.cycles = cpu.cycle_count_;
+  record.pc = registers.pc;
+  record.sp = registers.sp();
+  record.bank = cpu.CodeBank(record.pc);
+  record.a = registers.Get<ArithmeticTarget::A>();
+  record.f = registers.flags.ToByte();
+  record.b = registers.Get<ArithmeticTarget::B>();
+  record.c = registers.Get<ArithmeticTarget::C>();
+  record.d = registers.Get<ArithmeticTarget::D>();
+  record.e = registers.Get<ArithmeticTarget::E>();
+  record.h = registers.Get<ArithmeticTarget::H>();
+  record.l = registers.Get<ArithmeticTarget::L>();
+  // peeked, reading through the bus would count the reads and could stop on an unmapped address
+  for (u16 i = 0; i < 4; i++) {
+    record.pcmem[i] = cpu.bus_.Peek(registers.pc + i);
+  }
+  recorder_->Push(record);
+}
+
+}
+
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "trace_file.h"
+
+// Instruction tracing, built with -DTRACE=1.
+//
+// CPU::Step hands every instruction to the recorder, which copies the registers
+// into a TraceRecord and pushes it into a single producer, single consumer ring.
+// A background thread drains the ring in blocks, compresses them and writes them
+// out, laneboy-trace turns the file into Gameboy Doctor logs.
+//
+// The emulator thread only waits when the writer falls a whole ring behind, a trace
+// is never missing instructions.
+
+#ifdef TRACE
+#define ENABLE_TRACE
+#endif
+
+class CPU;
+
+namespace Trace {
+
+// stops the current trace, if any, and starts writing a new one to path
+bool Start(const std::string& path);
+// writes out what is left in the ring and closes the file
+void Stop();
+
+void OnInstruction(CPU& cpu);
+
+}
+
+#ifdef ENABLE_TRACE
+#define EMIT_TRACE_INSTRUCTION(cpu) Trace::OnInstruction(cpu)
+#define START_TRACE(path) Trace::Start(path)
+#define STOP_TRACE() Trace::Stop()
+#else
+#define EMIT_TRACE_INSTRUCTION(cpu)
+#define START_TRACE(path)
+#define STOP_TRACE()
+#endif
@@ -0,0 +1,95 @@
+#include "trace_file.h"
+#include "compress.h"
+#include <cstring>
+
+bool TraceWriter::Open(const std::string& path) {
+  output_.open(path, std::ios::binary | std::ios::trunc);
+  if (!output_.is_open()) {
+    return false;
+  }
+  TraceFileHeader header{};
+  std::memcpy(header.magic, kTraceMagic, sizeof(header.magic));
+  header.version = kTraceVersion;
+  header.record_size = sizeof(TraceRecord);
+  output_.write((const char*) &header, sizeof(header));
+  return true;
+}
+
+// each record is stored xored with the one before it, the fields that didn't change
+// become runs of zeroes the compressor can match
+static void XorWithPrevious(std::span<const u8> in, u8* out) {
+  for (size_t i = 0; i < in.size(); i++) {
+    out[i] = i < sizeof(TraceRecord) ? in[i] : in[i] ^ in[i - sizeof(TraceRecord)];
+  }
+}
+
+static void UndoXor(std::span<u8> data) {
+  for (size_t i = sizeof(TraceRecord); i < data.size(); i++) {
+    data[i] ^= data[i - sizeof(TraceRecord)];
+  }
+}
+
+void TraceWriter::WriteBlock(std::span<const TraceRecord> records) {
+  assert(!records.empty() && records.size() <= kTraceMaxBlockRecords);
+  delta_.resize(records.size_bytes());
+  XorWithPrevious({(const u8*) records.data(), records.size_bytes()}, delta_.data());
+  std::span<const u8> raw(delta_);
+  buffer_.resize(Compress::CompressBound(raw.size()));
+  u32 compressed_size = Compress::CompressBlock(raw, buffer_.data());
+  const u8* data = buffer_.data();
+  if (compressed_size >= raw.size()) {
+    compressed_size = raw.size();
+    data = raw.data();
+  }
+  u32 count = records.size();
+  output_.write((const char*) &count, sizeof(count));
+  output_.write((const char*) &compressed_size, sizeof(compressed_size));
+  output_.write((const char*) data, compressed_size);
+}
+
+void TraceWriter::Close() {
+  if (output_.is_open()) {
+    output_.close();
+  }
+}
+
+bool TraceReader::Open(const std::string& path) {
+  input_.open(path, std::ios::binary);
+  if (!input_.is_open()) {
+    return false;
+  }
+  TraceFileHeader header{};
+  if (!input_.read((char*) &header, sizeof(header))) {
+    return false;
+  }
+  return std::memcmp(header.magic, kTraceMagic, sizeof(header.magic)) == 0 && header.version == kTraceVersion &&
+      header.record_size == sizeof(TraceRecord);
+}
+
+bool TraceReader::ReadBlock(std::vector<TraceRecord>& records) {
+  u32 count;
+  u32 compressed_size;
+  if (!input_.read((char*) &count, sizeof(count)) || !input_.read((char*) &compressed_size, sizeof(compressed_size))) {
+    return false;
+  }
+  // a 255 byte length adds up to 255 bytes of output, a block can't grow more than that
+  u64 raw_size = (u64) count * sizeof(TraceRecord);
+  if (count == 0 || count > kTraceMaxBlockRecords || compressed_size > raw_size ||
+      raw_size > (u64) compressed_size * 255) {
+    return false;
+  }
+  records.resize(count);
+  std::span<u8> raw((u8*) records.data(), raw_size);
+  if (compressed_size == raw.size()) {
+    if (!input_.read((char*) raw.data(), raw.size())) {
+      return false;
+    }
+  } else {
+    buffer_.resize(compressed_size);
+    if (!input_.read((char*) buffer_.data(), compressed_size) || !Compress::DecompressBlock(buffer_, raw)) {
+      return false;
+    }
+  }
+  UndoXor(raw);
+  return true;
+}
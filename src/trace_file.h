@@ -0,0 +1,58 @@
+#pragma once
+
+#include "util.h"
+#include <fstream>
+#include <span>
+
+// Instruction traces, see trace.h for the recorder.
+//
+// The file starts with a TraceFileHeader, then come blocks of records: the record
+// count, the compressed size and the records compressed with CompressBlock, each one
+// xored with the record before it. A block whose compressed size equals its raw size
+// isn't compressed.
+
+struct TraceRecord {
+  u64 cycles; // T-cycles since power on, before the instruction
+  u16 pc;
+  u16 sp;
+  u16 bank; // ROM bank mapped at the PC, 0 outside $4000-$7FFF
+  u8 a, f, b, c, d, e, h, l;
+  u8 pcmem[4]; // the bytes at the PC, the opcode and what follows it, 0xFF where unreadable
+  u8 reserved[2];
+};
+static_assert(sizeof(TraceRecord) == 32);
+
+struct TraceFileHeader {
+  char magic[8];
+  u32 version;
+  u32 record_size;
+};
+
+constexpr char kTraceMagic[8] = {'L', 'B', 'T', 'R', 'A', 'C', 'E', 0};
+constexpr u32 kTraceVersion = 1;
+// records per block at most, the reader takes anything larger for a corrupt file
+constexpr u32 kTraceMaxBlockRecords = 1 << 12;
+
+class TraceWriter {
+ public:
+  bool Open(const std::string& path);
+  void WriteBlock(std::span<const TraceRecord> records);
+  void Close();
+
+ private:
+  std::ofstream output_;
+  std::vector<u8> delta_;
+  std::vector<u8> buffer_;
+};
+
+class TraceReader {
+ public:
+  // false if the file doesn't exist or isn't a trace
+  bool Open(const std::string& path);
+  // replaces records with the next block, false at the end of the file or if the block is corrupt
+  bool ReadBlock(std::vector<TraceRecord>& records);
+
+ private:
+  std::ifstream input_;
+  std::vector<u8> buffer_;
+};
@@ -0,0 +1,44 @@
+#include "trace_file.h"
+
+// laneboy-trace <trace.lbt> [output.txt]
+//
+// Prints a trace from a -DTRACE=1 build in the Gameboy Doctor format, one line per
+// instruction, to the output file or stdout.
+int main(int argc, char** argv) {
+  if (argc != 2 && argc != 3) {
+    std::cerr << "usage: " << argv[0] << " <trace.lbt> [output.txt]" << std::endl;
+    return 1;
+  }
+  TraceReader reader;
+  if (!reader.Open(argv[1])) {
+    std::cerr << argv[1] << " is not a trace" << std::endl;
+    return 1;
+  }
+  std::ofstream file;
+  if (argc == 3) {
+    file.open(argv[2]);
+    if (!file.is_open()) {
+      std::cerr << "unable to open " << argv[2] << std::endl;
+      return 1;
+    }
+  }
+  std::ostream& output = argc == 3 ? file : std::cout;
+
+  std::vector<TraceRecord> records;
+  std::string line;
+  u64 count = 0;
+  while (reader.ReadBlock(records)) {
+    for (const TraceRecord& r : records) {
+      line.clear();
+      fmt::format_to(std::back_inserter(line),
+                     "A:{:02X} F:{:02X} B:{:02X} C:{:02X} D:{:02X} E:{:02X} H:{:02X} L:{:02X} SP:{:04X} PC:{:04X} "
+                     "PCMEM:{:02X},{:02X},{:02X},{:02X}\n",
+                     r.a, r.f, r.b, r.c, r.d, r.e, r.h, r.l, r.sp, r.pc, r.pcmem[0], r.pcmem[1], r.pcmem[2],
+                     r.pcmem[3]);
+      output << line;
+    }
+    count += records.size();
+  }
+  std::cerr << count << " instructions" << std::endl;
+  return 0;
+}
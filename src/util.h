@@ -99,8 +99,11 @@
 #define TAC_ADDRESS 0xFF07
 
 #define BASE_CPU_CLOCK_SPEED 4194304
-#define DOUBLE_CPU_CLOCK_SPEED BASE_CPU_CLOCK_SPEED * 2
+#define DOUBLE_CPU_CLOCK_SPEED (BASE_CPU_CLOCK_SPEED * 2)
 #define BASE_PPU_CLOCK_SPEED BASE_CPU_CLOCK_SPEED
+// every component is scheduled in ticks of the double speed clock, a T-cycle is
+// two ticks in normal speed and one tick in double speed, a PPU dot is always two ticks
+#define SCHEDULER_CLOCK_SPEED DOUBLE_CPU_CLOCK_SPEED
 
 #define BIND_FN(fn)                                    \
   [this](auto&&... args) -> decltype(auto) {                \
@@ -121,6 +124,7 @@ using u64 = uint64_t;
 using s8 = int8_t;
 using s16 = int16_t;
 using s32 = int32_t;
+using s64 = int64_t;
 
 std::vector<u8> LoadBin(const std::string& path);
 
@@ -196,6 +200,19 @@ struct Joypad {
   bool select_buttons : 1; // when set, lower nibble is set to start-select-b-a
 };
 
+// bits of CPU::SetButtons, the d-pad in the low nibble and the buttons in the high
+// one, in the order JOYP reports them
+enum JoypadButton : u8 {
+  kJoypadRight = 1 << 0,
+  kJoypadLeft = 1 << 1,
+  kJoypadUp = 1 << 2,
+  kJoypadDown = 1 << 3,
+  kJoypadA = 1 << 4,
+  kJoypadB = 1 << 5,
+  kJoypadSelect = 1 << 6,
+  kJoypadStart = 1 << 7,
+};
+
 enum ColorMode {
   kColorModeBackground,
   kColorModeObjectPalette0,